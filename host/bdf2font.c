@@ -0,0 +1,450 @@
+// Convert a BDF font into a tinyfont_t C source for src/ (see tiny_font.h)
+//
+//   bdf2font [-n name] [-r set]... [-u text] [-d char] [-k kerning] font.bdf > src/font_name.c
+//
+//   -n name      font name, the C symbol is tinyfont_<name> (default: BDF file name)
+//   -r set       code points to keep: digits, ascii, latin1 or FIRST-LAST
+//                (decimal or 0x hex), may be given several times
+//   -u text      keep the code points of a UTF-8 string
+//   -d char      glyph drawn for missing code points (default '?' when kept)
+//   -k kerning   pairs "L R adjust" per line, L and R are characters or U+XXXX
+//
+// Without -r or -u every glyph of the BDF file is kept. Glyph bitmaps are
+// trimmed to their inked columns and stored as page-ordered columns.
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CODE        0x110000
+#define MAX_ROWS        255
+#define MAX_KERNS       4096
+
+typedef struct glyph_t {
+  uint32_t code;
+  int16_t advance;
+  int16_t bbx_w, bbx_h, bbx_x, bbx_y;
+  uint8_t *rows;            // bbx_h rows of (bbx_w + 7) / 8 bytes, MSB first
+} glyph_t;
+
+typedef struct kern_t {
+  uint16_t left, right;
+  int16_t adjust;
+} kern_t;
+
+static glyph_t *glyphs;
+static int glyph_count;
+static uint8_t *keep;       // code points selected, NULL = all
+
+static void
+die(const char *msg, const char *arg)
+{
+  fprintf(stderr, "bdf2font: %s%s%s\n", msg, arg ? ": " : "", arg ? arg : "");
+  exit(1);
+}
+
+static void
+keep_range(uint32_t first, uint32_t last)
+{
+  if (keep == NULL) {
+    keep = (uint8_t *)calloc(MAX_CODE, 1);
+    if (keep == NULL) die("out of memory", NULL);
+  }
+  for (uint32_t c = first; (c <= last) && (c < MAX_CODE); c++) {
+    keep[c] = 1;
+  }
+}
+
+// Decode one UTF-8 code point at *s, 0 at the end of the string
+static uint32_t
+utf8_decode(const char **s)
+{
+  const uint8_t *p = (const uint8_t *)*s;
+  uint32_t code;
+  int more;
+
+  if (*p == 0) return 0;
+  if (*p < 0x80) { code = *p; more = 0; }
+  else if ((*p & 0xE0) == 0xC0) { code = *p & 0x1F; more = 1; }
+  else if ((*p & 0xF0) == 0xE0) { code = *p & 0x0F; more = 2; }
+  else if ((*p & 0xF8) == 0xF0) { code = *p & 0x07; more = 3; }
+  else die("malformed UTF-8", *s);
+  p++;
+  for (int n = 0; n < more; n++, p++) {
+    if ((*p & 0xC0) != 0x80) die("malformed UTF-8", *s);
+    code = (code << 6) | (*p & 0x3F);
+  }
+  *s = (const char *)p;
+  return code;
+}
+
+// A character given as itself or as U+XXXX
+static uint32_t
+parse_char(const char *s)
+{
+  if (((s[0] == 'U') || (s[0] == 'u')) && (s[1] == '+') && isxdigit((unsigned char)s[2])) {
+    return (uint32_t)strtoul(s + 2, NULL, 16);
+  }
+  return utf8_decode(&s);
+}
+
+static void
+parse_set(const char *set)
+{
+  char *end;
+  unsigned long first, last;
+
+  if (strcmp(set, "digits") == 0) {
+    keep_range('0', '9');
+  }
+  else if (strcmp(set, "ascii") == 0) {
+    keep_range(0x20, 0x7E);
+  }
+  else if (strcmp(set, "latin1") == 0) {
+    keep_range(0x20, 0x7E);
+    keep_range(0xA0, 0xFF);
+  }
+  else {
+    first = strtoul(set, &end, 0);
+    if ((end == set) || (*end != '-')) die("bad set", set);
+    last = strtoul(end + 1, &end, 0);
+    if ((*end != 0) || (last < first)) die("bad set", set);
+    keep_range(first, last);
+  }
+}
+
+static int
+hex_digit(int c)
+{
+  if ((c >= '0') && (c <= '9')) return c - '0';
+  c = tolower(c);
+  if ((c >= 'a') && (c <= 'f')) return c - 'a' + 10;
+  return -1;
+}
+
+static void
+read_bdf(const char *path, int16_t *ascent, int16_t *descent)
+{
+  FILE *fp = fopen(path, "r");
+  char line[1024];
+  glyph_t g;
+  int in_char = 0, in_bitmap = 0, row = 0, capacity = 0;
+  int fbb_h = 0, fbb_y = 0, has_fbb = 0;
+
+  if (fp == NULL) die("cannot open", path);
+  *ascent = *descent = -1;
+  memset(&g, 0, sizeof(g));
+
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    int a, b, c, d;
+
+    if (in_bitmap) {
+      if (strncmp(line, "ENDCHAR", 7) == 0) {
+        in_bitmap = in_char = 0;
+        if ((int32_t)g.code < 0) {
+          free(g.rows);
+          continue;
+        }
+        if (glyph_count == capacity) {
+          capacity = capacity ? capacity * 2 : 256;
+          glyphs = (glyph_t *)realloc(glyphs, sizeof(glyph_t) * capacity);
+          if (glyphs == NULL) die("out of memory", NULL);
+        }
+        glyphs[glyph_count++] = g;
+        continue;
+      }
+      if (row < g.bbx_h) {
+        int stride = (g.bbx_w + 7) / 8;
+        for (int i = 0; i < stride; i++) {
+          int hi = hex_digit(line[2 * i]);
+          int lo = hex_digit(line[2 * i + 1]);
+          if ((hi < 0) || (lo < 0)) die("bad BITMAP row", line);
+          g.rows[row * stride + i] = (uint8_t)((hi << 4) | lo);
+        }
+        row++;
+      }
+      continue;
+    }
+
+    if (sscanf(line, "FONTBOUNDINGBOX %d %d %d %d", &a, &b, &c, &d) == 4) {
+      fbb_h = b;
+      fbb_y = d;
+      has_fbb = 1;
+    }
+    else if (sscanf(line, "FONT_ASCENT %d", &a) == 1) {
+      *ascent = a;
+    }
+    else if (sscanf(line, "FONT_DESCENT %d", &a) == 1) {
+      *descent = a;
+    }
+    else if (strncmp(line, "STARTCHAR", 9) == 0) {
+      memset(&g, 0, sizeof(g));
+      g.code = (uint32_t)-1;
+      in_char = 1;
+    }
+    else if (in_char && (sscanf(line, "ENCODING %d", &a) == 1)) {
+      g.code = (a < 0) ? (uint32_t)-1 : (uint32_t)a;
+    }
+    else if (in_char && (sscanf(line, "DWIDTH %d", &a) == 1)) {
+      g.advance = a;
+    }
+    else if (in_char && (sscanf(line, "BBX %d %d %d %d", &a, &b, &c, &d) == 4)) {
+      g.bbx_w = a;
+      g.bbx_h = b;
+      g.bbx_x = c;
+      g.bbx_y = d;
+    }
+    else if (in_char && (strncmp(line, "BITMAP", 6) == 0)) {
+      g.rows = (uint8_t *)calloc(((g.bbx_w + 7) / 8) * (g.bbx_h ? g.bbx_h : 1), 1);
+      if (g.rows == NULL) die("out of memory", NULL);
+      in_bitmap = 1;
+      row = 0;
+    }
+  }
+  fclose(fp);
+
+  if ((*ascent < 0) || (*descent < 0)) {
+    if (!has_fbb) die("no FONT_ASCENT / FONT_DESCENT nor FONTBOUNDINGBOX", path);
+    *ascent = fbb_h + fbb_y;
+    *descent = -fbb_y;
+  }
+  if ((*ascent + *descent < 1) || (*ascent + *descent > MAX_ROWS)) die("unsupported font height", path);
+  if (glyph_count == 0) die("no glyphs", path);
+}
+
+static int
+glyph_order(const void *a, const void *b)
+{
+  uint32_t ca = ((const glyph_t *)a)->code;
+  uint32_t cb = ((const glyph_t *)b)->code;
+  return (ca > cb) - (ca < cb);
+}
+
+static int
+kern_order(const void *a, const void *b)
+{
+  const kern_t *ka = (const kern_t *)a;
+  const kern_t *kb = (const kern_t *)b;
+  if (ka->left != kb->left) return ka->left - kb->left;
+  return ka->right - kb->right;
+}
+
+static int
+glyph_index(uint32_t code)
+{
+  int lo = 0, hi = glyph_count - 1;
+
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (code < glyphs[mid].code) hi = mid - 1;
+    else if (code > glyphs[mid].code) lo = mid + 1;
+    else return mid;
+  }
+  return -1;
+}
+
+static int
+pixel(const glyph_t *g, int col, int row)
+{
+  int stride = (g->bbx_w + 7) / 8;
+  return (g->rows[row * stride + col / 8] >> (7 - (col & 7))) & 1;
+}
+
+static const char *
+code_comment(uint32_t code, char *buf)
+{
+  if ((code >= 0x20) && (code < 0x7F) && (code != '\\') && (code != '\'')) {
+    sprintf(buf, "'%c' U+%04X", (int)code, code);
+  }
+  else {
+    sprintf(buf, "U+%04X", code);
+  }
+  return buf;
+}
+
+int
+main(int argc, char *argv[])
+{
+  const char *name = NULL, *path = NULL, *kern_path = NULL;
+  uint32_t default_code = '?';
+  int explicit_default = 0;
+  int16_t ascent, descent, height, pages;
+  kern_t kerns[MAX_KERNS];
+  int kern_count = 0;
+  char buf[32];
+  char base[64];
+
+  for (int i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "-n") == 0) && (i + 1 < argc)) name = argv[++i];
+    else if ((strcmp(argv[i], "-r") == 0) && (i + 1 < argc)) parse_set(argv[++i]);
+    else if ((strcmp(argv[i], "-u") == 0) && (i + 1 < argc)) {
+      const char *s = argv[++i];
+      uint32_t code;
+      while ((code = utf8_decode(&s)) != 0) keep_range(code, code);
+    }
+    else if ((strcmp(argv[i], "-d") == 0) && (i + 1 < argc)) {
+      default_code = parse_char(argv[++i]);
+      explicit_default = 1;
+    }
+    else if ((strcmp(argv[i], "-k") == 0) && (i + 1 < argc)) kern_path = argv[++i];
+    else if ((argv[i][0] != '-') && (path == NULL)) path = argv[i];
+    else {
+      fprintf(stderr, "usage: bdf2font [-n name] [-r digits|ascii|latin1|FIRST-LAST]... [-u text] [-d char] [-k kerning] font.bdf\n");
+      return 1;
+    }
+  }
+  if (path == NULL) die("no BDF file given", NULL);
+  if (name == NULL) {
+    const char *slash = strrchr(path, '/');
+    snprintf(base, sizeof(base), "%s", slash ? slash + 1 : path);
+    for (char *p = base; *p; p++) {
+      if (*p == '.') *p = 0;
+      else if (!isalnum((unsigned char)*p)) *p = '_';
+    }
+    name = base;
+  }
+  for (const char *p = name; *p; p++) {
+    if (!isalnum((unsigned char)*p) && (*p != '_')) die("font name must be a C identifier", name);
+  }
+
+  read_bdf(path, &ascent, &descent);
+  height = ascent + descent;
+  pages = (height + 7) / 8;
+
+  // subset, then sort by code point
+  if (keep != NULL) {
+    int n = 0;
+    for (int i = 0; i < glyph_count; i++) {
+      if ((glyphs[i].code < MAX_CODE) && keep[glyphs[i].code]) glyphs[n++] = glyphs[i];
+      else free(glyphs[i].rows);
+    }
+    glyph_count = n;
+    if (glyph_count == 0) die("no glyph left in the selected code points", NULL);
+  }
+  qsort(glyphs, glyph_count, sizeof(glyph_t), glyph_order);
+  if (glyph_count > 0xFFFE) die("too many glyphs", NULL);
+  if (explicit_default && (glyph_index(default_code) < 0)) die("the default character is not in the font", NULL);
+
+  if (kern_path != NULL) {
+    FILE *fp = fopen(kern_path, "r");
+    char line[256], l[32], r[32];
+    int adjust;
+
+    if (fp == NULL) die("cannot open", kern_path);
+    while (fgets(line, sizeof(line), fp) != NULL) {
+      int left, right;
+      if ((line[0] == '#') || (sscanf(line, "%31s %31s %d", l, r, &adjust) != 3)) continue;
+      left = glyph_index(parse_char(l));
+      right = glyph_index(parse_char(r));
+      if ((left < 0) || (right < 0) || (adjust == 0)) continue;
+      if ((adjust < -128) || (adjust > 127)) die("kerning out of range", line);
+      if (kern_count == MAX_KERNS) die("too many kerning pairs", NULL);
+      kerns[kern_count].left = left;
+      kerns[kern_count].right = right;
+      kerns[kern_count].adjust = adjust;
+      kern_count++;
+    }
+    fclose(fp);
+    qsort(kerns, kern_count, sizeof(kern_t), kern_order);
+  }
+
+  printf("// Generated by host/bdf2font from %s, do not edit\n", path);
+  printf("//\n//  ");
+  for (int i = 0; i < argc; i++) printf(" %s", argv[i]);
+  printf("\n\n#include \"tiny_font.h\"\n\n");
+
+  // bitmaps: columns with ink only, page by page
+  uint32_t offset = 0;
+  uint32_t *offsets = (uint32_t *)calloc(glyph_count, sizeof(uint32_t));
+  int16_t *widths = (int16_t *)calloc(glyph_count, sizeof(int16_t));
+  int16_t *lefts = (int16_t *)calloc(glyph_count, sizeof(int16_t));
+  if ((offsets == NULL) || (widths == NULL) || (lefts == NULL)) die("out of memory", NULL);
+
+  printf("static const uint8_t %s_bitmaps[] = {\n", name);
+  for (int i = 0; i < glyph_count; i++) {
+    glyph_t *g = &glyphs[i];
+    int top = ascent - (g->bbx_y + g->bbx_h);
+    int c0 = g->bbx_w, c1 = -1;
+
+    for (int col = 0; col < g->bbx_w; col++) {
+      for (int row = 0; row < g->bbx_h; row++) {
+        if (pixel(g, col, row)) {
+          if (col < c0) c0 = col;
+          if (col > c1) c1 = col;
+        }
+      }
+    }
+    offsets[i] = offset;
+    if (c1 < c0) continue;
+    if ((top < 0) || (top + g->bbx_h > height)) {
+      fprintf(stderr, "bdf2font: %s is taller than the font, clipped\n", code_comment(g->code, buf));
+    }
+    widths[i] = c1 - c0 + 1;
+    lefts[i] = g->bbx_x + c0;
+    if ((widths[i] > 255) || (lefts[i] < -128) || (lefts[i] > 127)) die("glyph too wide", code_comment(g->code, buf));
+    if ((g->advance < 0) || (g->advance > 255)) die("advance out of range", code_comment(g->code, buf));
+
+    printf("  // %s\n ", code_comment(g->code, buf));
+    for (int page = 0; page < pages; page++) {
+      for (int col = c0; col <= c1; col++) {
+        uint8_t column = 0;
+        for (int bit = 0; bit < 8; bit++) {
+          int row = page * 8 + bit - top;
+          if ((row >= 0) && (row < g->bbx_h) && pixel(g, col, row)) {
+            column |= 1 << bit;
+          }
+        }
+        printf(" 0x%02X,", column);
+      }
+    }
+    printf("\n");
+    offset += widths[i] * pages;
+  }
+  if (offset == 0) printf("  0x00\n");
+  printf("};\n\n");
+
+  printf("static const tinyfont_glyph_t %s_glyphs[] = {\n", name);
+  for (int i = 0; i < glyph_count; i++) {
+    printf("  { %5u, %3d, %3d, %3d },   // %s\n", offsets[i], widths[i], glyphs[i].advance, lefts[i],
+           code_comment(glyphs[i].code, buf));
+  }
+  printf("};\n\n");
+
+  int range_count = 0;
+  printf("static const tinyfont_range_t %s_ranges[] = {\n", name);
+  for (int i = 0; i < glyph_count; ) {
+    int n = 1;
+    while ((i + n < glyph_count) && (n < 0xFFFF) && (glyphs[i + n].code == glyphs[i].code + n)) n++;
+    printf("  { 0x%04X, %3d, %3d },\n", glyphs[i].code, n, i);
+    range_count++;
+    i += n;
+  }
+  printf("};\n\n");
+
+  if (kern_count > 0) {
+    printf("static const tinyfont_kern_t %s_kerns[] = {\n", name);
+    for (int i = 0; i < kern_count; i++) {
+      char lb[32];
+      printf("  { %3d, %3d, %3d },   // %s %s\n", kerns[i].left, kerns[i].right, kerns[i].adjust,
+             code_comment(glyphs[kerns[i].left].code, lb), code_comment(glyphs[kerns[i].right].code, buf));
+    }
+    printf("};\n\n");
+  }
+
+  int default_glyph = glyph_index(default_code);
+  printf("const tinyfont_t tinyfont_%s = {\n", name);
+  printf("  \"%s\", %d, %d, ", name, height, ascent);
+  if (default_glyph < 0) printf("TINYFONT_NONE");
+  else printf("%d", default_glyph);
+  printf(", %d, %d, %d,\n", glyph_count, range_count, kern_count);
+  printf("  %s_ranges, %s_glyphs, ", name, name);
+  if (kern_count > 0) printf("%s_kerns, ", name);
+  else printf("NULL, ");
+  printf("%s_bitmaps\n};\n", name);
+
+  fprintf(stderr, "bdf2font: %s, %d glyphs, %d ranges, %d kerning pairs, %u bitmap bytes\n",
+          name, glyph_count, range_count, kern_count, offset);
+  return 0;
+}
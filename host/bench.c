@@ -0,0 +1,330 @@
+// ===================================================================
+//
+//    Micro-benchmarks of the tiny graphics libraries (host build)
+//
+// ===================================================================
+//
+// Times the raster primitives and the SSD1306 flush against the mock
+// I2C and SPI masters. Run it before and after a change to the raster code to
+// get a regression baseline.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "tiny_grafx.h"
+#include "ssd1306.h"
+#include "display_list.h"
+#include "frame_stream.h"
+#include "transport.h"
+#include "mock_panel.h"
+#include "mock_spi.h"
+#include "mock_transport.h"
+
+static ssd1306_t dev;
+
+static double
+now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void
+report(const char *name, long iterations, double elapsed)
+{
+  printf("%-28s %10ld %12.1f ns/op\n", name, iterations, elapsed / iterations);
+}
+
+#define BENCH(name, iterations, body) do {                   \
+    double start_ = now_ns();                                \
+    for (long i_ = 0; i_ < (iterations); i_++) { body; }     \
+    report(name, (iterations), now_ns() - start_);           \
+  } while (0)
+
+static void
+bench_primitives(void)
+{
+  tinygrafx_t tg = dev.tg;
+  char name[32];
+
+  BENCH("set_pixel (full screen)", 2000,
+        for (int16_t y = 0; y < 64; y++)
+          for (int16_t x = 0; x < 128; x++)
+            set_pixel(tg, x, y, WHITE));
+
+  BENCH("draw_line (diagonal)", 200000, draw_line(tg, 0, 0, 127, 63, INVERT));
+  BENCH("draw_line (horizontal)", 200000, draw_line(tg, 0, 31, 127, 31, INVERT));
+  BENCH("draw_line (off-screen)", 200000, draw_line(tg, -500, -300, 600, 400, INVERT));
+  BENCH("draw_thick_line (width 5)", 50000, draw_thick_line(tg, 0, 0, 127, 63, 5, INVERT));
+  BENCH("draw_horizontal_line", 200000, draw_horizontal_line(tg, 0, 17, 128, INVERT));
+  BENCH("draw_vertical_line", 200000, draw_vertical_line(tg, 17, 0, 64, INVERT));
+  BENCH("draw_fill_rect (20x20)", 100000, draw_fill_rect(tg, 10, 5, 20, 20, INVERT));
+  BENCH("draw_fill_rect (full)", 10000, draw_fill_rect(tg, 0, 0, 128, 64, INVERT));
+  BENCH("draw_circle (r=30)", 100000, draw_circle(tg, 63, 31, 30, INVERT));
+  BENCH("draw_fill_circle (r=30)", 20000, draw_fill_circle(tg, 63, 31, 30, INVERT));
+  BENCH("draw_fill_ellipse (60x25)", 20000, draw_fill_ellipse(tg, 63, 31, 60, 25, INVERT));
+  BENCH("draw_arc (r=30, 270 deg, 4)", 20000, draw_arc(tg, 63, 31, 30, 135, 45, 4, INVERT));
+  BENCH("draw_fill_round_rect (60x20)", 50000, draw_fill_round_rect(tg, 10, 5, 60, 20, 6, INVERT));
+  BENCH("draw_fill_triangle", 50000, draw_fill_triangle(tg, 63, 40, 10, 3, 100, 12, INVERT));
+
+  static uint8_t icon[4 * 32];
+  memset(icon, 0x5A, sizeof(icon));
+  BENCH("blit pages (32x32, y=3)", 100000, blit(tg, 10, 3, 32, 32, icon, NULL, BITMAP_PAGES, INVERT));
+  BENCH("blit rows (32x32, y=3)", 100000, blit(tg, 10, 3, 32, 32, icon, NULL, BITMAP_ROWS, INVERT));
+  BENCH("blit rows + mask (32x32)", 100000, blit(tg, 10, 3, 32, 32, icon, icon, BITMAP_ROWS, WHITE));
+
+  tinygrafx_t pane = tg;
+  clip_set(&pane, 32, 12, 64, 40);
+  BENCH("draw_circle (r=30, clipped)", 100000, draw_circle(pane, 63, 31, 30, INVERT));
+  BENCH("draw_line (diagonal, clipped)", 200000, draw_line(pane, 0, 0, 127, 63, INVERT));
+
+  tinygrafx_t back, sprite;
+  canvas_init(&back, 128, 64);
+  canvas_init(&sprite, 24, 20);
+  draw_fill_circle(sprite, 11, 9, 9, WHITE);
+  BENCH("composite (background copy)", 100000, composite(tg, 0, 0, back, 0, 0, 128, 64, ROP_COPY));
+  BENCH("composite (24x20, y=3, xor)", 100000, composite(tg, 10, 3, sprite, 0, 0, 24, 20, ROP_XOR));
+  canvas_free(&back);
+  canvas_free(&sprite);
+
+  static uint8_t photo[64 * 64];
+  for (int16_t i = 0; i < 64 * 64; i++) photo[i] = (i % 64) * 4 + (i / 64);
+  BENCH("gray_image (64x64, bayer)", 20000, gray_image(tg, 32, 0, 64, 64, photo, DITHER_BAYER, 0));
+  BENCH("gray_image (64x64, diffusion)", 20000, gray_image(tg, 32, 0, 64, 64, photo, DITHER_DIFFUSION, 0));
+
+  BENCH("scroll (full, dx=-1)", 100000, scroll_region(tg, 0, 0, 128, 64, -1, 0));
+  BENCH("scroll (full, dy=8)", 100000, scroll_region(tg, 0, 0, 128, 64, 0, 8));
+  BENCH("scroll (full, dy=3)", 100000, scroll_region(tg, 0, 0, 128, 64, 0, 3));
+
+  for (int16_t size = 1; size <= 7; size++) {
+    snprintf(name, sizeof(name), "display_text (size %d)", size);
+    BENCH(name, 20000 / size, display_text(tg, 0, 0, (uint8_t *)"mruby", 5, INVERT, size, NULL));
+  }
+  BENCH("display_text (prop8)", 20000, display_text(tg, 0, 0, (uint8_t *)"mruby", 5, INVERT, 1, tinyfont_find("prop8")));
+}
+
+static void
+flush_report(const char *name, long frames, double elapsed)
+{
+  printf("%-28s %10ld %12.1f ns/op %8.1f bytes/frame %6.1f transactions/frame %5u bytes max\n",
+         name, frames, elapsed / frames,
+         (double)mock_bus_stats.bus_bytes / frames,
+         (double)mock_bus_stats.transactions / frames,
+         mock_bus_stats.max_transaction);
+}
+
+#define FLUSH_BENCH(name, frames, body) do {                 \
+    mock_bus_reset();                                        \
+    double start_ = now_ns();                                \
+    for (long i_ = 0; i_ < (frames); i_++) { body; }         \
+    flush_report(name, (frames), now_ns() - start_);         \
+  } while (0)
+
+static void
+bench_flush(void)
+{
+  tinygrafx_t *tg = &dev.tg;
+
+  FLUSH_BENCH("flush full", 20000, ssd1306_flush(&dev, tg, FLUSH_FULL));
+  ssd1306_bus_set(&dev, 128, 0);
+  FLUSH_BENCH("flush full (chunk 128)", 20000, ssd1306_flush(&dev, tg, FLUSH_FULL));
+  ssd1306_bus_set(&dev, 32, 0);
+  FLUSH_BENCH("flush full (chunk 32)", 20000, ssd1306_flush(&dev, tg, FLUSH_FULL));
+  ssd1306_bus_set(&dev, 0, 0);
+
+  FLUSH_BENCH("flush dirty (5 chars)", 20000,
+              display_text(*tg, 40, 24, (uint8_t *)"12:34", 5, INVERT, 1, NULL);
+              ssd1306_flush(&dev, tg, FLUSH_DIRTY));
+
+  FLUSH_BENCH("flush dirty (nothing)", 20000, ssd1306_flush(&dev, tg, FLUSH_DIRTY));
+
+  // 32x16 spinner: a blank key frame, then delta frames flipping it
+  static const uint8_t spinner[] = {
+    'F', 'S', FSTREAM_VERSION, 32, 2, 3, 0,
+    FSTREAM_KEY, 0, 0,
+    FSTREAM_DELTA, 4, 0, 0x9E, 0xFF, 0x9E, 0x0F,
+    FSTREAM_DELTA, 4, 0, 0x9E, 0xFF, 0x9E, 0x0F
+  };
+  fstream_t fs;
+  fstream_open(&fs, spinner, sizeof(spinner));
+  FLUSH_BENCH("frame stream (32x16) + dirty", 20000,
+              if (fstream_next(&fs, *tg, 48, 3) != ESP_OK) {
+                fstream_rewind(&fs);
+                fstream_next(&fs, *tg, 48, 3);
+              }
+              ssd1306_flush(&dev, tg, FLUSH_DIRTY));
+
+  // one-pixel ticker step in the bottom 16 rows
+  FLUSH_BENCH("ticker scroll + dirty", 20000,
+              scroll_region(*tg, 0, 48, 128, 16, -1, 0);
+              draw_vertical_line(*tg, 127, 48 + (i_ & 15), 1, WHITE);
+              ssd1306_flush(&dev, tg, FLUSH_DIRTY));
+}
+
+static void
+bench_shadow(void)
+{
+  tinygrafx_t *tg = &dev.tg;
+
+  ssd1306_flush(&dev, tg, FLUSH_FULL);
+  FLUSH_BENCH("flush shadow (same frame)", 20000,
+              buffer_clear(*tg);
+              display_text(*tg, 40, 24, (uint8_t *)"12:34", 5, WHITE, 1, NULL);
+              ssd1306_flush(&dev, tg, FLUSH_DIRTY));
+}
+
+// A static layout where only the clock changes: redrawing everything
+// against re-rendering the display list.
+static void
+layout(int16_t second, display_list_t *dl)
+{
+  tinygrafx_t tg = dev.tg;
+  char value[6];
+  int16_t frame[4] = { 0, 0, 128, 64 };
+  int16_t title[2] = { 4, 4 };
+  int16_t digits[2] = { 40, 28 };
+  int16_t bar[4] = { 4, 50, 0, 8 };
+
+  snprintf(value, sizeof(value), "12:%02d", second % 60);
+  bar[2] = 2 * (second % 60);
+  if (dl == NULL) {
+    buffer_clear(tg);
+    draw_rect(tg, 0, 0, 128, 64, WHITE);
+    display_text(tg, 4, 4, (uint8_t *)"temperature", 11, WHITE, 1, NULL);
+    display_text(tg, 40, 28, (uint8_t *)value, 5, WHITE, 1, NULL);
+    draw_fill_rect(tg, 4, 50, bar[2], 8, WHITE);
+    return;
+  }
+  dl_set(dl, 1, DL_RECT, frame, NULL, 0, WHITE, 1, NULL);
+  dl_set(dl, 2, DL_TEXT, title, (uint8_t *)"temperature", 11, WHITE, 1, NULL);
+  dl_set(dl, 3, DL_TEXT, digits, (uint8_t *)value, 5, WHITE, 1, NULL);
+  dl_set(dl, 4, DL_FILL_RECT, bar, NULL, 0, WHITE, 1, NULL);
+  dl_render(dl, tg);
+}
+
+static void
+bench_display_list(void)
+{
+  tinygrafx_t *tg = &dev.tg;
+  display_list_t dl;
+
+  memset(&dl, 0, sizeof(dl));
+  ssd1306_flush(&dev, tg, FLUSH_FULL);
+  FLUSH_BENCH("layout redraw + dirty", 20000,
+              layout(i_, NULL);
+              ssd1306_flush(&dev, tg, FLUSH_DIRTY));
+  FLUSH_BENCH("layout render + dirty", 20000,
+              layout(i_, &dl);
+              ssd1306_flush(&dev, tg, FLUSH_DIRTY));
+  dl_free(&dl);
+}
+
+// Two panels on one bus, sent page by page in turn
+static void
+bench_group(void)
+{
+  static ssd1306_t second;
+  ssd1306_t *devs[2] = { &dev, &second };
+  int16_t modes[2] = { FLUSH_DIRTY, FLUSH_DIRTY };
+
+  if (tinygrafx_init(&second.tg, 128, 32, 0) != ESP_OK) return;
+  transport_i2c_init(&second.bus, I2C_NUM_0, 0x3D);
+  FLUSH_BENCH("group (2 panels) full", 20000,
+              dirty_all(dev.tg);
+              dirty_all(second.tg);
+              ssd1306_flush_interleaved(devs, modes, 2));
+  FLUSH_BENCH("group (2 panels) 5 chars", 20000,
+              display_text(dev.tg, 40, 24, (uint8_t *)"12:34", 5, INVERT, 1, NULL);
+              display_text(second.tg, 40, 8, (uint8_t *)"12:34", 5, INVERT, 1, NULL);
+              ssd1306_flush_interleaved(devs, modes, 2));
+  tinygrafx_free(&second.tg);
+}
+
+// The same frames over 4-wire SPI: no control bytes, a command transfer
+// and a data transfer per window. Then through the recording transport.
+static void
+bench_spi(void)
+{
+  tinygrafx_t *tg = &dev.tg;
+  static mock_transport_t rec;
+
+  mock_spi_dc_pin = 4;
+  if (transport_spi_init(&dev.bus, SPI2_HOST, 5, 4, 16, 8000000) != ESP_OK) return;
+  FLUSH_BENCH("spi flush full", 20000, ssd1306_flush(&dev, tg, FLUSH_FULL));
+  FLUSH_BENCH("spi flush dirty (5 chars)", 20000,
+              display_text(*tg, 40, 24, (uint8_t *)"12:34", 5, INVERT, 1, NULL);
+              ssd1306_flush(&dev, tg, FLUSH_DIRTY));
+  transport_release(&dev.bus);
+
+  mock_transport_init(&dev.bus, &rec);
+  FLUSH_BENCH("recorded dirty (5 chars)", 20000,
+              display_text(*tg, 40, 24, (uint8_t *)"12:34", 5, INVERT, 1, NULL);
+              ssd1306_flush(&dev, tg, FLUSH_DIRTY));
+  printf("recorded: %u transactions, the first %u command bytes and %u bytes in %u segments\n",
+         rec.count, rec.log[0].command_length, rec.log[0].data_length, rec.log[0].segments);
+  transport_i2c_init(&dev.bus, I2C_NUM_0, 0x3C);
+}
+
+// SH1106 panel: one transaction per page
+static void
+bench_sh1106(void)
+{
+  tinygrafx_t *tg = &dev.tg;
+
+  FLUSH_BENCH("sh1106 flush full", 20000, ssd1306_flush(&dev, tg, FLUSH_FULL));
+  FLUSH_BENCH("sh1106 flush dirty (5 chars)", 20000,
+              display_text(*tg, 40, 24, (uint8_t *)"12:34", 5, INVERT, 1, NULL);
+              ssd1306_flush(&dev, tg, FLUSH_DIRTY));
+}
+
+int
+main(int argc, char *argv[])
+{
+  if (tinygrafx_init(&dev.tg, 128, 64, 0) != ESP_OK) {
+    fprintf(stderr, "cannot allocate the frame buffer\n");
+    return 1;
+  }
+  transport_i2c_init(&dev.bus, I2C_NUM_0, 0x3C);
+
+  printf("%-28s %10s %12s\n", "benchmark", "iterations", "time");
+  bench_primitives();
+  bench_flush();
+  bench_display_list();
+  bench_group();
+#ifdef TINYGRAFX_STATS
+  printf("counters: %u pixels, %u transactions, %u bytes, flush %u/%llu/%u us (min/avg/max)\n",
+         dev.tg.stats->pixels, dev.tg.stats->transactions, dev.tg.stats->bytes,
+         dev.tg.stats->flush_us_min, (unsigned long long)(dev.tg.stats->flush_us_total / dev.tg.stats->flushes),
+         dev.tg.stats->flush_us_max);
+#endif
+  tinygrafx_free(&dev.tg);
+
+  if (tinygrafx_init(&dev.tg, 128, 64, 1) != ESP_OK) {
+    fprintf(stderr, "cannot allocate the frame buffer\n");
+    return 1;
+  }
+  bench_shadow();
+  tinygrafx_free(&dev.tg);
+
+  if (tinygrafx_init(&dev.tg, 128, 64, 0) != ESP_OK) {
+    fprintf(stderr, "cannot allocate the frame buffer\n");
+    return 1;
+  }
+  bench_spi();
+  tinygrafx_free(&dev.tg);
+
+  mock_sh1106 = 1;
+  if ((ssd1306_geometry(&dev, 128, 64, CTRL_SH1106, -1) != ESP_OK) ||
+      (tinygrafx_init(&dev.tg, 128, 64, 0) != ESP_OK)) {
+    fprintf(stderr, "cannot allocate the frame buffer\n");
+    return 1;
+  }
+  bench_sh1106();
+  tinygrafx_free(&dev.tg);
+
+  return 0;
+}
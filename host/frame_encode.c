@@ -0,0 +1,242 @@
+// ===================================================================
+//
+//    Frame stream encoder (host tool)
+//
+// ===================================================================
+//
+// Turns a sequence of PBM frames into a frame stream for oled.play.
+// The first frame is a KEY frame; each following frame is stored as a
+// DELTA against the previous one unless a KEY frame is smaller or a key
+// interval is due.
+//
+//   frame_encode [-k interval] [-r NAME] [-o out] frame0.pbm frame1.pbm ...
+//
+// -r writes Ruby source (NAME = "...") instead of the binary stream.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bitmap_import.h"
+#include "frame_stream.h"
+
+static uint8_t *
+read_file(const char *path, size_t *length)
+{
+  FILE *fp = fopen(path, "rb");
+  uint8_t *data = NULL;
+  long size;
+
+  if (fp == NULL) return NULL;
+  if ((fseek(fp, 0, SEEK_END) == 0) && ((size = ftell(fp)) >= 0) && (fseek(fp, 0, SEEK_SET) == 0)) {
+    data = (uint8_t *)malloc(size + 1);
+    if ((data != NULL) && (fread(data, 1, size, fp) != (size_t)size)) {
+      free(data);
+      data = NULL;
+    }
+    *length = size;
+  }
+  fclose(fp);
+  return data;
+}
+
+// Load a PBM frame into frame buffer order (w bytes per page)
+static int
+load_frame(const char *path, int16_t *w, int16_t *h, uint8_t **frame)
+{
+  size_t length;
+  uint8_t *src = read_file(path, &length);
+  uint8_t *rows;
+  int16_t pages, stride;
+
+  if (src == NULL) {
+    fprintf(stderr, "%s: cannot read\n", path);
+    return -1;
+  }
+  if (pbm_decode((const char *)src, length, w, h, NULL) != ESP_OK) {
+    fprintf(stderr, "%s: not a PBM image\n", path);
+    free(src);
+    return -1;
+  }
+  stride = (*w + 7) / 8;
+  pages = (*h + 7) / 8;
+  rows = (uint8_t *)malloc(stride * *h);
+  *frame = (uint8_t *)calloc(*w * pages, 1);
+  if ((rows == NULL) || (*frame == NULL) ||
+      (pbm_decode((const char *)src, length, w, h, rows) != ESP_OK)) {
+    fprintf(stderr, "%s: broken PBM image\n", path);
+    free(src);
+    free(rows);
+    return -1;
+  }
+  for (int16_t y = 0; y < *h; y++) {
+    for (int16_t x = 0; x < *w; x++) {
+      if ((rows[y * stride + x / 8] >> (7 - (x & 7))) & 0x01) {
+        (*frame)[(y / 8) * *w + x] |= 1 << (y & 7);
+      }
+    }
+  }
+  free(src);
+  free(rows);
+  return 0;
+}
+
+static size_t
+run_length(const uint8_t *bytes, size_t n, size_t i)
+{
+  size_t run = 1;
+  while ((i + run < n) && (run < 129) && (bytes[i + run] == bytes[i])) run++;
+  return run;
+}
+
+// Byte-run code of n bytes, trailing zero bytes are left out. Returns
+// the payload size.
+static size_t
+pack(const uint8_t *bytes, size_t n, uint8_t *out)
+{
+  size_t i = 0, o = 0;
+
+  while ((n > 0) && (bytes[n - 1] == 0)) n--;
+
+  while (i < n) {
+    size_t start = i;
+    size_t run = run_length(bytes, n, i);
+
+    if (run >= 2) {
+      out[o++] = 0x80 | (run - 2);
+      out[o++] = bytes[i];
+      i += run;
+      continue;
+    }
+    // literal up to the next run of 3 (a run of 2 costs as much inside)
+    while ((i < n) && (i - start < 128) && (run_length(bytes, n, i) < 3)) i++;
+    out[o++] = i - start - 1;
+    memcpy(out + o, bytes + start, i - start);
+    o += i - start;
+  }
+  return o;
+}
+
+static void
+write_ruby(FILE *out, const char *name, const uint8_t *data, size_t length)
+{
+  fprintf(out, "%s = \"", name);
+  for (size_t i = 0; i < length; i++) {
+    if ((i > 0) && (i % 32 == 0)) fprintf(out, "\" \\\n  \"");
+    fprintf(out, "\\x%02X", data[i]);
+  }
+  fprintf(out, "\"\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int opt, key_interval = 0;
+  const char *output = NULL, *ruby_name = NULL;
+  int16_t width = 0, height = 0, pages;
+  uint8_t *prev = NULL, *stream = NULL;
+  size_t length = FSTREAM_HEADER_SIZE, frame_size = 0;
+  int frames;
+
+  while ((opt = getopt(argc, argv, "k:r:o:")) != -1) {
+    switch (opt) {
+      case 'k': key_interval = atoi(optarg); break;
+      case 'r': ruby_name = optarg; break;
+      case 'o': output = optarg; break;
+      default:
+        fprintf(stderr, "usage: %s [-k interval] [-r NAME] [-o out] frame.pbm...\n", argv[0]);
+        return 1;
+    }
+  }
+  frames = argc - optind;
+  if ((frames <= 0) || (frames > 0xFFFF)) {
+    fprintf(stderr, "usage: %s [-k interval] [-r NAME] [-o out] frame.pbm...\n", argv[0]);
+    return 1;
+  }
+
+  for (int n = 0; n < frames; n++) {
+    uint8_t *frame, *diff, *key_payload, *delta_payload;
+    size_t key_size, delta_size;
+    int16_t w, h;
+
+    if (load_frame(argv[optind + n], &w, &h, &frame) != 0) return 1;
+    if (n == 0) {
+      width = w;
+      height = h;
+      pages = (height + 7) / 8;
+      if ((width > 255) || (pages > 255)) {
+        fprintf(stderr, "%s: frame is too large\n", argv[optind]);
+        return 1;
+      }
+      frame_size = width * pages;
+      // worst case: one control byte per 128 literal bytes
+      stream = (uint8_t *)malloc(FSTREAM_HEADER_SIZE +
+                                 frames * (FSTREAM_FRAME_HEADER + frame_size + frame_size / 128 + 1));
+      if (stream == NULL) return 1;
+    }
+    else if ((w != width) || (h != height)) {
+      fprintf(stderr, "%s: size differs from the first frame\n", argv[optind + n]);
+      return 1;
+    }
+
+    diff = (uint8_t *)malloc(frame_size);
+    key_payload = (uint8_t *)malloc(frame_size + frame_size / 128 + 1);
+    delta_payload = (uint8_t *)malloc(frame_size + frame_size / 128 + 1);
+    if ((diff == NULL) || (key_payload == NULL) || (delta_payload == NULL)) return 1;
+
+    key_size = pack(frame, frame_size, key_payload);
+    delta_size = key_size + 1;
+    if ((prev != NULL) && !((key_interval > 0) && (n % key_interval == 0))) {
+      for (size_t i = 0; i < frame_size; i++) diff[i] = frame[i] ^ prev[i];
+      delta_size = pack(diff, frame_size, delta_payload);
+    }
+
+    if (delta_size < key_size) {
+      stream[length] = FSTREAM_DELTA;
+      memcpy(stream + length + FSTREAM_FRAME_HEADER, delta_payload, delta_size);
+    }
+    else {
+      stream[length] = FSTREAM_KEY;
+      memcpy(stream + length + FSTREAM_FRAME_HEADER, key_payload, key_size);
+      delta_size = key_size;
+    }
+    stream[length + 1] = delta_size & 0xFF;
+    stream[length + 2] = delta_size >> 8;
+    length += FSTREAM_FRAME_HEADER + delta_size;
+
+    free(prev);
+    free(diff);
+    free(key_payload);
+    free(delta_payload);
+    prev = frame;
+  }
+  free(prev);
+
+  stream[0] = 'F';
+  stream[1] = 'S';
+  stream[2] = FSTREAM_VERSION;
+  stream[3] = width;
+  stream[4] = (height + 7) / 8;
+  stream[5] = frames & 0xFF;
+  stream[6] = frames >> 8;
+
+  FILE *out = (output != NULL) ? fopen(output, ruby_name ? "w" : "wb") : stdout;
+  if (out == NULL) {
+    fprintf(stderr, "%s: cannot write\n", output);
+    return 1;
+  }
+  if (ruby_name != NULL) {
+    write_ruby(out, ruby_name, stream, length);
+  }
+  else {
+    fwrite(stream, 1, length, out);
+  }
+  if (out != stdout) fclose(out);
+
+  fprintf(stderr, "%d frames of %dx%d: %zu bytes (%zu raw)\n",
+          frames, width, height, length, (size_t)frames * frame_size);
+  free(stream);
+  return 0;
+}
@@ -0,0 +1,24 @@
+// Host build mock of esp-idf driver/gpio.h, the levels are kept by
+// mock_spi.c so the D/C pin tells commands from data
+#ifndef DRIVER_GPIO_H_
+#define DRIVER_GPIO_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef int gpio_num_t;
+
+typedef enum {
+  GPIO_MODE_INPUT = 1,
+  GPIO_MODE_OUTPUT = 2
+} gpio_mode_t;
+
+#define GPIO_NUM_MAX            49
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num);
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode);
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level);
+int gpio_get_level(gpio_num_t gpio_num);
+
+#endif /* DRIVER_GPIO_H_ */
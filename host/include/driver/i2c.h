@@ -0,0 +1,33 @@
+// Host build mock of esp-idf driver/i2c.h
+//
+// The command link records the bytes of each transaction and
+// i2c_master_cmd_begin feeds them to a model of the SSD1306 GDDRAM,
+// see mock_panel.h.
+#ifndef DRIVER_I2C_H_
+#define DRIVER_I2C_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef int i2c_port_t;
+typedef void *i2c_cmd_handle_t;
+
+#define I2C_NUM_0               0
+#define I2C_NUM_1               1
+#define I2C_NUM_MAX             2
+#define I2C_MASTER_WRITE        0
+#define I2C_MASTER_READ         1
+
+i2c_cmd_handle_t i2c_cmd_link_create(void);
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle);
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle);
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle);
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en);
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd_handle, const uint8_t *data, size_t data_len, bool ack_en);
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait);
+
+#endif /* DRIVER_I2C_H_ */
@@ -0,0 +1,48 @@
+// Host build mock of esp-idf driver/spi_master.h
+//
+// A device added to a host records its transfers, mock_spi.c hands them
+// to the panel model with the level of the D/C pin, see mock_panel.h.
+#ifndef DRIVER_SPI_MASTER_H_
+#define DRIVER_SPI_MASTER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef enum {
+  SPI1_HOST = 0,
+  SPI2_HOST = 1,
+  SPI3_HOST = 2,
+  SPI_HOST_MAX = 3
+} spi_host_device_t;
+
+typedef struct spi_device_t *spi_device_handle_t;
+
+typedef struct spi_device_interface_config_t {
+  uint8_t mode;
+  int clock_speed_hz;
+  int spics_io_num;
+  uint32_t flags;
+  int queue_size;
+} spi_device_interface_config_t;
+
+typedef struct spi_transaction_t {
+  uint32_t flags;
+  size_t length;                // bits
+  size_t rxlength;
+  void *user;
+  const void *tx_buffer;
+  void *rx_buffer;
+} spi_transaction_t;
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *dev_config,
+                             spi_device_handle_t *handle);
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle);
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans_desc,
+                                 TickType_t ticks_to_wait);
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans_desc,
+                                      TickType_t ticks_to_wait);
+
+#endif /* DRIVER_SPI_MASTER_H_ */
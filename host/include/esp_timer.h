@@ -0,0 +1,17 @@
+// Host build stub of esp-idf esp_timer.h
+#ifndef ESP_TIMER_H_
+#define ESP_TIMER_H_
+
+#include <stdint.h>
+#include <time.h>
+
+// microseconds since an arbitrary start
+static inline int64_t
+esp_timer_get_time(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif /* ESP_TIMER_H_ */
@@ -0,0 +1,19 @@
+// Host build stub of FreeRTOS.h, types only
+#ifndef FREERTOS_H_
+#define FREERTOS_H_
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+
+#define portTICK_RATE_MS        1
+#define portTICK_PERIOD_MS      1
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  1
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
+
+#endif /* FREERTOS_H_ */
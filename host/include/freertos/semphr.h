@@ -0,0 +1,9 @@
+// Host build stub of FreeRTOS semphr.h, types only
+#ifndef FREERTOS_SEMPHR_H_
+#define FREERTOS_SEMPHR_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef void *SemaphoreHandle_t;
+
+#endif /* FREERTOS_SEMPHR_H_ */
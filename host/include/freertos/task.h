@@ -0,0 +1,12 @@
+// Host build stub of FreeRTOS task.h, types and no-op delays
+#ifndef FREERTOS_TASK_H_
+#define FREERTOS_TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+
+#define taskYIELD()
+#define vTaskDelay(ticks)       ((void)(ticks))
+
+#endif /* FREERTOS_TASK_H_ */
@@ -0,0 +1,97 @@
+// ===================================================================
+//
+//    Mock I2C master for the host build
+//
+// ===================================================================
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "driver/i2c.h"
+#include "mock_panel.h"
+
+// command link, the bytes of one transaction
+typedef struct mock_link_t {
+  uint8_t *data;
+  size_t length;
+  size_t capacity;
+} mock_link_t;
+
+// Decode one transaction: address byte, then control byte / payload
+// pairs. A CMDSINGLE control byte is followed by one byte, a stream
+// control byte by the rest of the transaction.
+static void
+panel_transaction(const uint8_t *bytes, size_t length)
+{
+  size_t i = 1;
+
+  while (i < length) {
+    uint8_t control = bytes[i++];
+    size_t n = (control & 0x80) ? 1 : length - i;
+
+    if (n > length - i) n = length - i;
+    mock_panel_write((control & 0x40) != 0, bytes + i, n);
+    i += n;
+  }
+}
+
+i2c_cmd_handle_t
+i2c_cmd_link_create(void)
+{
+  return calloc(1, sizeof(mock_link_t));
+}
+
+void
+i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle)
+{
+  mock_link_t *link = cmd_handle;
+  free(link->data);
+  free(link);
+}
+
+esp_err_t
+i2c_master_start(i2c_cmd_handle_t cmd_handle)
+{
+  ((mock_link_t *)cmd_handle)->length = 0;
+  return ESP_OK;
+}
+
+esp_err_t
+i2c_master_stop(i2c_cmd_handle_t cmd_handle)
+{
+  return ESP_OK;
+}
+
+esp_err_t
+i2c_master_write(i2c_cmd_handle_t cmd_handle, const uint8_t *data, size_t data_len, bool ack_en)
+{
+  mock_link_t *link = cmd_handle;
+
+  if (link->length + data_len > link->capacity) {
+    link->capacity = (link->length + data_len) * 2;
+    link->data = realloc(link->data, link->capacity);
+  }
+  memcpy(link->data + link->length, data, data_len);
+  link->length += data_len;
+  return ESP_OK;
+}
+
+esp_err_t
+i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en)
+{
+  return i2c_master_write(cmd_handle, &data, 1, ack_en);
+}
+
+esp_err_t
+i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait)
+{
+  mock_link_t *link = cmd_handle;
+
+  if (mock_bus_error != ESP_OK) {
+    return mock_bus_error;
+  }
+  mock_bus_count(link->length);
+  panel_transaction(link->data, link->length);
+  return ESP_OK;
+}
@@ -0,0 +1,119 @@
+// ===================================================================
+//
+//    Mock SSD1306 panel for the host build
+//
+// ===================================================================
+
+#include <string.h>
+
+#include "esp_err.h"
+#include "mock_panel.h"
+
+mock_bus_stats_t mock_bus_stats;
+uint8_t mock_gddram[MOCK_GDDRAM_PAGES][MOCK_GDDRAM_COLUMNS];
+int32_t mock_bus_error = ESP_OK;
+uint8_t mock_sh1106 = 0;
+
+// SSD1306 addressing state
+static struct {
+  uint8_t mode;                 // 0 = horizontal, 2 = page addressing
+  uint8_t col_start, col_end, col;
+  uint8_t page_start, page_end, page;
+} panel = { 0, 0, 127, 0, 0, 7, 0 };
+
+// command being received, a command and its parameters may come in
+// several writes
+static uint8_t cmd[8];
+static int pending = 0, params = 0;
+
+// number of parameter bytes following a command
+static int
+command_params(uint8_t cmd)
+{
+  switch (cmd) {
+    case 0x21: case 0x22: case 0xA3: return 2;
+    case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3:
+    case 0xD5: case 0xD9: case 0xDA: case 0xDB: case 0xAD: return 1;
+    case 0x26: case 0x27: return 6;
+    case 0x29: case 0x2A: return 5;
+    default: return 0;
+  }
+}
+
+static void
+panel_command(const uint8_t *cmd)
+{
+  // SH1106 has page addressing only
+  if (mock_sh1106) {
+    panel.mode = 2;
+    if ((cmd[0] >= 0x20) && (cmd[0] <= 0x22)) return;
+  }
+  switch (cmd[0]) {
+    case 0x20: panel.mode = cmd[1] & 0x03; break;
+    case 0x21: panel.col_start = panel.col = cmd[1]; panel.col_end = cmd[2]; break;
+    case 0x22: panel.page_start = panel.page = cmd[1] & 0x07; panel.page_end = cmd[2] & 0x07; break;
+    default:
+      if ((cmd[0] & 0xF8) == 0xB0) panel.page = cmd[0] & 0x07;
+      else if (cmd[0] <= 0x0F) panel.col = (panel.col & 0xF0) | cmd[0];
+      else if (cmd[0] <= 0x1F) panel.col = (panel.col & 0x0F) | ((cmd[0] & 0x0F) << 4);
+      break;
+  }
+}
+
+static void
+panel_data(uint8_t data)
+{
+  if (panel.col < MOCK_GDDRAM_COLUMNS) {
+    mock_gddram[panel.page][panel.col] = data;
+  }
+  mock_bus_stats.data_bytes++;
+
+  if (panel.mode == 2) {
+    panel.col++;
+    return;
+  }
+  if (panel.col++ >= panel.col_end) {
+    panel.col = panel.col_start;
+    if (panel.page++ >= panel.page_end) {
+      panel.page = panel.page_start;
+    }
+  }
+}
+
+void
+mock_panel_write(uint8_t dc, const uint8_t *bytes, size_t length)
+{
+  for (size_t i = 0; i < length; i++) {
+    uint8_t b = bytes[i];
+
+    if (dc) {
+      panel_data(b);
+      continue;
+    }
+    mock_bus_stats.command_bytes++;
+    if (pending == 0) {
+      params = command_params(b);
+    }
+    cmd[pending++] = b;
+    if (pending > params) {
+      panel_command(cmd);
+      pending = 0;
+    }
+  }
+}
+
+void
+mock_bus_count(size_t length)
+{
+  mock_bus_stats.transactions++;
+  mock_bus_stats.bus_bytes += length;
+  if (length > mock_bus_stats.max_transaction) {
+    mock_bus_stats.max_transaction = length;
+  }
+}
+
+void
+mock_bus_reset(void)
+{
+  memset(&mock_bus_stats, 0, sizeof(mock_bus_stats));
+}
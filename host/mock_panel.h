@@ -0,0 +1,46 @@
+// ===================================================================
+//
+//    Mock SSD1306 panel for the host build
+//
+// ===================================================================
+//
+// The mock buses (mock_i2c.c, mock_spi.c, mock_transport.c) count what
+// is sent and hand the command and data bytes to a model of an SSD1306
+// (or SH1106): addressing commands and GDDRAM writes. mock_gddram holds
+// what the panel would show.
+//
+#ifndef MOCK_PANEL_H_
+#define MOCK_PANEL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MOCK_GDDRAM_PAGES       8
+#define MOCK_GDDRAM_COLUMNS     132
+
+typedef struct mock_bus_stats_t {
+  uint32_t transactions;        // I2C transactions or SPI transfers
+  uint32_t bus_bytes;           // bytes on the bus, I2C address byte included
+  uint32_t command_bytes;       // SSD1306 command bytes
+  uint32_t data_bytes;          // GDDRAM bytes
+  uint32_t max_transaction;     // longest transaction in bytes
+} mock_bus_stats_t;
+
+extern mock_bus_stats_t mock_bus_stats;
+extern uint8_t mock_gddram[MOCK_GDDRAM_PAGES][MOCK_GDDRAM_COLUMNS];
+
+// error returned by the next transactions of every mock bus (ESP_OK = none)
+extern int32_t mock_bus_error;
+
+// decode as an SH1106 (page addressing only) instead of an SSD1306
+extern uint8_t mock_sh1106;
+
+// bytes received by the panel, dc = 0 for commands and 1 for GDDRAM data
+void mock_panel_write(uint8_t dc, const uint8_t *bytes, size_t length);
+
+// count a transaction of length bytes on the bus
+void mock_bus_count(size_t length);
+
+void mock_bus_reset(void);
+
+#endif /* MOCK_PANEL_H_ */
@@ -0,0 +1,117 @@
+// ===================================================================
+//
+//    Mock SPI master and GPIO for the host build
+//
+// ===================================================================
+//
+// A transfer is decoded when it is queued, as commands while the D/C pin
+// (mock_spi_dc_pin) is low and as GDDRAM data while it is high. Its
+// result is handed back in queue order.
+//
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "driver/spi_master.h"
+#include "driver/gpio.h"
+#include "mock_spi.h"
+#include "mock_panel.h"
+
+#define MOCK_SPI_QUEUE          16
+
+int16_t mock_spi_dc_pin = -1;
+uint32_t mock_spi_devices = 0;
+
+static uint8_t gpio_levels[GPIO_NUM_MAX];
+
+struct spi_device_t {
+  spi_host_device_t host;
+  int queue_size;
+  spi_transaction_t *queue[MOCK_SPI_QUEUE];
+  int head, count;
+};
+
+esp_err_t
+gpio_reset_pin(gpio_num_t gpio_num)
+{
+  if ((gpio_num < 0) || (gpio_num >= GPIO_NUM_MAX)) return ESP_ERR_INVALID_ARG;
+  gpio_levels[gpio_num] = 0;
+  return ESP_OK;
+}
+
+esp_err_t
+gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+  return ((gpio_num < 0) || (gpio_num >= GPIO_NUM_MAX)) ? ESP_ERR_INVALID_ARG : ESP_OK;
+}
+
+esp_err_t
+gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+  if ((gpio_num < 0) || (gpio_num >= GPIO_NUM_MAX)) return ESP_ERR_INVALID_ARG;
+  gpio_levels[gpio_num] = level ? 1 : 0;
+  return ESP_OK;
+}
+
+int
+gpio_get_level(gpio_num_t gpio_num)
+{
+  return ((gpio_num < 0) || (gpio_num >= GPIO_NUM_MAX)) ? 0 : gpio_levels[gpio_num];
+}
+
+esp_err_t
+spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *dev_config,
+                   spi_device_handle_t *handle)
+{
+  struct spi_device_t *dev;
+
+  if ((host < 0) || (host >= SPI_HOST_MAX) || (dev_config->queue_size <= 0) ||
+      (dev_config->queue_size > MOCK_SPI_QUEUE)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  dev = calloc(1, sizeof(*dev));
+  if (dev == NULL) return ESP_ERR_NO_MEM;
+  dev->host = host;
+  dev->queue_size = dev_config->queue_size;
+  *handle = dev;
+  mock_spi_devices++;
+  return ESP_OK;
+}
+
+esp_err_t
+spi_bus_remove_device(spi_device_handle_t handle)
+{
+  if (handle->count > 0) return ESP_ERR_INVALID_STATE;
+  free(handle);
+  mock_spi_devices--;
+  return ESP_OK;
+}
+
+esp_err_t
+spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans_desc, TickType_t ticks_to_wait)
+{
+  size_t length = trans_desc->length / 8;
+
+  if (mock_bus_error != ESP_OK) {
+    return mock_bus_error;
+  }
+  if (handle->count == handle->queue_size) {
+    return ESP_ERR_TIMEOUT;
+  }
+  mock_bus_count(length);
+  mock_panel_write(gpio_get_level(mock_spi_dc_pin), trans_desc->tx_buffer, length);
+  handle->queue[(handle->head + handle->count++) % MOCK_SPI_QUEUE] = trans_desc;
+  return ESP_OK;
+}
+
+esp_err_t
+spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans_desc, TickType_t ticks_to_wait)
+{
+  if (handle->count == 0) {
+    return ESP_ERR_TIMEOUT;
+  }
+  *trans_desc = handle->queue[handle->head];
+  handle->head = (handle->head + 1) % MOCK_SPI_QUEUE;
+  handle->count--;
+  return ESP_OK;
+}
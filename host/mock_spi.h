@@ -0,0 +1,21 @@
+// ===================================================================
+//
+//    Mock SPI master for the host build
+//
+// ===================================================================
+//
+// The transfers of every device go to the panel model of mock_panel.h,
+// split into commands and data by the level of the D/C pin.
+//
+#ifndef MOCK_SPI_H_
+#define MOCK_SPI_H_
+
+#include <stdint.h>
+
+// GPIO the panel D/C input is wired to
+extern int16_t mock_spi_dc_pin;
+
+// devices added and not removed
+extern uint32_t mock_spi_devices;
+
+#endif /* MOCK_SPI_H_ */
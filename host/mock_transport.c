@@ -0,0 +1,58 @@
+// ===================================================================
+//
+//    Recording panel transport for the host build
+//
+// ===================================================================
+
+#include <string.h>
+
+#include "mock_transport.h"
+#include "mock_panel.h"
+
+static esp_err_t
+mock_transport_send(transport_t *tr, const uint8_t *commands, size_t command_length,
+                    const transport_segment_t *segments, int16_t count, size_t *bus_bytes)
+{
+  mock_transport_t *rec = tr->user;
+  size_t bytes = command_length;
+
+  *bus_bytes = 0;
+  if (rec->error != ESP_OK) {
+    return rec->error;
+  }
+  mock_panel_write(0, commands, command_length);
+  for (int16_t i = 0; i < count; i++) {
+    mock_panel_write(1, segments[i].data, segments[i].length);
+    bytes += segments[i].length;
+  }
+
+  if (rec->count < MOCK_TRANSPORT_LOG) {
+    mock_transfer_t *t = &rec->log[rec->count];
+    size_t n = (command_length < MOCK_TRANSPORT_COMMANDS) ? command_length : MOCK_TRANSPORT_COMMANDS;
+
+    memcpy(t->commands, commands, n);
+    t->command_length = command_length;
+    t->segments = count;
+    t->data_length = bytes - command_length;
+  }
+  rec->count++;
+  mock_bus_count(bytes);
+
+  *bus_bytes = bytes;
+  return ESP_OK;
+}
+
+static const transport_ops_t mock_transport_ops = {
+  "mock",
+  mock_transport_send,
+  NULL
+};
+
+void
+mock_transport_init(transport_t *tr, mock_transport_t *rec)
+{
+  memset(rec, 0, sizeof(*rec));
+  rec->error = ESP_OK;
+  tr->ops = &mock_transport_ops;
+  tr->user = rec;
+}
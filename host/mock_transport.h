@@ -0,0 +1,37 @@
+// ===================================================================
+//
+//    Recording panel transport for the host build
+//
+// ===================================================================
+//
+// A transport_t that logs every transaction (its commands and the size
+// of its data) and hands the bytes to the panel model of mock_panel.h,
+// without any bus framing. Tests check the log and mock_gddram.
+//
+#ifndef MOCK_TRANSPORT_H_
+#define MOCK_TRANSPORT_H_
+
+#include <stdint.h>
+
+#include "transport.h"
+
+#define MOCK_TRANSPORT_LOG      64
+#define MOCK_TRANSPORT_COMMANDS 16
+
+typedef struct mock_transfer_t {
+  uint8_t commands[MOCK_TRANSPORT_COMMANDS];  // first ones of the transaction
+  uint16_t command_length;
+  uint16_t segments;
+  uint32_t data_length;
+} mock_transfer_t;
+
+typedef struct mock_transport_t {
+  mock_transfer_t log[MOCK_TRANSPORT_LOG];    // first transactions
+  uint32_t count;                             // transactions sent
+  esp_err_t error;                            // returned instead of sending
+} mock_transport_t;
+
+// Send tr through rec, the log starts empty
+void mock_transport_init(transport_t *tr, mock_transport_t *rec);
+
+#endif /* MOCK_TRANSPORT_H_ */
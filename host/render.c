@@ -0,0 +1,403 @@
+// ===================================================================
+//
+//    Reference renderings of the tiny graphics libraries (host tool)
+//
+// ===================================================================
+//
+// Draws every primitive, font size and color into a 128x64 frame and
+// writes one PBM per scene and color, or compares the frames with the
+// PBMs of an earlier run pixel by pixel. The golden frames are kept in
+// host/golden, make check compares against them:
+//
+//   render_tinygrafx -c golden
+//
+// A change that is meant to alter the output renders them again:
+//
+//   render_tinygrafx -o golden
+//
+// Each scene is drawn white on black, black on white and inverted on a
+// checkerboard. The exit status is 1 when a frame differs.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "tiny_grafx.h"
+#include "bitmap_import.h"
+
+#define RENDER_WIDTH    128
+#define RENDER_HEIGHT   64
+
+typedef struct scene_t {
+  const char *name;
+  void (*draw)(tinygrafx_t tg, int16_t color);
+} scene_t;
+
+static void
+scene_pixels(tinygrafx_t tg, int16_t color)
+{
+  for (int16_t i = 0; i < 200; i++) {
+    set_pixel(tg, (i * 37) % 131 - 1, (i * 11) % 67 - 1, color);
+  }
+}
+
+static void
+scene_lines(tinygrafx_t tg, int16_t color)
+{
+  for (int16_t i = 0; i < 8; i++) {
+    draw_line(tg, 63, 31, i * 18 - 2, (i & 1) ? -3 : 66, color);
+  }
+  draw_line(tg, -500, -300, 600, 400, color);
+  draw_line(tg, 5, 40, 120, 41, color);
+}
+
+static void
+scene_thick_lines(tinygrafx_t tg, int16_t color)
+{
+  draw_thick_line(tg, 4, 4, 120, 30, 3, color);
+  draw_thick_line(tg, 10, 60, 40, 5, 5, color);
+  draw_thick_line(tg, 70, 58, 126, 58, 4, color);
+}
+
+// end points at the limits of int16_t, the clip keeps the lines exact
+static void
+scene_far_lines(tinygrafx_t tg, int16_t color)
+{
+  draw_line(tg, -32768, -32768, 32767, 32767, color);
+  draw_line(tg, -32768, 32767, 32767, -32000, color);
+  draw_line(tg, 100, -32768, 110, 32767, color);
+  draw_line(tg, -32768, 50, 32767, 40, color);
+  draw_thick_line(tg, -32768, 30, 32767, 20, 3, color);
+  draw_thick_line(tg, 20, -32768, 32767, 32767, 3, color);
+}
+
+static void
+scene_hv_lines(tinygrafx_t tg, int16_t color)
+{
+  for (int16_t i = 0; i < 10; i++) {
+    draw_horizontal_line(tg, i * 5 - 4, i * 7 - 3, 40 + i * 3, color);
+    draw_vertical_line(tg, 70 + i * 6, i * 3 - 5, 20 + i * 4, color);
+  }
+}
+
+static void
+scene_rects(tinygrafx_t tg, int16_t color)
+{
+  draw_rect(tg, 2, 3, 50, 27, color);
+  draw_rect(tg, -5, 40, 20, 30, color);
+  draw_fill_rect(tg, 60, 5, 33, 19, color);
+  draw_fill_rect(tg, 100, 30, 40, 40, color);
+  draw_fill_rect(tg, 20, 35, 1, 1, color);
+}
+
+static void
+scene_circles(tinygrafx_t tg, int16_t color)
+{
+  for (int16_t r = 1; r <= 26; r += 5) {
+    draw_circle(tg, 31, 31, r, color);
+  }
+  draw_fill_circle(tg, 90, 31, 20, color);
+  draw_fill_circle(tg, 127, 0, 12, color);
+}
+
+static void
+scene_ellipses(tinygrafx_t tg, int16_t color)
+{
+  draw_ellipse(tg, 30, 31, 28, 12, color);
+  draw_ellipse(tg, 30, 31, 6, 30, color);
+  draw_fill_ellipse(tg, 95, 31, 30, 18, color);
+  draw_fill_ellipse(tg, 95, 31, 1, 0, color);
+}
+
+static void
+scene_arcs(tinygrafx_t tg, int16_t color)
+{
+  draw_arc(tg, 31, 31, 28, 200, 340, 1, color);
+  draw_arc(tg, 31, 31, 20, -45, 225, 4, color);
+  draw_pie(tg, 95, 31, 28, 30, 150, color);
+  draw_pie(tg, 95, 31, 12, 270, 45, color);
+}
+
+static void
+scene_round_rects(tinygrafx_t tg, int16_t color)
+{
+  draw_round_rect(tg, 3, 3, 56, 30, 8, color);
+  draw_round_rect(tg, 3, 38, 20, 20, 30, color);
+  draw_fill_round_rect(tg, 66, 6, 58, 52, 12, color);
+}
+
+static void
+scene_polygons(tinygrafx_t tg, int16_t color)
+{
+  static const int16_t star[] = { 95, 2, 124, 30, 95, 61, 66, 30 };
+
+  draw_fill_triangle(tg, 5, 60, 30, 2, 58, 45, color);
+  draw_fill_triangle(tg, 10, 10, 60, 12, 12, 11, color);
+  draw_fill_polygon(tg, star, 4, color);
+}
+
+static void
+scene_bitmaps(tinygrafx_t tg, int16_t color)
+{
+  static uint8_t bits[4 * 20];
+  static uint8_t mask[4 * 20];
+
+  for (int16_t i = 0; i < (int16_t)sizeof(bits); i++) {
+    bits[i] = (uint8_t)(i * 29 + 7);
+    mask[i] = (uint8_t)((i & 2) ? 0xF0 : 0x3C);
+  }
+  blit(tg, 3, 3, 20, 32, bits, NULL, BITMAP_PAGES, color);
+  blit(tg, 40, 13, 32, 20, bits, NULL, BITMAP_ROWS, color);
+  blit(tg, 85, 30, 32, 20, bits, mask, BITMAP_ROWS, color);
+  blit(tg, 120, -5, 32, 20, bits, NULL, BITMAP_ROWS, color);
+}
+
+static void
+scene_text(tinygrafx_t tg, int16_t color, int16_t fontsize)
+{
+  display_text(tg, 0, 0, (uint8_t *)"Ag0!\n~q@#", 9, color, fontsize, NULL);
+}
+
+#define SCENE_TEXT(n) \
+  static void scene_text##n(tinygrafx_t tg, int16_t color) { scene_text(tg, color, n); }
+SCENE_TEXT(1)
+SCENE_TEXT(2)
+SCENE_TEXT(3)
+SCENE_TEXT(4)
+SCENE_TEXT(5)
+SCENE_TEXT(6)
+SCENE_TEXT(7)
+
+static void
+scene_text_prop8(tinygrafx_t tg, int16_t color)
+{
+  const tinyfont_t *font = tinyfont_find("prop8");
+
+  display_text(tg, -3, 2, (uint8_t *)"AVAWAY, To. mruby\nwiggly {[quotes]}", 35, color, 1, font);
+}
+
+static void
+scene_clip(tinygrafx_t tg, int16_t color)
+{
+  tinygrafx_t pane = tg;
+
+  clip_set(&pane, 20, 10, 60, 35);
+  draw_fill_circle(pane, 30, 20, 25, color);
+  draw_line(pane, 0, 63, 127, 0, color);
+  viewport_set(&pane, 70, 30, 50, 30);
+  draw_rect(pane, -2, -2, 20, 20, color);
+  display_text(pane, 5, 12, (uint8_t *)"VP", 2, color, 2, NULL);
+}
+
+static void
+scene_scroll(tinygrafx_t tg, int16_t color)
+{
+  draw_fill_circle(tg, 40, 30, 20, color);
+  draw_rect(tg, 70, 5, 40, 50, color);
+  scroll_region(tg, 10, 3, 100, 50, -7, 3);
+}
+
+static void
+scene_composite(tinygrafx_t tg, int16_t color)
+{
+  tinygrafx_t sprite;
+
+  if (canvas_init(&sprite, 30, 21) != ESP_OK) return;
+  draw_fill_circle(sprite, 14, 10, 10, WHITE);
+  draw_line(sprite, 0, 0, 29, 20, INVERT);
+  for (uint8_t rop = 0; rop < ROP_TYPES; rop++) {
+    composite(tg, rop * 26 - 3, (rop * 13) % 50 - 3, sprite, 0, 0, 30, 21, rop);
+  }
+  canvas_free(&sprite);
+  draw_rect(tg, 0, 0, 128, 64, color);
+}
+
+static void
+scene_gray(tinygrafx_t tg, int16_t color)
+{
+  static uint8_t ramp[40 * 64];
+
+  for (int16_t i = 0; i < (int16_t)sizeof(ramp); i++) {
+    ramp[i] = (uint8_t)((i % 40) * 6 + (i / 40) / 4);
+  }
+  for (uint8_t mode = 0; mode < DITHER_TYPES; mode++) {
+    gray_image(tg, mode * 43, 0, 40, 64, ramp, mode, 0);
+  }
+  draw_horizontal_line(tg, 0, 63, 128, color);
+}
+
+static const scene_t scenes[] = {
+  { "pixels", scene_pixels },
+  { "lines", scene_lines },
+  { "thick_lines", scene_thick_lines },
+  { "far_lines", scene_far_lines },
+  { "hv_lines", scene_hv_lines },
+  { "rects", scene_rects },
+  { "circles", scene_circles },
+  { "ellipses", scene_ellipses },
+  { "arcs", scene_arcs },
+  { "round_rects", scene_round_rects },
+  { "polygons", scene_polygons },
+  { "bitmaps", scene_bitmaps },
+  { "text1", scene_text1 },
+  { "text2", scene_text2 },
+  { "text3", scene_text3 },
+  { "text4", scene_text4 },
+  { "text5", scene_text5 },
+  { "text6", scene_text6 },
+  { "text7", scene_text7 },
+  { "text_prop8", scene_text_prop8 },
+  { "clip", scene_clip },
+  { "scroll", scene_scroll },
+  { "composite", scene_composite },
+  { "gray", scene_gray },
+};
+
+static const char *color_names[] = { "black", "white", "invert" };
+
+// Background of each color, so that every color changes pixels
+static void
+background(tinygrafx_t tg, int16_t color)
+{
+  for (int16_t i = 0; i < tg.display_pixel; i++) {
+    switch (color) {
+      case WHITE:  tg.display_buffer[i] = 0x00; break;
+      case BLACK:  tg.display_buffer[i] = 0xFF; break;
+      default:     tg.display_buffer[i] = ((i / 4) & 1) ? 0x0F : 0xF0; break;
+    }
+  }
+}
+
+static uint8_t *
+read_file(const char *path, size_t *length)
+{
+  FILE *fp = fopen(path, "rb");
+  uint8_t *data = NULL;
+  long size;
+
+  if (fp == NULL) return NULL;
+  if ((fseek(fp, 0, SEEK_END) == 0) && ((size = ftell(fp)) >= 0) && (fseek(fp, 0, SEEK_SET) == 0)) {
+    data = (uint8_t *)malloc(size + 1);
+    if ((data != NULL) && (fread(data, 1, size, fp) != (size_t)size)) {
+      free(data);
+      data = NULL;
+    }
+    *length = size;
+  }
+  fclose(fp);
+  return data;
+}
+
+// Compare the rendered PBM with the stored one. Returns the number of
+// different pixels, -1 when the stored image cannot be read.
+static long
+compare(const char *path, const uint8_t *pbm, size_t size, int16_t *fx, int16_t *fy)
+{
+  size_t length;
+  uint8_t *stored = read_file(path, &length);
+  int16_t w, h, sw, sh, stride;
+  uint8_t *a, *b;
+  long diff = 0;
+
+  if (stored == NULL) return -1;
+  if ((pbm_decode((const char *)stored, length, &sw, &sh, NULL) != ESP_OK) ||
+      (pbm_decode((const char *)pbm, size, &w, &h, NULL) != ESP_OK) || (sw != w) || (sh != h)) {
+    free(stored);
+    return -1;
+  }
+  stride = (w + 7) / 8;
+  a = (uint8_t *)malloc(stride * h);
+  b = (uint8_t *)malloc(stride * h);
+  if ((a == NULL) || (b == NULL) ||
+      (pbm_decode((const char *)stored, length, &sw, &sh, a) != ESP_OK) ||
+      (pbm_decode((const char *)pbm, size, &w, &h, b) != ESP_OK)) {
+    diff = -1;
+  }
+  else {
+    for (int16_t y = 0; y < h; y++) {
+      for (int16_t x = 0; x < w; x++) {
+        uint8_t bit = 0x80 >> (x & 7);
+        if ((a[y * stride + x / 8] & bit) != (b[y * stride + x / 8] & bit)) {
+          if (diff++ == 0) {
+            *fx = x;
+            *fy = y;
+          }
+        }
+      }
+    }
+  }
+  free(stored);
+  free(a);
+  free(b);
+  return diff;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int opt, failed = 0, frames = 0;
+  const char *output = NULL, *reference = NULL;
+  tinygrafx_t tg;
+  uint8_t *pbm;
+  size_t size;
+  char path[512];
+
+  while ((opt = getopt(argc, argv, "o:c:")) != -1) {
+    switch (opt) {
+      case 'o': output = optarg; break;
+      case 'c': reference = optarg; break;
+      default:
+        fprintf(stderr, "usage: %s -o dir | -c dir\n", argv[0]);
+        return 2;
+    }
+  }
+  if ((output == NULL) == (reference == NULL)) {
+    fprintf(stderr, "usage: %s -o dir | -c dir\n", argv[0]);
+    return 2;
+  }
+
+  if (canvas_init(&tg, RENDER_WIDTH, RENDER_HEIGHT) != ESP_OK) return 2;
+  size = pbm_encode(tg.display_buffer, RENDER_WIDTH, RENDER_HEIGHT, NULL);
+  pbm = (uint8_t *)malloc(size);
+  if (pbm == NULL) return 2;
+
+  for (size_t n = 0; n < sizeof(scenes) / sizeof(scenes[0]); n++) {
+    for (int16_t color = BLACK; color <= INVERT; color++) {
+      background(tg, color);
+      scenes[n].draw(tg, color);
+      pbm_encode(tg.display_buffer, RENDER_WIDTH, RENDER_HEIGHT, pbm);
+      snprintf(path, sizeof(path), "%s/%s-%s.pbm", output ? output : reference, scenes[n].name, color_names[color]);
+      frames++;
+
+      if (output != NULL) {
+        FILE *fp = fopen(path, "wb");
+        if ((fp == NULL) || (fwrite(pbm, 1, size, fp) != size)) {
+          fprintf(stderr, "%s: cannot write\n", path);
+          return 2;
+        }
+        fclose(fp);
+      }
+      else {
+        int16_t x = 0, y = 0;
+        long diff = compare(path, pbm, size, &x, &y);
+
+        if (diff < 0) {
+          printf("%s: cannot read\n", path);
+          failed++;
+        }
+        else if (diff > 0) {
+          printf("%s: %ld pixels differ, first at (%d, %d)\n", path, diff, x, y);
+          failed++;
+        }
+      }
+    }
+  }
+  if (reference != NULL) {
+    printf("%d of %d frames differ\n", failed, frames);
+  }
+  free(pbm);
+  canvas_free(&tg);
+  return failed ? 1 : 0;
+}
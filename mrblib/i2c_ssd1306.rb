@@ -1,42 +1,185 @@
 module OLED
+  # Drawing methods written in Ruby, shared by the panels and the canvases
+  module Drawing
+    # clip(x, y, w, h) { ... } draws only inside the rectangle. viewport
+    # also makes its top left corner (0, 0). Both nest, and the previous
+    # clip comes back after the block. Without a block the clip stays
+    # until reset_clip.
+    def clip(x, y, w, h, &block)
+      with_clip(_clip(x, y, w, h, false), &block)
+    end
+
+    def viewport(x, y, w, h, &block)
+      with_clip(_clip(x, y, w, h, true), &block)
+    end
+
+    def with_clip(saved)
+      return self unless block_given?
+      begin
+        yield self
+      ensure
+        _restore_clip(saved)
+      end
+    end
+
+    # polygon(points...) outlines a polygon, fill_polygon(points...) fills
+    # a convex one. Points are [x, y] pairs or a flat list of coordinates.
+    def polygon(*points)
+      coords = points.flatten
+      n = coords.size / 2
+      n.times do |i|
+        j = (i + 1) % n
+        line(coords[2 * i], coords[2 * i + 1], coords[2 * j], coords[2 * j + 1])
+      end
+      self
+    end
+
+    def fill_polygon(*points)
+      _fill_polygon(points.flatten)
+    end
+
+    def triangle(x0, y0, x1, y1, x2, y2)
+      polygon(x0, y0, x1, y1, x2, y2)
+    end
+
+    # composite(src, x, y[, rop[, sx, sy, w, h]]) combines a rectangle of
+    # src, the whole canvas by default, with this frame at (x, y)
+    def composite(src, x, y, rop=ROP_COPY, sx=0, sy=0, w=nil, h=nil)
+      _composite(src, x, y, rop, sx, sy, w || src.width - sx, h || src.height - sy)
+    end
+
+    # gray_image(x, y, w, h, data[, options]) dithers w * h gray bytes,
+    # row by row and 0 = black, into the frame.
+    # options: mode (DITHER_BAYER, DITHER_DIFFUSION or DITHER_THRESHOLD)
+    def gray_image(x, y, w, h, data, options={})
+      _gray_image(x, y, w, h, data, options[:mode] || DITHER_BAYER)
+    end
+
+    # bitmap(x, y, w, h, data[, layout[, mask]]) or bitmap(x, y, image[, mask])
+    # with an OLED::Bitmap image and mask
+    def bitmap(x, y, *args)
+      if args[0].is_a?(Bitmap)
+        image, mask = args
+        mask = mask.data if mask.is_a?(Bitmap)
+        _bitmap(x, y, image.width, image.height, image.data, image.layout, mask)
+      else
+        _bitmap(x, y, *args)
+      end
+    end
+  end
+
   class SSD1306
-    attr_accessor :color
-    attr_accessor :fontsize
-
-    def initialize(i2c, addr=0x3c, color=1, fontsize=1, options={})
-      @i2c = i2c
-      @addr = addr
-      @color = color
-      @fontsize = fontsize
-
-      # see controller data sheet
-      @i2c.send("\x00\xAE", @addr)          # display OFF
-      @i2c.send("\x00\xA8\x3F", @addr)      # MUX ratio (0x3F = 64d -1d)
-      @i2c.send("\x00\xD3\x00", @addr)      # set display offset (no offset)
-      @i2c.send("\x00\x40", @addr)          # set display start line
-      @i2c.send("\x00\xA1", @addr)          # re-map, SEG0 is mapped to column address 127
-      @i2c.send("\x00\xC8", @addr)          # scan direction, reverse up-bottom
-      @i2c.send("\x00\xDA\x12", @addr)      # set COM pins (Alternative configuration, Disable L/R remap)
-
-      @i2c.send("\x00\x81\x7F", @addr)      # set contrast
-      @i2c.send("\x00\x2E", @addr)          # stop scrolling
-      @i2c.send("\x00\xA4", @addr)          # resume ram content display
-      @i2c.send("\x00\xd5\x00", @addr)      # set osc frequency
-      @i2c.send("\x00\x8D\x14", @addr)      # enable charge pump
-
-      @i2c.send("\x00\x20\x00", @addr)      # ADDR_MODE, 0x00 = Horizontal Mode
-      @i2c.send("\x00\x21\x00\x7f", @addr)  # COLUMN_ADDR, 0x00 = start, 0x7f = end
-      @i2c.send("\x00\x22\x00\x07", @addr)  # PAGE_ADDR, 0x00 = start, 0x7f = end
-      @i2c.send("\x00\xAF", @addr)          # display ON
-      ESP32::System.delay(200)
-
-      _init                                 # Initialize the TINYGRAFX
+    include Drawing
+
+    attr_accessor :flush_mode
+
+    # new(i2c[, addr, color, fontsize, options]) or, on a 4-wire SPI bus,
+    # new(spi, nil, color, fontsize, dc: pin[, cs:, rst:, frequency:, host:])
+    def initialize(bus, addr=0x3c, color=1, fontsize=1, options={})
+      @flush_mode = options[:flush_mode] || FLUSH_FULL
+      if options[:dc]
+        @spi = bus
+        @addr = nil
+      else
+        @i2c = bus
+        @addr = addr
+        # port the frame buffer is flushed on, the one the I2C object was opened on
+        @port = options[:port] || bus.instance_variable_get(:@port) || 0
+      end
+
+      # frame buffer and panel geometry, raises on an unsupported panel
+      _init(!!options[:shadow], options[:width] || 128, options[:height] || 64,
+            options[:controller] || CTRL_SSD1306, options[:column_offset] || -1)
+      if @spi
+        # host the SPI object set up, the panel is added as a device on it
+        _spi(options[:host] || bus.instance_variable_get(:@host) || 1, options[:cs] || -1,
+             options[:dc], options[:rst] || -1, options[:frequency] || 8_000_000)
+      end
+      # transaction size and timeout of the flush
+      bus_config(options[:chunk] || 0, options[:timeout] || 1000)
+      init_panel                            # configuration for the geometry, one transaction
+
+      self.color = color
+      self.fontsize = fontsize
 
       self
     end
 
+    # gray_image also takes mode: DITHER_TEMPORAL on a panel, then each
+    # display sends the next of options[:planes] (3) bitplanes until
+    # stop_gray or another temporal image
+    def gray_image(x, y, w, h, data, options={})
+      if options[:mode] == DITHER_TEMPORAL
+        _gray_planes(x, y, w, h, data, options[:planes] || 3)
+      else
+        super
+      end
+    end
+
+    # an SPI panel does not acknowledge, it is always ready
     def ready?
-      @i2c.ready?(@addr)
+      @spi ? true : @i2c.ready?(@addr)
+    end
+
+    # Play a frame stream made by host/frame_encode.
+    # options: fps (10), x (0), page (0), repeat (1, at least 1)
+    def play(stream, options={})
+      _play(stream, options[:fps] || 10, options[:x] || 0, options[:page] || 0, options[:repeat] || 1)
+    end
+  end
+
+  # Off-screen frame buffer of any size, drawn like a panel and
+  # composited onto a panel or another canvas
+  class Canvas
+    include Drawing
+  end
+
+  # Several panels sent together by display. Each panel keeps its own
+  # frame buffer and flush_mode.
+  class PanelGroup
+    def initialize(*panels)
+      panels.each do |panel|
+        raise ArgumentError, "PanelGroup: #{panel.class} is not a panel" unless panel.is_a?(SSD1306)
+      end
+      @panels = panels
+    end
+
+    # a frozen copy, the members are fixed by new
+    def panels
+      @panels.dup.freeze
+    end
+
+    def [](index)
+      @panels[index]
+    end
+
+    def each(&block)
+      @panels.each(&block)
+      self
+    end
+  end
+
+  # 1bpp image, data is in BITMAP_ROWS or BITMAP_PAGES layout
+  class Bitmap
+    attr_reader :width, :height, :data, :layout
+
+    def initialize(width, height, data, layout=BITMAP_ROWS)
+      @width = width
+      @height = height
+      @data = data
+      @layout = layout
+    end
+
+    # PBM (P1 or P4) image data
+    def self.pbm(src)
+      width, height, data = _pbm(src)
+      new(width, height, data)
+    end
+
+    # XBM image data (the C source text)
+    def self.xbm(src)
+      width, height, data = _xbm(src)
+      new(width, height, data)
     end
   end
 end
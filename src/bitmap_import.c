@@ -0,0 +1,186 @@
+// ===================================================================
+//
+//    PBM / XBM import for the Tiny graphics libraries
+//
+// ===================================================================
+//
+// Both formats are turned into BITMAP_ROWS bitmaps. PBM rows are already
+// MSB first, so P4 is a plain copy. XBM rows are LSB first and each byte
+// is reversed. A frame is exported as P4 for debugging and for the
+// host render tool.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "bitmap_import.h"
+
+// skip white space, commas and (PBM) comments
+static size_t
+skip_space(const char *src, size_t len, size_t i, uint8_t comments)
+{
+  while (i < len) {
+    if (comments && (src[i] == '#')) {
+      while ((i < len) && (src[i] != '\n')) i++;
+    }
+    else if ((src[i] == ' ') || (src[i] == '\t') || (src[i] == '\r') ||
+             (src[i] == '\n') || (src[i] == ',')) {
+      i++;
+    }
+    else {
+      break;
+    }
+  }
+  return i;
+}
+
+// decimal or 0x hexadecimal number at *pos, returns 0 when there is none
+static uint8_t
+read_number(const char *src, size_t len, size_t *pos, long *value)
+{
+  size_t i = *pos;
+  size_t start;
+  long v = 0;
+  int base = 10;
+
+  if ((i + 1 < len) && (src[i] == '0') && ((src[i + 1] == 'x') || (src[i + 1] == 'X'))) {
+    base = 16;
+    i += 2;
+  }
+  start = i;
+  while (i < len) {
+    int digit;
+    char c = src[i];
+    if ((c >= '0') && (c <= '9')) digit = c - '0';
+    else if ((base == 16) && (c >= 'a') && (c <= 'f')) digit = c - 'a' + 10;
+    else if ((base == 16) && (c >= 'A') && (c <= 'F')) digit = c - 'A' + 10;
+    else break;
+    if (v <= INT16_MAX) v = v * base + digit;
+    i++;
+  }
+  if (i == start) return 0;
+  *pos = i;
+  *value = v;
+  return 1;
+}
+
+// index just after the next occurrence of token, or len
+static size_t
+find_token(const char *src, size_t len, size_t i, const char *token)
+{
+  size_t n = strlen(token);
+
+  for (; i + n <= len; i++) {
+    if (memcmp(src + i, token, n) == 0) return i + n;
+  }
+  return len;
+}
+
+static esp_err_t
+check_size(long w, long h, int16_t *width, int16_t *height)
+{
+  if ((w <= 0) || (h <= 0) || (w > INT16_MAX) || (h > INT16_MAX)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *width = w;
+  *height = h;
+  return ESP_OK;
+}
+
+esp_err_t
+pbm_decode(const char *src, size_t len, int16_t *width, int16_t *height, uint8_t *out)
+{
+  size_t i = 2;
+  long w, h, stride;
+  uint8_t binary;
+
+  if ((len < 2) || (src[0] != 'P') || ((src[1] != '1') && (src[1] != '4'))) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  binary = (src[1] == '4');
+
+  i = skip_space(src, len, i, 1);
+  if (!read_number(src, len, &i, &w)) return ESP_ERR_INVALID_ARG;
+  i = skip_space(src, len, i, 1);
+  if (!read_number(src, len, &i, &h)) return ESP_ERR_INVALID_ARG;
+  if (check_size(w, h, width, height) != ESP_OK) return ESP_ERR_INVALID_ARG;
+  if (out == NULL) return ESP_OK;
+
+  stride = (w + 7) / 8;
+  if (binary) {
+    // exactly one white space character before the raster
+    i++;
+    if ((i > len) || (len - i < (size_t)(stride * h))) return ESP_ERR_INVALID_SIZE;
+    memcpy(out, src + i, stride * h);
+    return ESP_OK;
+  }
+
+  memset(out, 0, stride * h);
+  for (long y = 0; y < h; y++) {
+    for (long x = 0; x < w; x++) {
+      i = skip_space(src, len, i, 1);
+      if (i >= len) return ESP_ERR_INVALID_SIZE;
+      if (src[i] == '1') {
+        out[y * stride + x / 8] |= 0x80 >> (x & 7);
+      }
+      else if (src[i] != '0') {
+        return ESP_ERR_INVALID_ARG;
+      }
+      i++;
+    }
+  }
+  return ESP_OK;
+}
+
+esp_err_t
+xbm_decode(const char *src, size_t len, int16_t *width, int16_t *height, uint8_t *out)
+{
+  size_t i;
+  long w, h, stride, value;
+
+  // #define name_width 16 / #define name_height 16 / ... name_bits[] = { 0x00, ... };
+  i = skip_space(src, len, find_token(src, len, 0, "_width"), 0);
+  if (!read_number(src, len, &i, &w)) return ESP_ERR_INVALID_ARG;
+  i = skip_space(src, len, find_token(src, len, 0, "_height"), 0);
+  if (!read_number(src, len, &i, &h)) return ESP_ERR_INVALID_ARG;
+  if (check_size(w, h, width, height) != ESP_OK) return ESP_ERR_INVALID_ARG;
+  if (out == NULL) return ESP_OK;
+
+  i = find_token(src, len, 0, "{");
+  stride = (w + 7) / 8;
+  for (long n = 0; n < stride * h; n++) {
+    uint8_t b, r = 0;
+    i = skip_space(src, len, i, 0);
+    if (!read_number(src, len, &i, &value)) return ESP_ERR_INVALID_SIZE;
+    b = value;
+    for (int16_t bit = 0; bit < 8; bit++) {
+      r = (r << 1) | ((b >> bit) & 0x01);
+    }
+    out[n] = r;
+  }
+  return ESP_OK;
+}
+
+size_t
+pbm_encode(const uint8_t *pages, int16_t w, int16_t h, uint8_t *out)
+{
+  char header[24];
+  int16_t stride = (w + 7) / 8;
+  int length = snprintf(header, sizeof(header), "P4\n%d %d\n", w, h);
+
+  if (out == NULL) return length + (size_t)stride * h;
+
+  memcpy(out, header, length);
+  out += length;
+  memset(out, 0, (size_t)stride * h);
+  for (int16_t y = 0; y < h; y++) {
+    const uint8_t *src = pages + (y / 8) * w;
+    uint8_t bit = 1 << (y & 7);
+
+    for (int16_t x = 0; x < w; x++) {
+      if (src[x] & bit) out[y * stride + x / 8] |= 0x80 >> (x & 7);
+    }
+  }
+  return length + (size_t)stride * h;
+}
@@ -0,0 +1,18 @@
+#ifndef BITMAPIMPORTH_
+#define BITMAPIMPORTH_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// Decode PBM (P1 and P4) or XBM image data into a BITMAP_ROWS bitmap of
+// ((w + 7) / 8) * h bytes. With out == NULL only w and h are read.
+esp_err_t pbm_decode(const char *src, size_t len, int16_t *w, int16_t *h, uint8_t *out);
+esp_err_t xbm_decode(const char *src, size_t len, int16_t *w, int16_t *h, uint8_t *out);
+
+// Encode a page-ordered frame (frame buffer order, w x h pixels) as a P4
+// PBM. Returns its size; with out == NULL only the size is computed.
+size_t pbm_encode(const uint8_t *pages, int16_t w, int16_t h, uint8_t *out);
+
+#endif /* BITMAPIMPORTH_ */
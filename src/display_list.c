@@ -0,0 +1,390 @@
+// ===================================================================
+//
+//    Retained display list for the Tiny graphics libraries
+//
+// ===================================================================
+//
+// Named items are kept with the arguments they were drawn with. When an
+// item changes, its old and new bounds become damaged regions. dl_render
+// draws again only the items touching those regions and writes back just
+// the regions, so the dirty tracking hands only them to the flush.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "display_list.h"
+
+// number of int16 arguments of each item type
+static const uint8_t dl_argc[DL_TYPES] = {
+  2, 4, 4, 5, 3, 3, 5
+};
+
+static const dl_rect_t dl_empty = { 0, 0, -1, -1 };
+
+static inline uint8_t
+rect_empty(dl_rect_t r)
+{
+  return (r.x0 > r.x1) || (r.y0 > r.y1);
+}
+
+static inline uint8_t
+rect_overlap(dl_rect_t a, dl_rect_t b)
+{
+  return (a.x0 <= b.x1) && (b.x0 <= a.x1) && (a.y0 <= b.y1) && (b.y0 <= a.y1);
+}
+
+static inline dl_rect_t
+rect_union(dl_rect_t a, dl_rect_t b)
+{
+  dl_rect_t r;
+  r.x0 = (a.x0 < b.x0) ? a.x0 : b.x0;
+  r.y0 = (a.y0 < b.y0) ? a.y0 : b.y0;
+  r.x1 = (a.x1 > b.x1) ? a.x1 : b.x1;
+  r.y1 = (a.y1 > b.y1) ? a.y1 : b.y1;
+  return r;
+}
+
+static inline int32_t
+rect_area(dl_rect_t r)
+{
+  return (int32_t)(r.x1 - r.x0 + 1) * (r.y1 - r.y0 + 1);
+}
+
+// Add a damaged region. Overlapping regions are merged, so the list
+// never holds two regions that would be cleared twice.
+static void
+dl_damage(display_list_t *dl, dl_rect_t r)
+{
+  int16_t i, best;
+  int32_t growth, best_growth;
+
+  if (rect_empty(r)) return;
+
+  i = 0;
+  while (i < dl->damage_count) {
+    if (rect_overlap(dl->damage[i], r)) {
+      // the merged region may reach one that was checked before
+      r = rect_union(dl->damage[i], r);
+      dl->damage[i] = dl->damage[--dl->damage_count];
+      i = 0;
+    }
+    else {
+      i++;
+    }
+  }
+
+  if (dl->damage_count == DL_MAX_DAMAGE) {
+    // full, merge into the region that grows the least
+    best = 0;
+    best_growth = INT32_MAX;
+    for (i = 0; i < dl->damage_count; i++) {
+      growth = rect_area(rect_union(dl->damage[i], r)) - rect_area(dl->damage[i]);
+      if (growth < best_growth) {
+        best = i;
+        best_growth = growth;
+      }
+    }
+    r = rect_union(dl->damage[best], r);
+    dl->damage[best] = dl->damage[--dl->damage_count];
+    dl_damage(dl, r);
+    return;
+  }
+  dl->damage[dl->damage_count++] = r;
+}
+
+// Pixels an item covers, clipped to the frame buffer
+static dl_rect_t
+dl_bounds(tinygrafx_t tg, const dl_item_t *item)
+{
+  dl_rect_t r = dl_empty;
+  const int16_t *a = item->args;
+  int16_t pad, font_width, x, y;
+
+  switch (item->type) {
+    case DL_TEXT:
+      if (item->font != NULL) {
+        int16_t lines;
+
+        tinyfont_extent(item->font, a[0], item->data, item->length, &r.x0, &r.x1, &lines);
+        r.y0 = a[1];
+        r.y1 = a[1] + lines * item->font->height - 1;
+        break;
+      }
+      // same walk as display_text
+      if (item->fontsize < 1) break;
+      font_width = (item->fontsize & 0x01) + (item->fontsize / 2);
+      x = a[0];
+      y = a[1];
+      for (int16_t i = 0; i < item->length; i++) {
+        if (item->data[i] == '\n') {
+          x = 0;
+          y += tg.font_width * item->fontsize;
+        }
+        else {
+          dl_rect_t glyph = { x, y, x + tg.font_width * font_width - 1, y + tg.font_height * item->fontsize - 1 };
+          r = rect_empty(r) ? glyph : rect_union(r, glyph);
+          x += tg.font_width * font_width;
+        }
+      }
+      break;
+    case DL_RECT:
+    case DL_FILL_RECT:
+    case DL_BITMAP:
+      r.x0 = a[0];
+      r.y0 = a[1];
+      r.x1 = a[0] + a[2] - 1;
+      r.y1 = a[1] + a[3] - 1;
+      break;
+    case DL_LINE:
+      // a thick line stays within its width of the center line
+      pad = (a[4] > 1) ? a[4] : 0;
+      r.x0 = ((a[0] < a[2]) ? a[0] : a[2]) - pad;
+      r.x1 = ((a[0] > a[2]) ? a[0] : a[2]) + pad;
+      r.y0 = ((a[1] < a[3]) ? a[1] : a[3]) - pad;
+      r.y1 = ((a[1] > a[3]) ? a[1] : a[3]) + pad;
+      break;
+    case DL_CIRCLE:
+    case DL_FILL_CIRCLE:
+      // the midpoint loop steps once past r = 0 and negative radii
+      pad = (a[2] > 0) ? a[2] : 1 - a[2];
+      r.x0 = a[0] - pad;
+      r.x1 = a[0] + pad;
+      r.y0 = a[1] - pad;
+      r.y1 = a[1] + pad;
+      break;
+  }
+
+  if (rect_empty(r)) return dl_empty;
+  if (r.x0 < 0) r.x0 = 0;
+  if (r.y0 < 0) r.y0 = 0;
+  if (r.x1 >= tg.display_width) r.x1 = tg.display_width - 1;
+  if (r.y1 >= tg.display_height) r.y1 = tg.display_height - 1;
+  return rect_empty(r) ? dl_empty : r;
+}
+
+static void
+dl_draw(tinygrafx_t tg, const dl_item_t *item)
+{
+  const int16_t *a = item->args;
+  int16_t color = item->color;
+
+  switch (item->type) {
+    case DL_TEXT:        display_text(tg, a[0], a[1], item->data, item->length, color, item->fontsize, item->font); break;
+    case DL_RECT:        draw_rect(tg, a[0], a[1], a[2], a[3], color); break;
+    case DL_FILL_RECT:   draw_fill_rect(tg, a[0], a[1], a[2], a[3], color); break;
+    case DL_LINE:
+      if ((color < BLACK) || (color > INVERT)) {
+        color = WHITE;
+      }
+      draw_thick_line(tg, a[0], a[1], a[2], a[3], a[4], color);
+      break;
+    case DL_CIRCLE:      draw_circle(tg, a[0], a[1], a[2], color); break;
+    case DL_FILL_CIRCLE: draw_fill_circle(tg, a[0], a[1], a[2], color); break;
+    case DL_BITMAP:
+      if ((a[2] > 0) && (a[3] > 0) &&
+          (item->length >= ((a[4] == BITMAP_PAGES) ? a[2] * ((a[3] + 7) / 8) : ((a[2] + 7) / 8) * a[3]))) {
+        blit(tg, a[0], a[1], a[2], a[3], item->data, NULL, a[4], color);
+      }
+      break;
+  }
+}
+
+static dl_item_t *
+dl_find(display_list_t *dl, uint32_t name)
+{
+  for (int16_t i = 0; i < dl->count; i++) {
+    if (dl->items[i].name == name) {
+      return &dl->items[i];
+    }
+  }
+  return NULL;
+}
+
+// Add an item on top, or update the item of that name in place. Setting
+// an item to what it already is costs nothing, so a static layout can be
+// declared again on every loop.
+esp_err_t
+dl_set(display_list_t *dl, uint32_t name, uint8_t type, const int16_t *args,
+       const uint8_t *data, int16_t length, int16_t color, int16_t fontsize,
+       const tinyfont_t *font)
+{
+  int16_t argv[DL_MAX_ARGS] = { 0 };
+  dl_item_t *item;
+  uint8_t *copy = NULL;
+
+  if (type >= DL_TYPES) return ESP_ERR_INVALID_ARG;
+  memcpy(argv, args, sizeof(int16_t) * dl_argc[type]);
+  if (type != DL_TEXT) {
+    fontsize = 0;
+    font = NULL;
+  }
+
+  item = dl_find(dl, name);
+  if ((item != NULL) && (item->type == type) && (item->color == color) &&
+      (item->fontsize == fontsize) && (item->font == font) && (memcmp(item->args, argv, sizeof(argv)) == 0) &&
+      (item->length == length) && ((length == 0) || (memcmp(item->data, data, length) == 0))) {
+    return ESP_OK;
+  }
+
+  if (length > 0) {
+    copy = (uint8_t *)malloc(length);
+    if (copy == NULL) return ESP_ERR_NO_MEM;
+    memcpy(copy, data, length);
+  }
+
+  if (item == NULL) {
+    if (dl->count == dl->capacity) {
+      int16_t capacity = dl->capacity ? dl->capacity * 2 : 8;
+      dl_item_t *items = (dl_item_t *)realloc(dl->items, sizeof(dl_item_t) * capacity);
+      if (items == NULL) {
+        free(copy);
+        return ESP_ERR_NO_MEM;
+      }
+      dl->items = items;
+      dl->capacity = capacity;
+    }
+    item = &dl->items[dl->count++];
+    memset(item, 0, sizeof(dl_item_t));
+    item->name = name;
+    item->bounds = dl_empty;
+  }
+  else {
+    // the old pixels go away on the next render
+    dl_damage(dl, item->bounds);
+    free(item->data);
+  }
+
+  item->type = type;
+  item->color = color;
+  item->fontsize = fontsize;
+  item->font = font;
+  memcpy(item->args, argv, sizeof(argv));
+  item->data = copy;
+  item->length = length;
+  item->changed = 1;
+  return ESP_OK;
+}
+
+// Remove the named item, returns 0 when there is no such item
+uint8_t
+dl_remove(display_list_t *dl, uint32_t name)
+{
+  dl_item_t *item = dl_find(dl, name);
+  int16_t i;
+
+  if (item == NULL) return 0;
+
+  i = item - dl->items;
+  dl_damage(dl, item->bounds);
+  free(item->data);
+  memmove(item, item + 1, sizeof(dl_item_t) * (dl->count - i - 1));
+  dl->count--;
+  return 1;
+}
+
+// Remove every item, their pixels are cleared on the next render
+void
+dl_clear(display_list_t *dl)
+{
+  for (int16_t i = 0; i < dl->count; i++) {
+    dl_damage(dl, dl->items[i].bounds);
+    free(dl->items[i].data);
+  }
+  dl->count = 0;
+}
+
+// Draw the whole list again on the next render, for example after the
+// frame buffer was cleared
+void
+dl_invalidate(display_list_t *dl, tinygrafx_t tg)
+{
+  dl_rect_t all = { 0, 0, tg.display_width - 1, tg.display_height - 1 };
+
+  for (int16_t i = 0; i < dl->count; i++) {
+    dl->items[i].changed = 1;
+  }
+  dl_damage(dl, all);
+}
+
+// Bring the frame buffer up to date with the list. Returns the number of
+// items drawn, or -1 when the scratch page cannot be allocated.
+//
+// The damaged regions are cleared in a scratch frame and every item
+// touching them is drawn there whole. Only the damaged regions are then
+// copied into the frame buffer and marked dirty, so a large item (a
+// frame around the screen) does not drag the whole screen into a small
+// update.
+int16_t
+dl_render(display_list_t *dl, tinygrafx_t tg)
+{
+  tinygrafx_t scratch = tg;
+  int16_t i, r, drawn = 0;
+
+  for (i = 0; i < dl->count; i++) {
+    dl_item_t *item = &dl->items[i];
+    if (item->changed) {
+      item->bounds = dl_bounds(tg, item);
+      item->changed = 0;
+      dl_damage(dl, item->bounds);
+    }
+  }
+  if (dl->damage_count == 0) return 0;
+
+  if (dl->scratch == NULL) {
+    // frame and dirty ranges in one block
+    dl->scratch = (uint8_t *)malloc(tg.display_pixel + sizeof(int16_t) * tg.display_pages * 2);
+    if (dl->scratch == NULL) return -1;
+  }
+  scratch.display_buffer = dl->scratch;
+  scratch.dirty_x0 = (int16_t *)(dl->scratch + tg.display_pixel);
+  scratch.dirty_x1 = scratch.dirty_x0 + tg.display_pages;
+  scratch.shadow_buffer = NULL;
+  // items are placed in frame buffer coordinates, whatever the clip
+  clip_reset(&scratch);
+
+  for (r = 0; r < dl->damage_count; r++) {
+    dl_rect_t d = dl->damage[r];
+    draw_fill_rect(scratch, d.x0, d.y0, d.x1 - d.x0 + 1, d.y1 - d.y0 + 1, BLACK);
+  }
+  for (i = 0; i < dl->count; i++) {
+    dl_item_t *item = &dl->items[i];
+    for (r = 0; r < dl->damage_count; r++) {
+      if (rect_overlap(dl->damage[r], item->bounds)) {
+        dl_draw(scratch, item);
+        drawn++;
+        break;
+      }
+    }
+  }
+
+  for (r = 0; r < dl->damage_count; r++) {
+    dl_rect_t d = dl->damage[r];
+    for (int16_t page = d.y0 / 8; page <= d.y1 / 8; page++) {
+      uint8_t mask = 0xFF;
+      uint8_t *dst = tg.display_buffer + page * tg.display_width;
+      const uint8_t *src = scratch.display_buffer + page * tg.display_width;
+
+      if (page == d.y0 / 8) mask &= 0xFF << (d.y0 & 7);
+      if (page == d.y1 / 8) mask &= 0xFF >> (7 - (d.y1 & 7));
+      for (int16_t x = d.x0; x <= d.x1; x++) {
+        dst[x] = (dst[x] & ~mask) | (src[x] & mask);
+      }
+    }
+    dirty_mark(tg, d.x0, d.y0, d.x1, d.y1);
+  }
+  dl->damage_count = 0;
+  return drawn;
+}
+
+void
+dl_free(display_list_t *dl)
+{
+  for (int16_t i = 0; i < dl->count; i++) {
+    free(dl->items[i].data);
+  }
+  free(dl->items);
+  free(dl->scratch);
+  memset(dl, 0, sizeof(display_list_t));
+}
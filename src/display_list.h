@@ -0,0 +1,61 @@
+#ifndef DISPLAYLISTH_
+#define DISPLAYLISTH_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "tiny_grafx.h"
+
+// display list item types
+#define DL_TEXT                 0
+#define DL_RECT                 1
+#define DL_FILL_RECT            2
+#define DL_LINE                 3
+#define DL_CIRCLE               4
+#define DL_FILL_CIRCLE          5
+#define DL_BITMAP               6
+#define DL_TYPES                7
+#define DL_MAX_ARGS             5
+
+// regions re-rendered by one dl_render, more are merged together
+#define DL_MAX_DAMAGE           8
+
+typedef struct dl_rect_t {
+  int16_t x0, y0, x1, y1;     // inclusive, x0 > x1 = empty
+} dl_rect_t;
+
+// One named item. args are the arguments of the drawing primitive,
+// data is a private copy of the text or of the bitmap.
+typedef struct dl_item_t {
+  uint32_t name;
+  uint8_t type;
+  uint8_t changed;            // bounds must be computed and drawn again
+  int16_t color;
+  int16_t fontsize;
+  const tinyfont_t *font;     // font of a text item, NULL = font8x8
+  int16_t args[DL_MAX_ARGS];
+  uint8_t *data;
+  int16_t length;
+  dl_rect_t bounds;           // pixels covered in the frame buffer
+} dl_item_t;
+
+// Items are kept in drawing order, later items are drawn on top.
+typedef struct display_list_t {
+  dl_item_t *items;
+  int16_t count;
+  int16_t capacity;
+  dl_rect_t damage[DL_MAX_DAMAGE];
+  int16_t damage_count;
+  uint8_t *scratch;           // frame the damaged regions are drawn in
+} display_list_t;
+
+esp_err_t dl_set(display_list_t *dl, uint32_t name, uint8_t type, const int16_t *args,
+                 const uint8_t *data, int16_t length, int16_t color, int16_t fontsize,
+                 const tinyfont_t *font);
+uint8_t dl_remove(display_list_t *dl, uint32_t name);
+void dl_clear(display_list_t *dl);
+void dl_invalidate(display_list_t *dl, tinygrafx_t tg);
+int16_t dl_render(display_list_t *dl, tinygrafx_t tg);
+void dl_free(display_list_t *dl);
+
+#endif /* DISPLAYLISTH_ */
@@ -0,0 +1,303 @@
+// Generated by host/bdf2font from fonts/prop8.bdf, do not edit
+//
+//   ./bdf2font -n prop8 -r ascii fonts/prop8.bdf
+
+#include "tiny_font.h"
+
+static const uint8_t prop8_bitmaps[] = {
+  // '!' U+0021
+  0x06, 0x5F, 0x5F, 0x06,
+  // '"' U+0022
+  0x03, 0x03, 0x00, 0x03, 0x03,
+  // '#' U+0023
+  0x14, 0x7F, 0x7F, 0x14, 0x7F, 0x7F, 0x14,
+  // '$' U+0024
+  0x24, 0x2E, 0x6B, 0x6B, 0x3A, 0x12,
+  // '%' U+0025
+  0x46, 0x66, 0x30, 0x18, 0x0C, 0x66, 0x62,
+  // '&' U+0026
+  0x30, 0x7A, 0x4F, 0x5D, 0x37, 0x7A, 0x48,
+  // U+0027
+  0x04, 0x07, 0x03,
+  // '(' U+0028
+  0x1C, 0x3E, 0x63, 0x41,
+  // ')' U+0029
+  0x41, 0x63, 0x3E, 0x1C,
+  // '*' U+002A
+  0x08, 0x2A, 0x3E, 0x1C, 0x1C, 0x3E, 0x2A, 0x08,
+  // '+' U+002B
+  0x08, 0x08, 0x3E, 0x3E, 0x08, 0x08,
+  // ',' U+002C
+  0x80, 0xE0, 0x60,
+  // '-' U+002D
+  0x08, 0x08, 0x08, 0x08, 0x08, 0x08,
+  // '.' U+002E
+  0x60, 0x60,
+  // '/' U+002F
+  0x60, 0x30, 0x18, 0x0C, 0x06, 0x03, 0x01,
+  // '0' U+0030
+  0x3E, 0x7F, 0x71, 0x59, 0x4D, 0x7F, 0x3E,
+  // '1' U+0031
+  0x40, 0x42, 0x7F, 0x7F, 0x40, 0x40,
+  // '2' U+0032
+  0x62, 0x73, 0x59, 0x49, 0x6F, 0x66,
+  // '3' U+0033
+  0x22, 0x63, 0x49, 0x49, 0x7F, 0x36,
+  // '4' U+0034
+  0x18, 0x1C, 0x16, 0x53, 0x7F, 0x7F, 0x50,
+  // '5' U+0035
+  0x27, 0x67, 0x45, 0x45, 0x7D, 0x39,
+  // '6' U+0036
+  0x3C, 0x7E, 0x4B, 0x49, 0x79, 0x30,
+  // '7' U+0037
+  0x03, 0x03, 0x71, 0x79, 0x0F, 0x07,
+  // '8' U+0038
+  0x36, 0x7F, 0x49, 0x49, 0x7F, 0x36,
+  // '9' U+0039
+  0x06, 0x4F, 0x49, 0x69, 0x3F, 0x1E,
+  // ':' U+003A
+  0x66, 0x66,
+  // ';' U+003B
+  0x80, 0xE6, 0x66,
+  // '<' U+003C
+  0x08, 0x1C, 0x36, 0x63, 0x41,
+  // '=' U+003D
+  0x24, 0x24, 0x24, 0x24, 0x24, 0x24,
+  // '>' U+003E
+  0x41, 0x63, 0x36, 0x1C, 0x08,
+  // '?' U+003F
+  0x02, 0x03, 0x51, 0x59, 0x0F, 0x06,
+  // '@' U+0040
+  0x3E, 0x7F, 0x41, 0x5D, 0x5D, 0x1F, 0x1E,
+  // 'A' U+0041
+  0x7C, 0x7E, 0x13, 0x13, 0x7E, 0x7C,
+  // 'B' U+0042
+  0x41, 0x7F, 0x7F, 0x49, 0x49, 0x7F, 0x36,
+  // 'C' U+0043
+  0x1C, 0x3E, 0x63, 0x41, 0x41, 0x63, 0x22,
+  // 'D' U+0044
+  0x41, 0x7F, 0x7F, 0x41, 0x63, 0x3E, 0x1C,
+  // 'E' U+0045
+  0x41, 0x7F, 0x7F, 0x49, 0x5D, 0x41, 0x63,
+  // 'F' U+0046
+  0x41, 0x7F, 0x7F, 0x49, 0x1D, 0x01, 0x03,
+  // 'G' U+0047
+  0x1C, 0x3E, 0x63, 0x41, 0x51, 0x73, 0x72,
+  // 'H' U+0048
+  0x7F, 0x7F, 0x08, 0x08, 0x7F, 0x7F,
+  // 'I' U+0049
+  0x41, 0x7F, 0x7F, 0x41,
+  // 'J' U+004A
+  0x30, 0x70, 0x40, 0x41, 0x7F, 0x3F, 0x01,
+  // 'K' U+004B
+  0x41, 0x7F, 0x7F, 0x08, 0x1C, 0x77, 0x63,
+  // 'L' U+004C
+  0x41, 0x7F, 0x7F, 0x41, 0x40, 0x60, 0x70,
+  // 'M' U+004D
+  0x7F, 0x7F, 0x0E, 0x1C, 0x0E, 0x7F, 0x7F,
+  // 'N' U+004E
+  0x7F, 0x7F, 0x06, 0x0C, 0x18, 0x7F, 0x7F,
+  // 'O' U+004F
+  0x1C, 0x3E, 0x63, 0x41, 0x63, 0x3E, 0x1C,
+  // 'P' U+0050
+  0x41, 0x7F, 0x7F, 0x49, 0x09, 0x0F, 0x06,
+  // 'Q' U+0051
+  0x1E, 0x3F, 0x21, 0x71, 0x7F, 0x5E,
+  // 'R' U+0052
+  0x41, 0x7F, 0x7F, 0x09, 0x19, 0x7F, 0x66,
+  // 'S' U+0053
+  0x26, 0x6F, 0x4D, 0x59, 0x73, 0x32,
+  // 'T' U+0054
+  0x03, 0x41, 0x7F, 0x7F, 0x41, 0x03,
+  // 'U' U+0055
+  0x7F, 0x7F, 0x40, 0x40, 0x7F, 0x7F,
+  // 'V' U+0056
+  0x1F, 0x3F, 0x60, 0x60, 0x3F, 0x1F,
+  // 'W' U+0057
+  0x7F, 0x7F, 0x30, 0x18, 0x30, 0x7F, 0x7F,
+  // 'X' U+0058
+  0x43, 0x67, 0x3C, 0x18, 0x3C, 0x67, 0x43,
+  // 'Y' U+0059
+  0x07, 0x4F, 0x78, 0x78, 0x4F, 0x07,
+  // 'Z' U+005A
+  0x47, 0x63, 0x71, 0x59, 0x4D, 0x67, 0x73,
+  // '[' U+005B
+  0x7F, 0x7F, 0x41, 0x41,
+  // U+005C
+  0x01, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60,
+  // ']' U+005D
+  0x41, 0x41, 0x7F, 0x7F,
+  // '^' U+005E
+  0x08, 0x0C, 0x06, 0x03, 0x06, 0x0C, 0x08,
+  // '_' U+005F
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+  // '`' U+0060
+  0x03, 0x07, 0x04,
+  // 'a' U+0061
+  0x20, 0x74, 0x54, 0x54, 0x3C, 0x78, 0x40,
+  // 'b' U+0062
+  0x41, 0x7F, 0x3F, 0x48, 0x48, 0x78, 0x30,
+  // 'c' U+0063
+  0x38, 0x7C, 0x44, 0x44, 0x6C, 0x28,
+  // 'd' U+0064
+  0x30, 0x78, 0x48, 0x49, 0x3F, 0x7F, 0x40,
+  // 'e' U+0065
+  0x38, 0x7C, 0x54, 0x54, 0x5C, 0x18,
+  // 'f' U+0066
+  0x48, 0x7E, 0x7F, 0x49, 0x03, 0x02,
+  // 'g' U+0067
+  0x98, 0xBC, 0xA4, 0xA4, 0xF8, 0x7C, 0x04,
+  // 'h' U+0068
+  0x41, 0x7F, 0x7F, 0x08, 0x04, 0x7C, 0x78,
+  // 'i' U+0069
+  0x44, 0x7D, 0x7D, 0x40,
+  // 'j' U+006A
+  0x60, 0xE0, 0x80, 0x80, 0xFD, 0x7D,
+  // 'k' U+006B
+  0x41, 0x7F, 0x7F, 0x10, 0x38, 0x6C, 0x44,
+  // 'l' U+006C
+  0x41, 0x7F, 0x7F, 0x40,
+  // 'm' U+006D
+  0x7C, 0x7C, 0x18, 0x38, 0x1C, 0x7C, 0x78,
+  // 'n' U+006E
+  0x7C, 0x7C, 0x04, 0x04, 0x7C, 0x78,
+  // 'o' U+006F
+  0x38, 0x7C, 0x44, 0x44, 0x7C, 0x38,
+  // 'p' U+0070
+  0x84, 0xFC, 0xF8, 0xA4, 0x24, 0x3C, 0x18,
+  // 'q' U+0071
+  0x18, 0x3C, 0x24, 0xA4, 0xF8, 0xFC, 0x84,
+  // 'r' U+0072
+  0x44, 0x7C, 0x78, 0x4C, 0x04, 0x1C, 0x18,
+  // 's' U+0073
+  0x48, 0x5C, 0x54, 0x54, 0x74, 0x24,
+  // 't' U+0074
+  0x04, 0x3E, 0x7F, 0x44, 0x24,
+  // 'u' U+0075
+  0x3C, 0x7C, 0x40, 0x40, 0x3C, 0x7C, 0x40,
+  // 'v' U+0076
+  0x1C, 0x3C, 0x60, 0x60, 0x3C, 0x1C,
+  // 'w' U+0077
+  0x3C, 0x7C, 0x70, 0x38, 0x70, 0x7C, 0x3C,
+  // 'x' U+0078
+  0x44, 0x6C, 0x38, 0x10, 0x38, 0x6C, 0x44,
+  // 'y' U+0079
+  0x9C, 0xBC, 0xA0, 0xA0, 0xFC, 0x7C,
+  // 'z' U+007A
+  0x4C, 0x64, 0x74, 0x5C, 0x4C, 0x64,
+  // '{' U+007B
+  0x08, 0x08, 0x3E, 0x77, 0x41, 0x41,
+  // '|' U+007C
+  0x77, 0x77,
+  // '}' U+007D
+  0x41, 0x41, 0x77, 0x3E, 0x08, 0x08,
+  // '~' U+007E
+  0x02, 0x03, 0x01, 0x03, 0x02, 0x03, 0x01,
+};
+
+static const tinyfont_glyph_t prop8_glyphs[] = {
+  {     0,   0,   3,   0 },   // ' ' U+0020
+  {     0,   4,   5,   0 },   // '!' U+0021
+  {     4,   5,   6,   0 },   // '"' U+0022
+  {     9,   7,   8,   0 },   // '#' U+0023
+  {    16,   6,   7,   0 },   // '$' U+0024
+  {    22,   7,   8,   0 },   // '%' U+0025
+  {    29,   7,   8,   0 },   // '&' U+0026
+  {    36,   3,   4,   0 },   // U+0027
+  {    39,   4,   5,   0 },   // '(' U+0028
+  {    43,   4,   5,   0 },   // ')' U+0029
+  {    47,   8,   9,   0 },   // '*' U+002A
+  {    55,   6,   7,   0 },   // '+' U+002B
+  {    61,   3,   4,   0 },   // ',' U+002C
+  {    64,   6,   7,   0 },   // '-' U+002D
+  {    70,   2,   3,   0 },   // '.' U+002E
+  {    72,   7,   8,   0 },   // '/' U+002F
+  {    79,   7,   8,   0 },   // '0' U+0030
+  {    86,   6,   7,   0 },   // '1' U+0031
+  {    92,   6,   7,   0 },   // '2' U+0032
+  {    98,   6,   7,   0 },   // '3' U+0033
+  {   104,   7,   8,   0 },   // '4' U+0034
+  {   111,   6,   7,   0 },   // '5' U+0035
+  {   117,   6,   7,   0 },   // '6' U+0036
+  {   123,   6,   7,   0 },   // '7' U+0037
+  {   129,   6,   7,   0 },   // '8' U+0038
+  {   135,   6,   7,   0 },   // '9' U+0039
+  {   141,   2,   3,   0 },   // ':' U+003A
+  {   143,   3,   4,   0 },   // ';' U+003B
+  {   146,   5,   6,   0 },   // '<' U+003C
+  {   151,   6,   7,   0 },   // '=' U+003D
+  {   157,   5,   6,   0 },   // '>' U+003E
+  {   162,   6,   7,   0 },   // '?' U+003F
+  {   168,   7,   8,   0 },   // '@' U+0040
+  {   175,   6,   7,   0 },   // 'A' U+0041
+  {   181,   7,   8,   0 },   // 'B' U+0042
+  {   188,   7,   8,   0 },   // 'C' U+0043
+  {   195,   7,   8,   0 },   // 'D' U+0044
+  {   202,   7,   8,   0 },   // 'E' U+0045
+  {   209,   7,   8,   0 },   // 'F' U+0046
+  {   216,   7,   8,   0 },   // 'G' U+0047
+  {   223,   6,   7,   0 },   // 'H' U+0048
+  {   229,   4,   5,   0 },   // 'I' U+0049
+  {   233,   7,   8,   0 },   // 'J' U+004A
+  {   240,   7,   8,   0 },   // 'K' U+004B
+  {   247,   7,   8,   0 },   // 'L' U+004C
+  {   254,   7,   8,   0 },   // 'M' U+004D
+  {   261,   7,   8,   0 },   // 'N' U+004E
+  {   268,   7,   8,   0 },   // 'O' U+004F
+  {   275,   7,   8,   0 },   // 'P' U+0050
+  {   282,   6,   7,   0 },   // 'Q' U+0051
+  {   288,   7,   8,   0 },   // 'R' U+0052
+  {   295,   6,   7,   0 },   // 'S' U+0053
+  {   301,   6,   7,   0 },   // 'T' U+0054
+  {   307,   6,   7,   0 },   // 'U' U+0055
+  {   313,   6,   7,   0 },   // 'V' U+0056
+  {   319,   7,   8,   0 },   // 'W' U+0057
+  {   326,   7,   8,   0 },   // 'X' U+0058
+  {   333,   6,   7,   0 },   // 'Y' U+0059
+  {   339,   7,   8,   0 },   // 'Z' U+005A
+  {   346,   4,   5,   0 },   // '[' U+005B
+  {   350,   7,   8,   0 },   // U+005C
+  {   357,   4,   5,   0 },   // ']' U+005D
+  {   361,   7,   8,   0 },   // '^' U+005E
+  {   368,   8,   9,   0 },   // '_' U+005F
+  {   376,   3,   4,   0 },   // '`' U+0060
+  {   379,   7,   8,   0 },   // 'a' U+0061
+  {   386,   7,   8,   0 },   // 'b' U+0062
+  {   393,   6,   7,   0 },   // 'c' U+0063
+  {   399,   7,   8,   0 },   // 'd' U+0064
+  {   406,   6,   7,   0 },   // 'e' U+0065
+  {   412,   6,   7,   0 },   // 'f' U+0066
+  {   418,   7,   8,   0 },   // 'g' U+0067
+  {   425,   7,   8,   0 },   // 'h' U+0068
+  {   432,   4,   5,   0 },   // 'i' U+0069
+  {   436,   6,   7,   0 },   // 'j' U+006A
+  {   442,   7,   8,   0 },   // 'k' U+006B
+  {   449,   4,   5,   0 },   // 'l' U+006C
+  {   453,   7,   8,   0 },   // 'm' U+006D
+  {   460,   6,   7,   0 },   // 'n' U+006E
+  {   466,   6,   7,   0 },   // 'o' U+006F
+  {   472,   7,   8,   0 },   // 'p' U+0070
+  {   479,   7,   8,   0 },   // 'q' U+0071
+  {   486,   7,   8,   0 },   // 'r' U+0072
+  {   493,   6,   7,   0 },   // 's' U+0073
+  {   499,   5,   6,   0 },   // 't' U+0074
+  {   504,   7,   8,   0 },   // 'u' U+0075
+  {   511,   6,   7,   0 },   // 'v' U+0076
+  {   517,   7,   8,   0 },   // 'w' U+0077
+  {   524,   7,   8,   0 },   // 'x' U+0078
+  {   531,   6,   7,   0 },   // 'y' U+0079
+  {   537,   6,   7,   0 },   // 'z' U+007A
+  {   543,   6,   7,   0 },   // '{' U+007B
+  {   549,   2,   3,   0 },   // '|' U+007C
+  {   551,   6,   7,   0 },   // '}' U+007D
+  {   557,   7,   8,   0 },   // '~' U+007E
+};
+
+static const tinyfont_range_t prop8_ranges[] = {
+  { 0x0020,  95,   0 },
+};
+
+const tinyfont_t tinyfont_prop8 = {
+  "prop8", 8, 7, 31, 95, 1, 0,
+  prop8_ranges, prop8_glyphs, NULL, prop8_bitmaps
+};
@@ -0,0 +1,158 @@
+// ===================================================================
+//
+//    Frame stream playback for the Tiny graphics libraries
+//
+// ===================================================================
+//
+// Decodes KEY and DELTA frames (see frame_stream.h) straight into the
+// frame buffer. Only bytes that really change are written, and their
+// column range on each page is marked dirty for the flush.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "frame_stream.h"
+
+esp_err_t
+fstream_open(fstream_t *fs, const uint8_t *data, size_t length)
+{
+  memset(fs, 0, sizeof(fstream_t));
+  if ((length < FSTREAM_HEADER_SIZE) || (data[0] != 'F') || (data[1] != 'S') ||
+      (data[2] != FSTREAM_VERSION) || (data[3] == 0) || (data[4] == 0)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  fs->data = data;
+  fs->length = length;
+  fs->pos = FSTREAM_HEADER_SIZE;
+  fs->width = data[3];
+  fs->pages = data[4];
+  fs->frames = data[5] | (data[6] << 8);
+  fs->frame = 0;
+  return ESP_OK;
+}
+
+void
+fstream_rewind(fstream_t *fs)
+{
+  fs->pos = FSTREAM_HEADER_SIZE;
+  fs->frame = 0;
+}
+
+// Decode the next frame with its top left corner at column x of page.
+// Returns ESP_ERR_NOT_FOUND after the last frame.
+esp_err_t
+fstream_next(fstream_t *fs, tinygrafx_t tg, int16_t x, int16_t page)
+{
+  const uint8_t *src, *end;
+  uint8_t type, delta;
+  uint16_t length;
+  int16_t p = 0, c = 0;
+  int16_t lo[fs->pages], hi[fs->pages];
+  esp_err_t err = ESP_OK;
+
+  if (fs->frame >= fs->frames) return ESP_ERR_NOT_FOUND;
+  if ((x < 0) || (page < 0) || (x + fs->width > tg.display_width) ||
+      (page + fs->pages > tg.display_pages)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (fs->length - fs->pos < FSTREAM_FRAME_HEADER) return ESP_ERR_INVALID_SIZE;
+
+  type = fs->data[fs->pos];
+  length = fs->data[fs->pos + 1] | (fs->data[fs->pos + 2] << 8);
+  if ((type > FSTREAM_DELTA) || (fs->length - fs->pos - FSTREAM_FRAME_HEADER < length)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  src = fs->data + fs->pos + FSTREAM_FRAME_HEADER;
+  end = src + length;
+  delta = (type == FSTREAM_DELTA);
+
+  for (int16_t i = 0; i < fs->pages; i++) {
+    lo[i] = fs->width;
+    hi[i] = -1;
+  }
+
+  while ((src < end) && (err == ESP_OK)) {
+    uint8_t ctrl = *src++;
+    const uint8_t *literal = NULL;
+    uint8_t value = 0;
+    int16_t count;
+
+    if (ctrl < 0x80) {
+      count = ctrl + 1;
+      if (end - src < count) {
+        err = ESP_ERR_INVALID_SIZE;
+        break;
+      }
+      literal = src;
+      src += count;
+    }
+    else {
+      count = (ctrl & 0x7F) + 2;
+      if (src >= end) {
+        err = ESP_ERR_INVALID_SIZE;
+        break;
+      }
+      value = *src++;
+    }
+
+    if (delta && (literal == NULL) && (value == 0)) {
+      // unchanged run
+      c += count;
+      while (c >= fs->width) {
+        c -= fs->width;
+        p++;
+      }
+      if ((p > fs->pages) || ((p == fs->pages) && (c > 0))) err = ESP_ERR_INVALID_SIZE;
+      continue;
+    }
+
+    for (int16_t i = 0; i < count; i++) {
+      uint8_t *dst;
+      uint8_t v;
+
+      if (p >= fs->pages) {
+        err = ESP_ERR_INVALID_SIZE;
+        break;
+      }
+      dst = tg.display_buffer + (page + p) * tg.display_width + x + c;
+      v = (literal != NULL) ? literal[i] : value;
+      if (delta) v ^= *dst;
+      if (v != *dst) {
+        *dst = v;
+        if (c < lo[p]) lo[p] = c;
+        if (c > hi[p]) hi[p] = c;
+      }
+      if (++c == fs->width) {
+        c = 0;
+        p++;
+      }
+    }
+  }
+
+  // the rest of a key frame is blank
+  if (!delta && (err == ESP_OK)) {
+    for (; p < fs->pages; p++, c = 0) {
+      uint8_t *row = tg.display_buffer + (page + p) * tg.display_width + x;
+      for (; c < fs->width; c++) {
+        if (row[c] != 0) {
+          row[c] = 0;
+          if (c < lo[p]) lo[p] = c;
+          if (c > hi[p]) hi[p] = c;
+        }
+      }
+    }
+  }
+
+  for (int16_t i = 0; i < fs->pages; i++) {
+    if (lo[i] <= hi[i]) {
+      dirty_mark(tg, x + lo[i], (page + i) * 8, x + hi[i], (page + i) * 8);
+    }
+  }
+  if (err != ESP_OK) return err;
+
+  fs->pos += FSTREAM_FRAME_HEADER + length;
+  fs->frame++;
+  return ESP_OK;
+}
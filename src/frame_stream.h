@@ -0,0 +1,44 @@
+#ifndef FRAMESTREAMH_
+#define FRAMESTREAMH_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "tiny_grafx.h"
+
+// Frame stream
+//
+//   header:  'F' 'S' version width pages frames(LE16)
+//   frame:   type length(LE16) payload
+//
+// A frame covers width columns of pages pages, in frame buffer order.
+// The payload is a byte-run code over those bytes:
+//   0x00-0x7F  c + 1 literal bytes follow
+//   0x80-0xFF  the next byte repeated (c & 0x7F) + 2 times
+// A KEY frame writes the bytes, a DELTA frame XORs them into the
+// previous frame. When the payload ends early the rest of a KEY frame is
+// cleared and the rest of a DELTA frame is unchanged.
+//
+#define FSTREAM_VERSION         1
+#define FSTREAM_HEADER_SIZE     7
+#define FSTREAM_FRAME_HEADER    3
+
+#define FSTREAM_KEY             0
+#define FSTREAM_DELTA           1
+
+typedef struct fstream_t {
+  const uint8_t *data;
+  size_t length;
+  size_t pos;                 // next frame
+  uint8_t width;
+  uint8_t pages;
+  uint16_t frames;
+  uint16_t frame;             // index of the next frame
+} fstream_t;
+
+esp_err_t fstream_open(fstream_t *fs, const uint8_t *data, size_t length);
+void fstream_rewind(fstream_t *fs);
+esp_err_t fstream_next(fstream_t *fs, tinygrafx_t tg, int16_t x, int16_t page);
+
+#endif /* FRAMESTREAMH_ */
@@ -5,53 +5,65 @@
 #include <mruby/variable.h>
 #include <mruby/class.h>
 #include <mruby/data.h>
+#include <mruby/hash.h>
 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "driver/i2c.h"
 #include "esp_err.h"
 #include "esp_log.h"
 
 #include "tiny_grafx.h"
+#include "ssd1306.h"
+#include "transport.h"
+#include "display_list.h"
+#include "bitmap_import.h"
+#include "frame_stream.h"
+#include "esp_timer.h"
 
-// SSD1306 control byte
-#define SSD1306I2C_CONTROLBYTE_CMDSINGLE       0x80
-#define SSD1306I2C_CONTROLBYTE_CMDSTREAM       0x00
-#define SSD1306I2C_CONTROLBYTE_DATASTREAM      0x40
-
-/* ------------------------------------------------
-  As a reference, leave the configuration command information.
-// Fundamental Commands 
-#define SSD1306I2C_SET_CONTRAST                0x81    // 0x7F = default
-#define SSD1306I2C_RESUME_RAM_CONTENT_DISPLAY  0xA4
-#define SSD1306I2C_DISPLAY_OFF                 0xAE
-#define SSD1306I2C_DISPLAY_ON                  0xAF
-// Scrolling Commands
-#define SSD1306I2C_STOP_SCROLLING              0x2E
-// Addressing Setting Commands
-#define SSD1306I2C_SET_MEMORY_ADDR_MODE        0x20    // 0x00 = Horizontal Mode
-#define SSD1306I2C_SET_COLUMN_ADDR             0x21    // 0x00 = start, 0x7f = end
-#define SSD1306I2C_SET_PAGE_ADDR               0x22    // 0x00 = start, 0x07 = end
-// Hardware Configuration
-#define SSD1306I2C_SET_DISPLAY_START_LINE      0x40    // start line is 0d
-#define SSD1306I2C_REMAP                       0xA1    // SEG0 is mapped to column address 127
-#define SSD1306I2C_MUX_RATIO                   0xA8    // 0x3F = 64d -1d
-#define SSD1306I2C_SCAN_DIRECTION              0xC8    // SCAN_DIRECTION, reverse up-bottom
-#define SSD1306I2C_SET_DISPLAY_OFFSET          0xD3    // 0x00 = no offset
-#define SSD1306I2C_SET_COM_PINS                0xDA    // 0x12 = Alternative configuration, Disable L/R remap
-#define SSD1306I2C_SET_OSC_FREQUENCY           0xd5    // 0x00
-// Charge Pump Command
-#define SSD1306I2C_SET_CHARGE_PUMP             0x8D    // 0x14 = enable charge pump
---------------------------------------------------- */
-
-// SSD1306 display config
-#define SSD1306_DISPLAY_WIDTH   128
-#define SSD1306_DISPLAY_HEIGHT  64
-#define SSD1306_DISPLAY_PIXEL   1024
-#define SSD1306_FONT_WIDTH      8
-#define SSD1306_FONT_HEIGHT     8
+// display_async policy while the previous frame is still in flight
+#define ASYNC_BLOCK             0       // wait for it
+#define ASYNC_DROP              1       // drop the new frame
+
+// background flush task
+#define SSD1306_TASK_STACK      2048
+
+// panels of one I2C port in a panel group
+#define PANEL_GROUP_MAX         8
+
+// points of fill_polygon
+#define POLYGON_MAX_POINTS      32
+
+// draw_batch commands
+#define BATCH_CLEAR             0
+#define BATCH_PIXEL             1
+#define BATCH_LINE              2
+#define BATCH_HLINE             3
+#define BATCH_VLINE             4
+#define BATCH_RECT              5
+#define BATCH_FILL_RECT         6
+#define BATCH_CIRCLE            7
+#define BATCH_FILL_CIRCLE       8
+#define BATCH_TEXT              9
+#define BATCH_COLOR             10
+#define BATCH_FONTSIZE          11
+#define BATCH_COMMANDS          12
+#define BATCH_MAX_ARGS          5
+
+static const char *batch_names[BATCH_COMMANDS] = {
+  "clear", "pixel", "line", "hline", "vline", "rect",
+  "fill_rect", "circle", "fill_circle", "text", "color", "fontsize"
+};
+
+// number of int16 arguments, text also takes a string
+static const uint8_t batch_argc[BATCH_COMMANDS] = {
+  0, 2, 5, 3, 3, 4, 4, 3, 3, 2, 1, 1
+};
 
 static const char *TAG = "SSD1306";
 
@@ -74,7 +86,7 @@ lcd_set_pixel(mrb_state *mrb, mrb_value self)
 	mrb_int x, y;
   int16_t color;
   tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
-  color = mrb_fixnum(mrb_iv_get(mrb, self, mrb_intern_lit(mrb, "@color")));
+  color = tg->color;
   mrb_get_args(mrb, "ii", &x, &y);
 	
   set_pixel(*tg, x, y, color);
@@ -93,19 +105,64 @@ lcd_get_pixel(mrb_state *mrb, mrb_value self)
   return mrb_fixnum_value(pixel);
 }
 
+// buffer([str]) returns the frame in frame buffer order (pages of
+// columns, bit 0 at the top) in a new String, or in str to reuse it
+static mrb_value
+lcd_buffer(mrb_state *mrb, mrb_value self)
+{
+  mrb_value str = mrb_nil_value();
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "|S", &str);
+
+  if (mrb_nil_p(str)) {
+    return mrb_str_new(mrb, (const char *)tg->display_buffer, tg->display_pixel);
+  }
+  mrb_str_resize(mrb, str, tg->display_pixel);
+  buffer_read(*tg, (uint8_t *)RSTRING_PTR(str), tg->display_pixel);
+  return str;
+}
+
+// load_buffer(str) replaces the whole frame with str, in the order of buffer
+static mrb_value
+lcd_load_buffer(mrb_state *mrb, mrb_value self)
+{
+  mrb_value str;
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "S", &str);
+
+  if (RSTRING_LEN(str) != tg->display_pixel) {
+    mrb_raisef(mrb, E_ARGUMENT_ERROR, "load_buffer: the frame is %S bytes", mrb_fixnum_value(tg->display_pixel));
+  }
+  buffer_write(*tg, (const uint8_t *)RSTRING_PTR(str), tg->display_pixel);
+  return self;
+}
+
+// The frame as a P4 PBM image
+static mrb_value
+lcd_to_pbm(mrb_state *mrb, mrb_value self)
+{
+  mrb_value pbm;
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  size_t size = pbm_encode(tg->display_buffer, tg->display_width, tg->display_height, NULL);
+
+  pbm = mrb_str_new(mrb, NULL, size);
+  pbm_encode(tg->display_buffer, tg->display_width, tg->display_height, (uint8_t *)RSTRING_PTR(pbm));
+  return pbm;
+}
+
 static mrb_value
 lcd_draw_line(mrb_state *mrb, mrb_value self)
 {
-  mrb_int x0, y0, x1, y1;
+  mrb_int x0, y0, x1, y1, width = 1;
   int16_t color;
   tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
-  color = mrb_fixnum(mrb_iv_get(mrb, self, mrb_intern_lit(mrb, "@color")));
-  mrb_get_args(mrb, "iiii", &x0, &y0, &x1, &y1);
+  color = tg->color;
+  mrb_get_args(mrb, "iiii|i", &x0, &y0, &x1, &y1, &width);
   if ((color < BLACK) || (color > INVERT)) {
     color = WHITE;
   }
 
-  draw_line(*tg, x0, y0, x1, y1, color);
+  draw_thick_line(*tg, x0, y0, x1, y1, width, color);
   return mrb_nil_value();
 }
 
@@ -115,7 +172,7 @@ lcd_draw_vertical_line(mrb_state *mrb, mrb_value self)
 	mrb_int x, y, h;
   int16_t color;
   tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
-  color = mrb_fixnum(mrb_iv_get(mrb, self, mrb_intern_lit(mrb, "@color")));
+  color = tg->color;
   mrb_get_args(mrb, "iii", &x, &y, &h);
 	
   draw_vertical_line(*tg, x, y, h, color);
@@ -128,7 +185,7 @@ lcd_draw_horizontal_line(mrb_state *mrb, mrb_value self)
 	mrb_int x, y, w;
   int16_t color;
   tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
-  color = mrb_fixnum(mrb_iv_get(mrb, self, mrb_intern_lit(mrb, "@color")));
+  color = tg->color;
   mrb_get_args(mrb, "iii", &x, &y, &w);
 	
   draw_horizontal_line(*tg, x, y, w, color);
@@ -141,7 +198,7 @@ lcd_draw_rect(mrb_state *mrb, mrb_value self)
 	mrb_int x, y, w, h;
   int16_t color;
   tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
-  color = mrb_fixnum(mrb_iv_get(mrb, self, mrb_intern_lit(mrb, "@color")));
+  color = tg->color;
   mrb_get_args(mrb, "iiii", &x, &y, &w, &h);
 	
   draw_rect(*tg, x, y, w, h, color);
@@ -154,7 +211,7 @@ lcd_draw_fill_rect(mrb_state *mrb, mrb_value self)
 	mrb_int x, y, w, h;
   int16_t color;
   tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
-  color = mrb_fixnum(mrb_iv_get(mrb, self, mrb_intern_lit(mrb, "@color")));
+  color = tg->color;
   mrb_get_args(mrb, "iiii", &x, &y, &w, &h);
 	
   draw_fill_rect(*tg, x, y, w, h, color);
@@ -167,7 +224,7 @@ lcd_draw_circle(mrb_state *mrb, mrb_value self)
 	mrb_int x, y, r;
   int16_t color;
   tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
-  color = mrb_fixnum(mrb_iv_get(mrb, self, mrb_intern_lit(mrb, "@color")));
+  color = tg->color;
   mrb_get_args(mrb, "iii", &x, &y, &r);
 	
   draw_circle(*tg, x, y, r, color);
@@ -180,153 +237,1695 @@ lcd_draw_fill_circle(mrb_state *mrb, mrb_value self)
   mrb_int x, y, r;
   int16_t color;
   tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
-  color = mrb_fixnum(mrb_iv_get(mrb, self, mrb_intern_lit(mrb, "@color")));
+  color = tg->color;
   mrb_get_args(mrb, "iii", &x, &y, &r);
 	
   draw_fill_circle(*tg, x, y, r, color);
 	return mrb_nil_value();
 }
 
+static mrb_value
+lcd_draw_ellipse(mrb_state *mrb, mrb_value self)
+{
+  mrb_int x, y, rx, ry;
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "iiii", &x, &y, &rx, &ry);
+
+  draw_ellipse(*tg, x, y, rx, ry, tg->color);
+  return mrb_nil_value();
+}
+
+static mrb_value
+lcd_draw_fill_ellipse(mrb_state *mrb, mrb_value self)
+{
+  mrb_int x, y, rx, ry;
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "iiii", &x, &y, &rx, &ry);
+
+  draw_fill_ellipse(*tg, x, y, rx, ry, tg->color);
+  return mrb_nil_value();
+}
+
+// arc(x, y, r, start, end[, thickness]), angles in degrees clockwise from 3 o'clock
+static mrb_value
+lcd_draw_arc(mrb_state *mrb, mrb_value self)
+{
+  mrb_int x, y, r, start, end;
+  mrb_int thickness = 1;
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "iiiii|i", &x, &y, &r, &start, &end, &thickness);
+
+  draw_arc(*tg, x, y, r, start, end, thickness, tg->color);
+  return mrb_nil_value();
+}
+
+static mrb_value
+lcd_draw_pie(mrb_state *mrb, mrb_value self)
+{
+  mrb_int x, y, r, start, end;
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "iiiii", &x, &y, &r, &start, &end);
+
+  draw_pie(*tg, x, y, r, start, end, tg->color);
+  return mrb_nil_value();
+}
+
+static mrb_value
+lcd_draw_round_rect(mrb_state *mrb, mrb_value self)
+{
+  mrb_int x, y, w, h, r;
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "iiiii", &x, &y, &w, &h, &r);
+
+  draw_round_rect(*tg, x, y, w, h, r, tg->color);
+  return mrb_nil_value();
+}
+
+static mrb_value
+lcd_draw_fill_round_rect(mrb_state *mrb, mrb_value self)
+{
+  mrb_int x, y, w, h, r;
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "iiiii", &x, &y, &w, &h, &r);
+
+  draw_fill_round_rect(*tg, x, y, w, h, r, tg->color);
+  return mrb_nil_value();
+}
+
+static mrb_value
+lcd_draw_fill_triangle(mrb_state *mrb, mrb_value self)
+{
+  mrb_int x0, y0, x1, y1, x2, y2;
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "iiiiii", &x0, &y0, &x1, &y1, &x2, &y2);
+
+  draw_fill_triangle(*tg, x0, y0, x1, y1, x2, y2, tg->color);
+  return mrb_nil_value();
+}
+
+// _fill_polygon([x0, y0, x1, y1, ...])
+static mrb_value
+lcd_draw_fill_polygon(mrb_state *mrb, mrb_value self)
+{
+  mrb_value coords;
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "A", &coords);
+
+  mrb_int length = RARRAY_LEN(coords);
+  if ((length < 2) || (length % 2 != 0) || (length > 2 * POLYGON_MAX_POINTS)) {
+    mrb_raisef(mrb, E_ARGUMENT_ERROR, "fill_polygon: 1 to %S points", mrb_fixnum_value(POLYGON_MAX_POINTS));
+  }
+  int16_t points[length];
+  for (mrb_int i = 0; i < length; i++) {
+    mrb_value v = mrb_ary_ref(mrb, coords, i);
+    if (!mrb_fixnum_p(v)) {
+      mrb_raise(mrb, E_TYPE_ERROR, "fill_polygon: coordinates must be integers");
+    }
+    points[i] = mrb_fixnum(v);
+  }
+
+  draw_fill_polygon(*tg, points, length / 2, tg->color);
+  return mrb_nil_value();
+}
+
+// OLED::Font objects point at the const fonts compiled in, nothing to free
+static void
+font_free(mrb_state *mrb, void *ptr)
+{
+}
+
+static const struct mrb_data_type font_type = {
+  "font_type", font_free
+};
+
+// font of an OLED::Font object, NULL for nil
+static const tinyfont_t *
+font_get(mrb_state *mrb, mrb_value font)
+{
+  if (mrb_nil_p(font)) return NULL;
+  return (const tinyfont_t *)mrb_data_get_ptr(mrb, font, &font_type);
+}
+
 // mruby binding of Display a character string
+// text(x, y, str[, font]) draws in the given font, else in oled.font
 static mrb_value
 lcd_text(mrb_state *mrb, mrb_value self)
 {
   mrb_int x, y;
-  mrb_value data;
+  mrb_value data, font_obj = mrb_nil_value();
   int16_t color, fontsize;
+  const tinyfont_t *font;
   tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
-  color = mrb_fixnum(mrb_iv_get(mrb, self, mrb_intern_lit(mrb, "@color")));
-  fontsize = mrb_fixnum(mrb_iv_get(mrb, self, mrb_intern_lit(mrb, "@fontsize")));
-  mrb_get_args(mrb, "iiS", &x, &y, &data);
+  color = tg->color;
+  fontsize = tg->fontsize;
+  mrb_get_args(mrb, "iiS|o", &x, &y, &data, &font_obj);
+  font = mrb_nil_p(font_obj) ? tg->font : font_get(mrb, font_obj);
   
-  display_text(*tg, x, y, RSTRING_PTR(data), RSTRING_LEN(data), color, fontsize);
+  display_text(*tg, x, y, RSTRING_PTR(data), RSTRING_LEN(data), color, fontsize, font);
   // ESP_LOGI(TAG, "color:%d, size:%d, text:%s", color, fontsize, RSTRING_PTR(data));
   return mrb_nil_value();
 }
-// ----- Common graphics methods -----
 
+// Bytes of a w x h bitmap in the given layout, 0 for an empty bitmap or
+// an unknown layout
+static mrb_int
+bitmap_size(mrb_int w, mrb_int h, mrb_int format)
+{
+  switch (format) {
+    case BITMAP_PAGES: return w * ((h + 7) / 8);
+    case BITMAP_ROWS:  return ((w + 7) / 8) * h;
+  }
+  return 0;
+}
+
+// mruby binding of blit: _bitmap(x, y, w, h, data[, layout[, mask]])
+// The mask is a String of the same layout and size, or nil.
+static mrb_value
+lcd_bitmap(mrb_state *mrb, mrb_value self)
+{
+  mrb_int x, y, w, h, size;
+  mrb_int format = BITMAP_ROWS;
+  mrb_value data;
+  mrb_value mask = mrb_nil_value();
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "iiiiS|io", &x, &y, &w, &h, &data, &format, &mask);
 
+  if ((format != BITMAP_PAGES) && (format != BITMAP_ROWS)) {
+    mrb_raisef(mrb, E_ARGUMENT_ERROR, "bitmap: unknown layout %S", mrb_fixnum_value(format));
+  }
+  if ((w <= 0) || (h <= 0)) {
+    return self;
+  }
+  size = bitmap_size(w, h, format);
+  if (RSTRING_LEN(data) < size) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "bitmap: data is too short");
+  }
+  if (!mrb_nil_p(mask) && (!mrb_string_p(mask) || (RSTRING_LEN(mask) < size))) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "bitmap: mask must be a String of the bitmap size");
+  }
 
-// ----- SSD1306 methods and functions -----
+  blit(*tg, x, y, w, h, (const uint8_t *)RSTRING_PTR(data),
+       mrb_nil_p(mask) ? NULL : (const uint8_t *)RSTRING_PTR(mask), format, tg->color);
+  return self;
+}
+
+// Check the data of a w x h grayscale image, one byte per pixel
+static void
+gray_check(mrb_state *mrb, mrb_int w, mrb_int h, mrb_value data)
+{
+  if ((w > CANVAS_MAX_SIZE) || (h > CANVAS_MAX_SIZE)) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "gray_image: unsupported size");
+  }
+  if ((w > 0) && (h > 0) && (RSTRING_LEN(data) < w * h)) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "gray_image: data is too short");
+  }
+}
 
+// mruby binding of gray_image: _gray_image(x, y, w, h, data, mode)
 static mrb_value
-ssd1306_display(mrb_state *mrb, mrb_value self)
+lcd_gray_image(mrb_state *mrb, mrb_value self)
 {
-  mrb_value port;
-  uint8_t addr, *buffer;
-  i2c_cmd_handle_t cmd;
-  esp_err_t err;
+  mrb_int x, y, w, h, mode;
+  mrb_value data;
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "iiiiSi", &x, &y, &w, &h, &data, &mode);
+
+  if ((mode < 0) || (mode >= DITHER_TYPES)) {
+    mrb_raisef(mrb, E_ARGUMENT_ERROR, "gray_image: unknown mode %S", mrb_fixnum_value(mode));
+  }
+  gray_check(mrb, w, h, data);
+  gray_image(*tg, x, y, w, h, (const uint8_t *)RSTRING_PTR(data), mode, 0);
+  return self;
+}
+
+// scroll(dx, dy[, x, y, w, h]) moves the pixels of the rectangle (the
+// whole screen by default) inside the frame buffer. The strip that comes
+// into view is cleared.
+static mrb_value
+lcd_scroll(mrb_state *mrb, mrb_value self)
+{
+  mrb_int dx, dy, x = 0, y = 0, w = -1, h = -1;
   tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "ii|iiii", &dx, &dy, &x, &y, &w, &h);
+
+  if (w < 0) w = tg->display_width;
+  if (h < 0) h = tg->display_height;
+  scroll_region(*tg, x, y, w, h, dx, dy);
+  return self;
+}
 
-  port = mrb_iv_get(mrb, self, mrb_intern_lit(mrb, "@port"));
-  addr = mrb_fixnum(mrb_iv_get(mrb, self, mrb_intern_lit(mrb, "@addr")));
+// OLED::Bitmap._pbm(str) / _xbm(str) => [width, height, BITMAP_ROWS data]
+static mrb_value
+bitmap_import(mrb_state *mrb, mrb_value src,
+              esp_err_t (*decode)(const char *, size_t, int16_t *, int16_t *, uint8_t *))
+{
+  int16_t w, h;
+  mrb_value data, result;
 
-  // get frame buffer
-  buffer = (uint8_t *)mrb_malloc(mrb, tg->display_pixel);
-  if (buffer != NULL) {
-    memset(buffer, 0x00, tg->display_pixel);
+  if (decode(RSTRING_PTR(src), RSTRING_LEN(src), &w, &h, NULL) != ESP_OK) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "bitmap: cannot read the image header");
   }
-  buffer_read(*tg, buffer, tg->display_pixel);
-  
-  // send data to OLED
-  cmd = i2c_cmd_link_create();
-  i2c_master_start(cmd);
-  i2c_master_write_byte(cmd, (addr << 1 ) | I2C_MASTER_WRITE, true);  
-  i2c_master_write_byte(cmd, SSD1306I2C_CONTROLBYTE_DATASTREAM, true);
-  for (uint16_t i = 0; i < tg->display_pixel; i++) {
-    i2c_master_write_byte(cmd, buffer[i], true);
-  }
-  i2c_master_stop(cmd);
-  err = i2c_master_cmd_begin(mrb_fixnum(port), cmd, 1000 / portTICK_RATE_MS);
-  i2c_cmd_link_delete(cmd);
-    if (err != ESP_OK) {
-    ESP_LOGI(TAG, "ssd1306_display error: %d", err);
+  data = mrb_str_new(mrb, NULL, ((w + 7) / 8) * h);
+  if (decode(RSTRING_PTR(src), RSTRING_LEN(src), &w, &h, (uint8_t *)RSTRING_PTR(data)) != ESP_OK) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "bitmap: image data is broken or truncated");
   }
-  mrb_free(mrb, buffer);
 
-  return mrb_fixnum_value(err);
-}   
+  result = mrb_ary_new_capa(mrb, 3);
+  mrb_ary_push(mrb, result, mrb_fixnum_value(w));
+  mrb_ary_push(mrb, result, mrb_fixnum_value(h));
+  mrb_ary_push(mrb, result, data);
+  return result;
+}
 
-// Configuration the Tiny graphics libraries
-static void
-tinygrafx_init(tinygrafx_t *tg)
+static mrb_value
+bitmap_pbm(mrb_state *mrb, mrb_value self)
 {
-  tg->display_width = SSD1306_DISPLAY_WIDTH;
-  tg->display_height = SSD1306_DISPLAY_HEIGHT;
-  tg->display_pixel = SSD1306_DISPLAY_PIXEL;
-  tg->font_width = SSD1306_FONT_WIDTH;
-  tg->font_height = SSD1306_FONT_HEIGHT;
+  mrb_value src;
+  mrb_get_args(mrb, "S", &src);
 
-  // set frame buffer
-  uint8_t *buffer;
-  buffer = (uint8_t *)malloc(tg->display_pixel);
-  if (buffer != NULL) {
-    memset(buffer, 0, tg->display_pixel);
+  return bitmap_import(mrb, src, pbm_decode);
+}
+
+static mrb_value
+bitmap_xbm(mrb_state *mrb, mrb_value self)
+{
+  mrb_value src;
+  mrb_get_args(mrb, "S", &src);
+
+  return bitmap_import(mrb, src, xbm_decode);
+}
+
+// OLED::Font[name] => font compiled into the firmware
+static mrb_value
+font_find(mrb_state *mrb, mrb_value self)
+{
+  mrb_value name;
+  const tinyfont_t *font;
+  mrb_get_args(mrb, "o", &name);
+
+  if (mrb_symbol_p(name)) {
+    name = mrb_sym2str(mrb, mrb_symbol(name));
+  }
+  if (!mrb_string_p(name)) {
+    mrb_raise(mrb, E_TYPE_ERROR, "Font: name must be a String or a Symbol");
+  }
+  font = tinyfont_find(mrb_str_to_cstr(mrb, name));
+  if (font == NULL) {
+    mrb_raisef(mrb, E_ARGUMENT_ERROR, "Font: no font named %S", name);
   }
-  tg->display_buffer = buffer; 
+  return mrb_obj_value(mrb_data_object_alloc(mrb, mrb_class_ptr(self), (void *)font, &font_type));
 }
 
-// free mrb object for GC.
-static void
-meb_ssd1306_free(mrb_state *mrb, void *ptr)
+// OLED::Font.names => names of the fonts compiled in
+static mrb_value
+font_names(mrb_state *mrb, mrb_value self)
 {
-  tinygrafx_t *tg = ptr;
-  mrb_free(mrb, tg->display_buffer);
+  mrb_value names = mrb_ary_new(mrb);
+
+  for (int16_t i = 0; tinyfont_builtin[i] != NULL; i++) {
+    mrb_ary_push(mrb, names, mrb_str_new_cstr(mrb, tinyfont_builtin[i]->name));
+  }
+  return names;
 }
 
-// mruby data_type
-static const struct mrb_data_type mrb_spi_config_type = {
-  "spi_config_type", meb_ssd1306_free
-};
+static mrb_value
+font_name(mrb_state *mrb, mrb_value self)
+{
+  return mrb_str_new_cstr(mrb, font_get(mrb, self)->name);
+}
 
 static mrb_value
-ssd1306_tinygrafx_init(mrb_state *mrb, mrb_value self) 
+font_height(mrb_state *mrb, mrb_value self)
+{
+  return mrb_fixnum_value(font_get(mrb, self)->height);
+}
+
+// font.width(str) => columns covered by str drawn at x = 0
+static mrb_value
+font_width(mrb_state *mrb, mrb_value self)
+{
+  mrb_value str;
+  int16_t x0, x1, lines;
+  mrb_get_args(mrb, "S", &str);
+
+  tinyfont_extent(font_get(mrb, self), 0, (const uint8_t *)RSTRING_PTR(str), RSTRING_LEN(str), &x0, &x1, &lines);
+  return mrb_fixnum_value((x0 > x1) ? 0 : x1 + 1);
+}
+
+// drawing color, font size and font are kept in tinygrafx_t
+static mrb_value
+lcd_get_color(mrb_state *mrb, mrb_value self)
 {
   tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
-  if (tg) {
-    mrb_free(mrb, tg);
-  }
-  
-  tg = (tinygrafx_t *)mrb_malloc(mrb, sizeof(tinygrafx_t));
-  DATA_TYPE(self) = &mrb_spi_config_type;
-  DATA_PTR(self)  = tg;
 
-  // Initialize the TINYGRAFX
-  tinygrafx_init(tg);
-  
-  return mrb_nil_value();
+  return mrb_fixnum_value(tg->color);
 }
 
-// mrbgem init
-void
-mrb_mruby_esp32_i2c_ssd1306_gem_init(mrb_state* mrb)
+static mrb_value
+lcd_get_width(mrb_state *mrb, mrb_value self)
 {
-  struct RClass *oled = mrb_define_module(mrb, "OLED");
-  mrb_define_const(mrb, oled, "BLACK", mrb_fixnum_value(BLACK));
-  mrb_define_const(mrb, oled, "WHITE", mrb_fixnum_value(WHITE));
-  mrb_define_const(mrb, oled, "INVERT", mrb_fixnum_value(INVERT));
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
 
-  struct RClass *ssd1306 = mrb_define_class_under(mrb, oled, "SSD1306", mrb->object_class);
-  MRB_SET_INSTANCE_TT(ssd1306, MRB_TT_DATA);
-  
-  // Common graphics methods
-  mrb_define_method(mrb, ssd1306, "clear", lcd_clear, MRB_ARGS_NONE());
-  mrb_define_method(mrb, ssd1306, "set_pixel", lcd_set_pixel, MRB_ARGS_REQ(2));
-  mrb_define_method(mrb, ssd1306, "get_pixel", lcd_get_pixel, MRB_ARGS_REQ(2));
-  mrb_define_method(mrb, ssd1306, "line", lcd_draw_line, MRB_ARGS_REQ(4));
-  mrb_define_method(mrb, ssd1306, "vline", lcd_draw_vertical_line, MRB_ARGS_REQ(3));
-  mrb_define_method(mrb, ssd1306, "hline", lcd_draw_horizontal_line, MRB_ARGS_REQ(3));
-  mrb_define_method(mrb, ssd1306, "rect", lcd_draw_rect, MRB_ARGS_REQ(4));
-  mrb_define_method(mrb, ssd1306, "fill_rect", lcd_draw_fill_rect, MRB_ARGS_REQ(4));
-  mrb_define_method(mrb, ssd1306, "circle", lcd_draw_circle, MRB_ARGS_REQ(3));
-  mrb_define_method(mrb, ssd1306, "fill_circle", lcd_draw_fill_circle, MRB_ARGS_REQ(3));
-  mrb_define_method(mrb, ssd1306, "text", lcd_text, MRB_ARGS_REQ(3));
+  return mrb_fixnum_value(tg->display_width);
+}
 
-  // Send frame buffer to display
-  mrb_define_method(mrb, ssd1306, "display", ssd1306_display, MRB_ARGS_NONE());
-  
-  // Initialize the TINYGRAFX
-  mrb_define_method(mrb, ssd1306, "_init", ssd1306_tinygrafx_init, MRB_ARGS_NONE());
+static mrb_value
+lcd_get_height(mrb_state *mrb, mrb_value self)
+{
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+
+  return mrb_fixnum_value(tg->display_height);
+}
+
+static mrb_value
+lcd_set_color(mrb_state *mrb, mrb_value self)
+{
+  mrb_int color;
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "i", &color);
+
+  tg->color = color;
+  return mrb_fixnum_value(color);
+}
+
+static mrb_value
+lcd_get_fontsize(mrb_state *mrb, mrb_value self)
+{
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+
+  return mrb_fixnum_value(tg->fontsize);
+}
+
+static mrb_value
+lcd_set_fontsize(mrb_state *mrb, mrb_value self)
+{
+  mrb_int fontsize;
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "i", &fontsize);
+
+  tg->fontsize = fontsize;
+  return mrb_fixnum_value(fontsize);
+}
+
+// oled.font = OLED::Font[name], nil for the 8x8 font scaled by fontsize
+static mrb_value
+lcd_get_font(mrb_state *mrb, mrb_value self)
+{
+  return mrb_iv_get(mrb, self, mrb_intern_lit(mrb, "@font"));
+}
+
+static mrb_value
+lcd_set_font(mrb_state *mrb, mrb_value self)
+{
+  mrb_value font;
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "o", &font);
+
+  tg->font = font_get(mrb, font);
+  mrb_iv_set(mrb, self, mrb_intern_lit(mrb, "@font"), font);
+  return font;
+}
+
+// _clip(x, y, w, h, viewport) => previous clip state, for _restore_clip
+static mrb_value
+lcd_clip(mrb_state *mrb, mrb_value self)
+{
+  mrb_int x, y, w, h;
+  mrb_bool viewport;
+  mrb_value saved;
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "iiiib", &x, &y, &w, &h, &viewport);
+
+  saved = mrb_str_new(mrb, (const char *)&tg->clip, sizeof(tinygrafx_clip_t));
+  if (viewport) {
+    viewport_set(tg, x, y, w, h);
+  }
+  else {
+    clip_set(tg, x, y, w, h);
+  }
+  return saved;
+}
+
+static mrb_value
+lcd_restore_clip(mrb_state *mrb, mrb_value self)
+{
+  mrb_value saved;
+  tinygrafx_clip_t clip;
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "S", &saved);
+
+  if (RSTRING_LEN(saved) != sizeof(tinygrafx_clip_t)) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "restore_clip: not a clip state");
+  }
+  memcpy(&clip, RSTRING_PTR(saved), sizeof(tinygrafx_clip_t));
+  // the primitives trust the clip bounds, they must lie inside the frame
+  if ((clip.x0 < 0) || (clip.y0 < 0) || (clip.x0 > clip.x1) || (clip.y0 > clip.y1) ||
+      (clip.x1 > tg->display_width) || (clip.y1 > tg->display_height)) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "restore_clip: clip state out of the frame");
+  }
+  tg->clip = clip;
+  return self;
+}
+
+static mrb_value
+lcd_reset_clip(mrb_state *mrb, mrb_value self)
+{
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+
+  clip_reset(tg);
+  return self;
+}
+
+// Run one batch command. args holds BATCH_MAX_ARGS values, text is only
+// used by BATCH_TEXT.
+static void
+batch_exec(tinygrafx_t *tg, uint8_t op, const int16_t *args, uint8_t *text, int16_t length)
+{
+  int16_t color = tg->color;
+
+  switch (op) {
+    case BATCH_CLEAR:       buffer_clear(*tg); break;
+    case BATCH_PIXEL:       set_pixel(*tg, args[0], args[1], color); break;
+    case BATCH_LINE:
+      if ((color < BLACK) || (color > INVERT)) {
+        color = WHITE;
+      }
+      draw_thick_line(*tg, args[0], args[1], args[2], args[3], args[4], color);
+      break;
+    case BATCH_HLINE:       draw_horizontal_line(*tg, args[0], args[1], args[2], color); break;
+    case BATCH_VLINE:       draw_vertical_line(*tg, args[0], args[1], args[2], color); break;
+    case BATCH_RECT:        draw_rect(*tg, args[0], args[1], args[2], args[3], color); break;
+    case BATCH_FILL_RECT:   draw_fill_rect(*tg, args[0], args[1], args[2], args[3], color); break;
+    case BATCH_CIRCLE:      draw_circle(*tg, args[0], args[1], args[2], color); break;
+    case BATCH_FILL_CIRCLE: draw_fill_circle(*tg, args[0], args[1], args[2], color); break;
+    case BATCH_TEXT:        display_text(*tg, args[0], args[1], text, length, color, tg->fontsize, tg->font); break;
+    case BATCH_COLOR:       tg->color = args[0]; break;
+    case BATCH_FONTSIZE:    tg->fontsize = args[0]; break;
+  }
+}
+
+// Packed form: one opcode byte, then its arguments as little endian
+// int16. BATCH_TEXT is followed by x, y, a length byte and the characters.
+static void
+batch_packed(mrb_state *mrb, tinygrafx_t *tg, const uint8_t *p, mrb_int size)
+{
+  const uint8_t *end = p + size;
+  int16_t args[BATCH_MAX_ARGS];
+
+  while (p < end) {
+    uint8_t op = *p++;
+    uint8_t argc, length = 0;
+
+    if (op >= BATCH_COMMANDS) {
+      mrb_raisef(mrb, E_ARGUMENT_ERROR, "draw_batch: unknown command %S", mrb_fixnum_value(op));
+    }
+    argc = batch_argc[op];
+    if (p + argc * 2 + ((op == BATCH_TEXT) ? 1 : 0) > end) {
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "draw_batch: truncated command");
+    }
+    for (uint8_t i = 0; i < argc; i++, p += 2) {
+      args[i] = (int16_t)(p[0] | (p[1] << 8));
+    }
+    if (op == BATCH_TEXT) {
+      length = *p++;
+      if (p + length > end) {
+        mrb_raise(mrb, E_ARGUMENT_ERROR, "draw_batch: truncated command");
+      }
+    }
+    batch_exec(tg, op, args, (uint8_t *)p, length);
+    p += length;
+  }
+}
+
+static int16_t
+batch_int(mrb_state *mrb, mrb_value v)
+{
+  if (mrb_fixnum_p(v)) {
+    return mrb_fixnum(v);
+  }
+  if (mrb_float_p(v)) {
+    return (int16_t)mrb_float(v);
+  }
+  mrb_raise(mrb, E_TYPE_ERROR, "draw_batch: coordinates must be numbers");
+  return 0;
+}
+
+// Array form: [[:line, x0, y0, x1, y1], [:pixel, x, y], [:text, x, y, "str"], ...]
+static void
+batch_array(mrb_state *mrb, tinygrafx_t *tg, mrb_value cmds)
+{
+  mrb_sym names[BATCH_COMMANDS];
+  int16_t args[BATCH_MAX_ARGS];
+
+  for (uint8_t op = 0; op < BATCH_COMMANDS; op++) {
+    names[op] = mrb_intern_cstr(mrb, batch_names[op]);
+  }
+
+  for (mrb_int i = 0; i < RARRAY_LEN(cmds); i++) {
+    mrb_value cmd = mrb_ary_ref(mrb, cmds, i);
+    mrb_value text = mrb_nil_value();
+    uint8_t op, argc;
+    mrb_int given;
+
+    if (!mrb_array_p(cmd) || (RARRAY_LEN(cmd) == 0) || !mrb_symbol_p(mrb_ary_ref(mrb, cmd, 0))) {
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "draw_batch: each command must be [:name, args...]");
+    }
+    for (op = 0; op < BATCH_COMMANDS; op++) {
+      if (names[op] == mrb_symbol(mrb_ary_ref(mrb, cmd, 0))) break;
+    }
+    if (op == BATCH_COMMANDS) {
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "draw_batch: unknown command");
+    }
+
+    argc = batch_argc[op];
+    given = RARRAY_LEN(cmd) - 1;
+    if (op == BATCH_TEXT) {
+      given--;
+      text = mrb_ary_ref(mrb, cmd, 3);
+      if (!mrb_string_p(text)) {
+        mrb_raise(mrb, E_TYPE_ERROR, "draw_batch: text needs a string");
+      }
+    }
+    // the line width is optional
+    if ((op == BATCH_LINE) && (given == argc - 1)) {
+      args[argc - 1] = 1;
+      argc--;
+    }
+    if (given != argc) {
+      mrb_raisef(mrb, E_ARGUMENT_ERROR, "draw_batch: wrong number of arguments for %S", mrb_ary_ref(mrb, cmd, 0));
+    }
+    for (uint8_t n = 0; n < argc; n++) {
+      args[n] = batch_int(mrb, mrb_ary_ref(mrb, cmd, n + 1));
+    }
+
+    if (op == BATCH_TEXT) {
+      batch_exec(tg, op, args, (uint8_t *)RSTRING_PTR(text), RSTRING_LEN(text));
+    }
+    else {
+      batch_exec(tg, op, args, NULL, 0);
+    }
+  }
+}
+
+// Run many drawing commands in one call, given as an Array of commands
+// or as a packed String.
+static mrb_value
+lcd_draw_batch(mrb_state *mrb, mrb_value self)
+{
+  mrb_value cmds;
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "o", &cmds);
+
+  if (mrb_string_p(cmds)) {
+    batch_packed(mrb, tg, (const uint8_t *)RSTRING_PTR(cmds), RSTRING_LEN(cmds));
+  }
+  else if (mrb_array_p(cmds)) {
+    batch_array(mrb, tg, cmds);
+  }
+  else {
+    mrb_raise(mrb, E_TYPE_ERROR, "draw_batch: expected an Array or a String");
+  }
+  return self;
+}
+// ----- Common graphics methods -----
+
+
+
+// ----- SSD1306 methods and functions -----
+
+// Background transfer task. It sends the snapshot in dev->back each time
+// flush_start is given and reports the result through flush_done.
+static void
+ssd1306_flush_task(void *arg)
+{
+  ssd1306_t *dev = (ssd1306_t *)arg;
+
+  while (1) {
+    xSemaphoreTake(dev->flush_start, portMAX_DELAY);
+    dev->flush_err = ssd1306_flush(dev, &dev->back, dev->back_mode);
+    if (dev->flush_err != ESP_OK) {
+      ESP_LOGI(TAG, "ssd1306_flush_task error: %d", dev->flush_err);
+    }
+    xSemaphoreGive(dev->flush_done);
+  }
+}
+
+// Free what ssd1306_async_init created, the task is not running
+static void
+ssd1306_async_free(ssd1306_t *dev)
+{
+  if (dev->flush_start != NULL) vSemaphoreDelete(dev->flush_start);
+  if (dev->flush_done != NULL) vSemaphoreDelete(dev->flush_done);
+  free(dev->back.display_buffer);
+  free(dev->back.dirty_x0);
+  dev->flush_start = NULL;
+  dev->flush_done = NULL;
+  dev->back.display_buffer = NULL;
+  dev->back.dirty_x0 = NULL;
+  dev->back.dirty_x1 = NULL;
+}
+
+// Create the snapshot buffer and the transfer task on first use. On
+// failure nothing is kept, so the next call starts again from scratch.
+static esp_err_t
+ssd1306_async_init(ssd1306_t *dev)
+{
+  tinygrafx_t *back = &dev->back;
+
+  if (dev->flush_task != NULL) {
+    return ESP_OK;
+  }
+
+  *back = dev->tg;
+  back->display_buffer = (uint8_t *)malloc(back->display_pixel);
+  back->dirty_x0 = (int16_t *)malloc(sizeof(int16_t) * back->display_pages * 2);
+  dev->flush_start = xSemaphoreCreateBinary();
+  dev->flush_done = xSemaphoreCreateBinary();
+  if ((back->display_buffer == NULL) || (back->dirty_x0 == NULL) ||
+      (dev->flush_start == NULL) || (dev->flush_done == NULL)) {
+    ssd1306_async_free(dev);
+    return ESP_ERR_NO_MEM;
+  }
+  back->dirty_x1 = back->dirty_x0 + back->display_pages;
+  dirty_clean(*back);
+  dev->flush_err = ESP_OK;
+  xSemaphoreGive(dev->flush_done);
+
+  if (xTaskCreate(ssd1306_flush_task, "ssd1306_flush", SSD1306_TASK_STACK, dev,
+                  uxTaskPriorityGet(NULL), &dev->flush_task) != pdPASS) {
+    dev->flush_task = NULL;
+    ssd1306_async_free(dev);
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+// Hand the panel state reached by the finished transfer back to the front
+// buffer. Windows the transfer could not send become dirty again.
+static void
+ssd1306_async_reclaim(ssd1306_t *dev)
+{
+  tinygrafx_t *tg = &dev->tg;
+  tinygrafx_t *back = &dev->back;
+
+  for (int16_t page = 0; page < tg->display_pages; page++) {
+    if (back->dirty_x0[page] < tg->dirty_x0[page]) tg->dirty_x0[page] = back->dirty_x0[page];
+    if (back->dirty_x1[page] > tg->dirty_x1[page]) tg->dirty_x1[page] = back->dirty_x1[page];
+  }
+  dirty_clean(*back);
+  tg->shadow_valid = back->shadow_valid;
+}
+
+// Wait until the transfer in flight (if any) has finished.
+static esp_err_t
+ssd1306_async_wait(ssd1306_t *dev)
+{
+  if (dev->flush_task == NULL) {
+    return ESP_OK;
+  }
+  xSemaphoreTake(dev->flush_done, portMAX_DELAY);
+  ssd1306_async_reclaim(dev);
+  xSemaphoreGive(dev->flush_done);
+
+  return dev->flush_err;
+}
+
+// I2C settings kept in the instance variables, an SPI panel keeps its
+// device from _spi
+static void
+ssd1306_load_bus(mrb_state *mrb, mrb_value self, ssd1306_t *dev)
+{
+  if (dev->bus.ops != &transport_i2c_ops) {
+    return;
+  }
+  dev->bus.i2c.port = mrb_fixnum(mrb_iv_get(mrb, self, mrb_intern_lit(mrb, "@port")));
+  dev->bus.i2c.addr = mrb_fixnum(mrb_iv_get(mrb, self, mrb_intern_lit(mrb, "@addr")));
+}
+
+static mrb_value
+ssd1306_display(mrb_state *mrb, mrb_value self)
+{
+  int16_t flush_mode;
+  mrb_bool force = FALSE;
+  int64_t start;
+  esp_err_t err;
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "|b", &force);
+
+  // paced: a frame that is not due yet stays dirty for the next one.
+  // A temporal gray image always has a next plane to send.
+  start = esp_timer_get_time();
+  if ((dev->pace.period_us > 0) && !force) {
+    ssd1306_gray_mark(dev);
+    if (ssd1306_pace_frame(&dev->pace, &dev->tg, start) != PACE_SEND) {
+      return mrb_fixnum_value(ESP_OK);
+    }
+  }
+  ssd1306_gray_step(dev);
+
+  ssd1306_load_bus(mrb, self, dev);
+  flush_mode = mrb_fixnum(mrb_iv_get(mrb, self, mrb_intern_lit(mrb, "@flush_mode")));
+
+  // the bus and the shadow buffer belong to the async transfer until it ends
+  ssd1306_async_wait(dev);
+
+  // send data to OLED
+  err = ssd1306_flush(dev, &dev->tg, flush_mode);
+  if (err != ESP_OK) {
+    ESP_LOGI(TAG, "ssd1306_display error: %d", err);
+  }
+  if (dev->pace.period_us > 0) {
+    ssd1306_pace_sent(&dev->pace, start, esp_timer_get_time());
+  }
+
+  return mrb_fixnum_value(err);
+}   
+
+// pace(fps[, bus_load]) limits display to fps frames per second, 0 = off.
+// With bus_load (1..100) the rate drops while a flush takes more than
+// bus_load % of the frame period.
+static mrb_value
+ssd1306_pace(mrb_state *mrb, mrb_value self)
+{
+  mrb_int fps, bus_load = 0;
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "i|i", &fps, &bus_load);
+
+  if ((fps < 0) || (fps > 1000) || (bus_load < 0) || (bus_load > 100)) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "pace: fps must be 0..1000 and bus_load 0..100");
+  }
+  ssd1306_pace_set(&dev->pace, fps, bus_load);
+  return self;
+}
+
+// bus_config(chunk[, timeout_ms]) sends the frame in transactions of at
+// most chunk data bytes (0 = a transaction per window) so the other
+// devices on the bus wait less, each failing after timeout_ms.
+static mrb_value
+ssd1306_bus_config(mrb_state *mrb, mrb_value self)
+{
+  mrb_int chunk, timeout_ms = SSD1306_TIMEOUT_MS;
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "i|i", &chunk, &timeout_ms);
+
+  if ((chunk < 0) || (chunk > UINT16_MAX) || (timeout_ms <= 0) || (timeout_ms > 60000)) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "bus_config: chunk must be 0..65535 and timeout_ms 1..60000");
+  }
+  // the transfer in flight uses the current settings
+  ssd1306_async_wait(dev);
+  ssd1306_bus_set(dev, chunk, timeout_ms);
+  return self;
+}
+
+// Frame rate in use, lower than the target while adaptive pacing slows down
+static mrb_value
+ssd1306_fps(mrb_state *mrb, mrb_value self)
+{
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+
+  if (dev->pace.current_us == 0) {
+    return mrb_fixnum_value(0);
+  }
+  return mrb_fixnum_value(1000000 / dev->pace.current_us);
+}
+
+// Frames merged into a later one since pace was called
+static mrb_value
+ssd1306_dropped_frames(mrb_state *mrb, mrb_value self)
+{
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+
+  return mrb_fixnum_value(dev->pace.dropped);
+}
+
+// Snapshot the frame and send it from the background task.
+// While a previous frame is still in flight, ASYNC_BLOCK waits for it and
+// ASYNC_DROP returns false without taking the snapshot.
+static mrb_value
+ssd1306_display_async(mrb_state *mrb, mrb_value self)
+{
+  mrb_int policy = ASYNC_BLOCK;
+  esp_err_t err;
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+  tinygrafx_t *tg = &dev->tg;
+  tinygrafx_t *back = &dev->back;
+  mrb_get_args(mrb, "|i", &policy);
+
+  err = ssd1306_async_init(dev);
+  if (err != ESP_OK) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "ssd1306: cannot start the flush task");
+  }
+  if (xSemaphoreTake(dev->flush_done, (policy == ASYNC_DROP) ? 0 : portMAX_DELAY) != pdTRUE) {
+    return mrb_false_value();
+  }
+
+  ssd1306_load_bus(mrb, self, dev);
+  dev->back_mode = mrb_fixnum(mrb_iv_get(mrb, self, mrb_intern_lit(mrb, "@flush_mode")));
+
+  // snapshot the frame and its dirty windows
+  ssd1306_gray_step(dev);
+  ssd1306_async_reclaim(dev);
+  memcpy(back->display_buffer, tg->display_buffer, tg->display_pixel);
+  memcpy(back->dirty_x0, tg->dirty_x0, sizeof(int16_t) * tg->display_pages * 2);
+  dirty_clean(*tg);
+  back->shadow_valid = tg->shadow_valid;
+
+  xSemaphoreGive(dev->flush_start);
+  return mrb_true_value();
+}
+
+// Wait for the frame sent by display_async, returns its result
+static mrb_value
+ssd1306_wait_flush(mrb_state *mrb, mrb_value self)
+{
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+
+  return mrb_fixnum_value(ssd1306_async_wait(dev));
+}
+
+#ifdef TINYGRAFX_STATS
+static const char *stat_names[STAT_TYPES] = {
+  "clear", "pixel", "line", "hline", "vline", "rect",
+  "fill_rect", "circle", "fill_circle", "text", "bitmap", "scroll", "composite",
+  "ellipse", "fill_ellipse", "arc", "pie", "fill_polygon", "round_rect", "fill_round_rect",
+  "gray_image"
+};
+
+static void
+stats_set(mrb_state *mrb, mrb_value hash, const char *name, mrb_int value)
+{
+  mrb_hash_set(mrb, hash, mrb_symbol_value(mrb_intern_cstr(mrb, name)), mrb_fixnum_value(value));
+}
+#endif
+
+// Counters since the last reset_stats, nil when they are compiled out
+static mrb_value
+ssd1306_stats(mrb_state *mrb, mrb_value self)
+{
+#ifdef TINYGRAFX_STATS
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+  tinygrafx_stats_t *stats = dev->tg.stats;
+  mrb_value hash, calls, latency, hold;
+
+  if (stats == NULL) {
+    return mrb_nil_value();
+  }
+  // the background transfer updates the flush counters
+  ssd1306_async_wait(dev);
+
+  calls = mrb_hash_new(mrb);
+  for (int16_t type = 0; type < STAT_TYPES; type++) {
+    stats_set(mrb, calls, stat_names[type], stats->calls[type]);
+  }
+  latency = mrb_hash_new(mrb);
+  stats_set(mrb, latency, "min", stats->flushes ? stats->flush_us_min : 0);
+  stats_set(mrb, latency, "avg", stats->flushes ? stats->flush_us_total / stats->flushes : 0);
+  stats_set(mrb, latency, "max", stats->flush_us_max);
+  hold = mrb_hash_new(mrb);
+  stats_set(mrb, hold, "avg", stats->transactions ? stats->hold_us_total / stats->transactions : 0);
+  stats_set(mrb, hold, "max", stats->hold_us_max);
+
+  hash = mrb_hash_new(mrb);
+  mrb_hash_set(mrb, hash, mrb_symbol_value(mrb_intern_lit(mrb, "calls")), calls);
+  stats_set(mrb, hash, "pixels", stats->pixels);
+  stats_set(mrb, hash, "bytes", stats->bytes);
+  stats_set(mrb, hash, "transactions", stats->transactions);
+  stats_set(mrb, hash, "errors", stats->errors);
+  stats_set(mrb, hash, "timeouts", stats->timeouts);
+  stats_set(mrb, hash, "flushes", stats->flushes);
+  mrb_hash_set(mrb, hash, mrb_symbol_value(mrb_intern_lit(mrb, "flush_us")), latency);
+  mrb_hash_set(mrb, hash, mrb_symbol_value(mrb_intern_lit(mrb, "bus_hold_us")), hold);
+  return hash;
+#else
+  return mrb_nil_value();
+#endif
+}
+
+static mrb_value
+ssd1306_reset_stats(mrb_state *mrb, mrb_value self)
+{
+#ifdef TINYGRAFX_STATS
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+
+  ssd1306_async_wait(dev);
+  if (dev->tg.stats != NULL) {
+    stats_reset(dev->tg.stats);
+  }
+#endif
+  return self;
+}
+
+// Send the configuration of the panel in one transaction and turn it on.
+// Also brings a panel back after a brown-out, the next display sends the
+// whole frame.
+static mrb_value
+ssd1306_init_panel_method(mrb_state *mrb, mrb_value self)
+{
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+
+  ssd1306_load_bus(mrb, self, dev);
+  ssd1306_async_wait(dev);
+
+  return mrb_fixnum_value(ssd1306_init_panel(dev));
+}
+
+// Turn the panel off and on, GDDRAM keeps its contents meanwhile
+static mrb_value
+ssd1306_sleep_method(mrb_state *mrb, mrb_value self)
+{
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+
+  ssd1306_load_bus(mrb, self, dev);
+  ssd1306_async_wait(dev);
+
+  return mrb_fixnum_value(ssd1306_sleep(dev));
+}
+
+static mrb_value
+ssd1306_wake_method(mrb_state *mrb, mrb_value self)
+{
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+
+  ssd1306_load_bus(mrb, self, dev);
+  ssd1306_async_wait(dev);
+
+  return mrb_fixnum_value(ssd1306_wake(dev));
+}
+
+// start_scroll(direction[, start_page, end_page, frames, offset])
+// Continuous hardware scroll, the CPU and the bus are free meanwhile.
+static mrb_value
+ssd1306_start_scroll(mrb_state *mrb, mrb_value self)
+{
+  mrb_int direction, start_page = 0, end_page = -1, frames = 5, offset = 1;
+  esp_err_t err;
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "i|iiii", &direction, &start_page, &end_page, &frames, &offset);
+
+  if (end_page < 0) {
+    end_page = dev->tg.display_pages - 1;
+  }
+  ssd1306_load_bus(mrb, self, dev);
+  ssd1306_async_wait(dev);
+
+  err = ssd1306_scroll_start(dev, direction, start_page, end_page, frames, offset);
+  if (err == ESP_ERR_INVALID_ARG) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "start_scroll: bad direction or page range");
+  }
+  if (err == ESP_ERR_NOT_SUPPORTED) {
+    mrb_raise(mrb, E_NOTIMP_ERROR, "start_scroll: the controller has no hardware scroll");
+  }
+  return mrb_fixnum_value(err);
+}
+
+// Stop the hardware scroll, the next display sends the whole frame
+static mrb_value
+ssd1306_stop_scroll(mrb_state *mrb, mrb_value self)
+{
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+
+  ssd1306_load_bus(mrb, self, dev);
+  ssd1306_async_wait(dev);
+
+  return mrb_fixnum_value(ssd1306_scroll_stop(dev));
+}
+
+// _gray_planes(x, y, w, h, data, planes) dithers the image into planes
+// bitplanes, each display sends the next one
+static mrb_value
+ssd1306_gray_planes(mrb_state *mrb, mrb_value self)
+{
+  mrb_int x, y, w, h, planes;
+  mrb_value data;
+  esp_err_t err;
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "iiiiSi", &x, &y, &w, &h, &data, &planes);
+
+  if ((planes < 2) || (planes > GRAY_MAX_PLANES)) {
+    mrb_raisef(mrb, E_ARGUMENT_ERROR, "gray_image: planes must be 2..%S", mrb_fixnum_value(GRAY_MAX_PLANES));
+  }
+  gray_check(mrb, w, h, data);
+  err = ssd1306_gray_start(dev, x, y, w, h, (const uint8_t *)RSTRING_PTR(data), planes);
+  if (err != ESP_OK) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "gray_image: cannot allocate the planes");
+  }
+  return self;
+}
+
+// Stop the temporal gray image, the frame keeps its last plane
+static mrb_value
+ssd1306_stop_gray(mrb_state *mrb, mrb_value self)
+{
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+
+  ssd1306_gray_stop(dev);
+  return self;
+}
+
+// _play(stream, fps, x, page, repeat) decodes each frame of a frame
+// stream at column x of page and sends it with FLUSH_DIRTY, paced to fps.
+// The stream is played repeat times. There is no endless mode, the VM is
+// held for the whole call, so a loop in Ruby plays it over and over.
+static mrb_value
+ssd1306_play(mrb_state *mrb, mrb_value self)
+{
+  mrb_value stream;
+  mrb_int fps, x, page, repeat;
+  fstream_t fs;
+  TickType_t last, period;
+  esp_err_t err;
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "Siiii", &stream, &fps, &x, &page, &repeat);
+
+  if (fps <= 0) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "play: fps must be positive");
+  }
+  if (repeat < 1) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "play: repeat must be at least 1");
+  }
+  if (fstream_open(&fs, (const uint8_t *)RSTRING_PTR(stream), RSTRING_LEN(stream)) != ESP_OK) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "play: not a frame stream");
+  }
+  ssd1306_load_bus(mrb, self, dev);
+  ssd1306_async_wait(dev);
+
+  // at least a tick, a rate above the tick rate must not busy-loop
+  period = pdMS_TO_TICKS(1000 / fps);
+  if (period == 0) {
+    period = 1;
+  }
+  last = xTaskGetTickCount();
+  for (mrb_int n = 0; n < repeat; n++) {
+    fstream_rewind(&fs);
+    while ((err = fstream_next(&fs, dev->tg, x, page)) == ESP_OK) {
+      err = ssd1306_flush(dev, &dev->tg, FLUSH_DIRTY);
+      if (err != ESP_OK) {
+        ESP_LOGI(TAG, "ssd1306_play error: %d", err);
+        return mrb_fixnum_value(err);
+      }
+      vTaskDelayUntil(&last, period);
+    }
+    if (err == ESP_ERR_INVALID_ARG) {
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "play: frames do not fit on the screen at this position");
+    }
+    if (err != ESP_ERR_NOT_FOUND) {
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "play: broken frame stream");
+    }
+  }
+  return mrb_fixnum_value(ESP_OK);
+}
+
+// ----- Display list -----
+static const char *dl_names[DL_TYPES] = {
+  "text", "rect", "fill_rect", "line", "circle", "fill_circle", "bitmap"
+};
+
+// item(name, type, args...) adds a named item on top of the display list,
+// or updates the item of that name. It is drawn with the current color
+// and font size by the next render.
+//   item(:title, :text, x, y, "string")
+//   item(:frame, :rect, x, y, w, h)          (also :fill_rect)
+//   item(:needle, :line, x0, y0, x1, y1[, width])
+//   item(:dot, :circle, x, y, r)             (also :fill_circle)
+//   item(:icon, :bitmap, x, y, w, h, "bits"[, layout])
+static mrb_value
+ssd1306_item(mrb_state *mrb, mrb_value self)
+{
+  mrb_sym name, type_name;
+  mrb_value *argv;
+  mrb_int argc;
+  mrb_value data = mrb_nil_value();
+  int16_t args[DL_MAX_ARGS];
+  uint8_t type, nargs;
+  esp_err_t err;
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "nn*", &name, &type_name, &argv, &argc);
+
+  for (type = 0; type < DL_TYPES; type++) {
+    if (mrb_intern_cstr(mrb, dl_names[type]) == type_name) break;
+  }
+  if (type == DL_TYPES) {
+    mrb_raisef(mrb, E_ARGUMENT_ERROR, "item: unknown type %S", mrb_symbol_value(type_name));
+  }
+
+  switch (type) {
+    case DL_TEXT:   nargs = 2; break;
+    case DL_LINE:   nargs = 5; break;
+    case DL_CIRCLE:
+    case DL_FILL_CIRCLE: nargs = 3; break;
+    default:        nargs = 4; break;
+  }
+  if ((type == DL_TEXT) || (type == DL_BITMAP)) {
+    // the bitmap layout is optional
+    mrb_int extra = ((type == DL_BITMAP) && (argc == nargs + 2)) ? 1 : 0;
+    if ((argc != nargs + 1 + extra) || !mrb_string_p(argv[nargs])) {
+      mrb_raisef(mrb, E_ARGUMENT_ERROR, "item: %S needs %S numbers and a string", mrb_symbol_value(type_name), mrb_fixnum_value(nargs));
+    }
+    data = argv[nargs];
+    if (type == DL_BITMAP) {
+      args[4] = extra ? batch_int(mrb, argv[nargs + 1]) : BITMAP_ROWS;
+    }
+  }
+  else if ((type == DL_LINE) && (argc == nargs - 1)) {
+    // the line width is optional
+    args[--nargs] = 1;
+  }
+  else if (argc != nargs) {
+    mrb_raisef(mrb, E_ARGUMENT_ERROR, "item: %S needs %S numbers", mrb_symbol_value(type_name), mrb_fixnum_value(nargs));
+  }
+  for (uint8_t n = 0; n < nargs; n++) {
+    args[n] = batch_int(mrb, argv[n]);
+  }
+  if (type == DL_BITMAP) {
+    if ((args[4] != BITMAP_PAGES) && (args[4] != BITMAP_ROWS)) {
+      mrb_raisef(mrb, E_ARGUMENT_ERROR, "item: unknown bitmap layout %S", mrb_fixnum_value(args[4]));
+    }
+    if (RSTRING_LEN(data) < bitmap_size(args[2], args[3], args[4])) {
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "item: bitmap string is too short");
+    }
+  }
+
+  if (mrb_nil_p(data)) {
+    err = dl_set(&dev->list, name, type, args, NULL, 0, dev->tg.color, dev->tg.fontsize, dev->tg.font);
+  }
+  else {
+    err = dl_set(&dev->list, name, type, args, (const uint8_t *)RSTRING_PTR(data), RSTRING_LEN(data),
+                 dev->tg.color, dev->tg.fontsize, dev->tg.font);
+  }
+  if (err != ESP_OK) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "item: cannot allocate the item");
+  }
+  return self;
+}
+
+// Remove a named item, its pixels are cleared by the next render
+static mrb_value
+ssd1306_remove_item(mrb_state *mrb, mrb_value self)
+{
+  mrb_sym name;
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "n", &name);
+
+  return mrb_bool_value(dl_remove(&dev->list, name));
+}
+
+static mrb_value
+ssd1306_clear_items(mrb_state *mrb, mrb_value self)
+{
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+
+  dl_clear(&dev->list);
+  return self;
+}
+
+// Draw what changed in the display list into the frame buffer. With
+// full = true every item is drawn again, use it after clear.
+// Returns the number of items drawn.
+static mrb_value
+ssd1306_render(mrb_state *mrb, mrb_value self)
+{
+  mrb_bool full = FALSE;
+  int16_t drawn;
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "|b", &full);
+
+  if (full) {
+    dl_invalidate(&dev->list, dev->tg);
+  }
+  drawn = dl_render(&dev->list, dev->tg);
+  if (drawn < 0) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "render: cannot allocate the scratch frame");
+  }
+  return mrb_fixnum_value(drawn);
+}
+
+// free mrb object for GC.
+static void
+meb_ssd1306_free(mrb_state *mrb, void *ptr)
+{
+  ssd1306_t *dev = ptr;
+  if (dev->flush_task != NULL) {
+    ssd1306_async_wait(dev);
+    vTaskDelete(dev->flush_task);
+  }
+  ssd1306_async_free(dev);
+  ssd1306_gray_stop(dev);
+  transport_release(&dev->bus);
+  dl_free(&dev->list);
+  tinygrafx_free(&dev->tg);
+  mrb_free(mrb, dev);
+}
+
+// mruby data_type
+static const struct mrb_data_type mrb_spi_config_type = {
+  "spi_config_type", meb_ssd1306_free
+};
+
+// _init(shadow[, width, height, controller, column_offset])
+// column_offset < 0 centers the panel in the controller GDDRAM.
+static mrb_value
+ssd1306_tinygrafx_init(mrb_state *mrb, mrb_value self) 
+{
+  mrb_bool shadow = FALSE;
+  mrb_int width = SSD1306_DISPLAY_WIDTH, height = SSD1306_DISPLAY_HEIGHT;
+  mrb_int controller = CTRL_SSD1306, column_offset = -1;
+  esp_err_t err;
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+  if (dev) {
+    meb_ssd1306_free(mrb, dev);
+    DATA_PTR(self) = NULL;
+  }
+  mrb_get_args(mrb, "|biiii", &shadow, &width, &height, &controller, &column_offset);
+
+  if ((width < 0) || (width > SH1106_RAM_COLUMNS) || (height < 0) || (height > SSD1306_MAX_HEIGHT) ||
+      (controller < 0) || (column_offset > SH1106_RAM_COLUMNS)) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "ssd1306: unsupported panel geometry");
+  }
+  
+  dev = (ssd1306_t *)mrb_malloc(mrb, sizeof(ssd1306_t));
+  memset(dev, 0, sizeof(ssd1306_t));
+  if (ssd1306_geometry(dev, width, height, controller, column_offset) != ESP_OK) {
+    mrb_free(mrb, dev);
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "ssd1306: unsupported panel geometry");
+  }
+  DATA_TYPE(self) = &mrb_spi_config_type;
+  DATA_PTR(self)  = dev;
+  transport_i2c_init(&dev->bus, I2C_NUM_0, 0x3C);
+
+  // Initialize the TINYGRAFX
+  err = tinygrafx_init(&dev->tg, width, height, shadow);
+  if (err != ESP_OK) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "ssd1306: cannot allocate the frame buffer");
+  }
+  
+  return mrb_nil_value();
+}
+
+// _spi(host, cs, dc, rst, clock_hz) sends the panel over 4-wire SPI
+// instead of I2C. The SPI object has set up the bus of host, cs < 0 and
+// rst < 0 are not wired.
+static mrb_value
+ssd1306_spi(mrb_state *mrb, mrb_value self)
+{
+  mrb_int host, cs, dc, rst, clock_hz;
+  esp_err_t err;
+  ssd1306_t *dev = (ssd1306_t *)DATA_PTR(self);
+  mrb_get_args(mrb, "iiiii", &host, &cs, &dc, &rst, &clock_hz);
+
+  if ((host < 0) || (host >= SPI_HOST_MAX) || (dc < 0) || (clock_hz <= 0)) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "ssd1306: bad SPI host, dc pin or clock");
+  }
+  ssd1306_async_wait(dev);
+  transport_release(&dev->bus);
+  err = transport_spi_init(&dev->bus, host, cs, dc, rst, clock_hz);
+  if (err != ESP_OK) {
+    transport_i2c_init(&dev->bus, I2C_NUM_0, 0x3C);
+    mrb_raisef(mrb, E_RUNTIME_ERROR, "ssd1306: cannot add the SPI device (%S)", mrb_fixnum_value(err));
+  }
+  return self;
+}
+
+// ----- Canvas -----
+
+static void
+canvas_type_free(mrb_state *mrb, void *ptr)
+{
+  canvas_free((tinygrafx_t *)ptr);
+  mrb_free(mrb, ptr);
+}
+
+static const struct mrb_data_type canvas_type = {
+  "canvas_type", canvas_type_free
+};
+
+// OLED::Canvas.new(width, height), cleared
+static mrb_value
+canvas_initialize(mrb_state *mrb, mrb_value self)
+{
+  mrb_int width, height;
+  esp_err_t err;
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  if (tg) {
+    canvas_type_free(mrb, tg);
+    DATA_PTR(self) = NULL;
+  }
+  mrb_get_args(mrb, "ii", &width, &height);
+
+  if ((width <= 0) || (width > CANVAS_MAX_SIZE) || (height <= 0) || (height > CANVAS_MAX_SIZE)) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "Canvas: unsupported size");
+  }
+  tg = (tinygrafx_t *)mrb_malloc(mrb, sizeof(tinygrafx_t));
+  err = canvas_init(tg, width, height);
+  if (err != ESP_OK) {
+    mrb_free(mrb, tg);
+    if (err == ESP_ERR_INVALID_ARG) {
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "Canvas: unsupported size");
+    }
+    mrb_raise(mrb, E_RUNTIME_ERROR, "Canvas: cannot allocate the buffer");
+  }
+  DATA_TYPE(self) = &canvas_type;
+  DATA_PTR(self) = tg;
+  return self;
+}
+
+// _composite(src, x, y, rop, sx, sy, w, h) combines a rectangle of a
+// canvas or of a panel frame buffer with this one
+static mrb_value
+lcd_composite(mrb_state *mrb, mrb_value self)
+{
+  mrb_value src;
+  mrb_int x, y, rop, sx, sy, w, h;
+  tinygrafx_t *tg = (tinygrafx_t *)DATA_PTR(self);
+  tinygrafx_t *from;
+  mrb_get_args(mrb, "oiiiiiii", &src, &x, &y, &rop, &sx, &sy, &w, &h);
+
+  from = (tinygrafx_t *)mrb_data_check_get_ptr(mrb, src, &canvas_type);
+  if (from == NULL) {
+    // ssd1306_t starts with its tinygrafx_t
+    from = (tinygrafx_t *)mrb_data_check_get_ptr(mrb, src, &mrb_spi_config_type);
+  }
+  if (from == NULL) {
+    mrb_raise(mrb, E_TYPE_ERROR, "composite: source must be an OLED::Canvas or a panel");
+  }
+  if ((rop < 0) || (rop >= ROP_TYPES)) {
+    mrb_raisef(mrb, E_ARGUMENT_ERROR, "composite: unknown raster operation %S", mrb_fixnum_value(rop));
+  }
+  if (from->display_buffer == tg->display_buffer) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "composite: cannot draw a frame onto itself");
+  }
+  composite(*tg, x, y, *from, sx, sy, w, h, rop);
+  return self;
+}
+
+// ----- Panel group -----
+
+// Panels on one bus (an I2C port or an SPI host) and the task that sends them
+typedef struct group_bus_t {
+  ssd1306_t *devs[PANEL_GROUP_MAX];
+  int16_t modes[PANEL_GROUP_MAX];
+  int16_t count;
+  TaskHandle_t task;
+  SemaphoreHandle_t start;
+  SemaphoreHandle_t done;
+  volatile esp_err_t err;
+} group_bus_t;
+
+typedef struct panel_group_t {
+  group_bus_t bus[TRANSPORT_BUS_MAX];
+} panel_group_t;
+
+// Bus transfer task, sends the panels of its bus each time start is given
+static void
+group_flush_task(void *arg)
+{
+  group_bus_t *bus = (group_bus_t *)arg;
+
+  while (1) {
+    xSemaphoreTake(bus->start, portMAX_DELAY);
+    bus->err = ssd1306_flush_interleaved(bus->devs, bus->modes, bus->count);
+    if (bus->err != ESP_OK) {
+      ESP_LOGI(TAG, "group_flush_task error: %d", bus->err);
+    }
+    xSemaphoreGive(bus->done);
+  }
+}
+
+// Create the transfer task of a bus on first use
+static esp_err_t
+group_task_init(group_bus_t *bus)
+{
+  if (bus->task != NULL) {
+    return ESP_OK;
+  }
+  if (bus->start == NULL) bus->start = xSemaphoreCreateBinary();
+  if (bus->done == NULL) bus->done = xSemaphoreCreateBinary();
+  if ((bus->start == NULL) || (bus->done == NULL)) {
+    return ESP_ERR_NO_MEM;
+  }
+  if (xTaskCreate(group_flush_task, "group_flush", SSD1306_TASK_STACK, bus,
+                  uxTaskPriorityGet(NULL), &bus->task) != pdPASS) {
+    bus->task = NULL;
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+static void
+panel_group_free(mrb_state *mrb, void *ptr)
+{
+  panel_group_t *grp = ptr;
+
+  for (int16_t id = 0; id < TRANSPORT_BUS_MAX; id++) {
+    group_bus_t *bus = &grp->bus[id];
+    if (bus->task != NULL) vTaskDelete(bus->task);
+    if (bus->start != NULL) vSemaphoreDelete(bus->start);
+    if (bus->done != NULL) vSemaphoreDelete(bus->done);
+  }
+  mrb_free(mrb, grp);
+}
+
+static const struct mrb_data_type panel_group_type = {
+  "panel_group_type", panel_group_free
+};
+
+// Send every panel of the group, returns once all of them are sent.
+// Panels on different buses are sent concurrently, one task per bus.
+// Panels on the same bus are interleaved page by page.
+static mrb_value
+group_display(mrb_state *mrb, mrb_value self)
+{
+  mrb_value panels = mrb_iv_get(mrb, self, mrb_intern_lit(mrb, "@panels"));
+  panel_group_t *grp = (panel_group_t *)DATA_PTR(self);
+  int16_t first = TRANSPORT_BUS_MAX;
+  esp_err_t err = ESP_OK;
+
+  if (grp == NULL) {
+    grp = (panel_group_t *)mrb_malloc(mrb, sizeof(panel_group_t));
+    memset(grp, 0, sizeof(panel_group_t));
+    DATA_TYPE(self) = &panel_group_type;
+    DATA_PTR(self) = grp;
+  }
+  for (int16_t id = 0; id < TRANSPORT_BUS_MAX; id++) {
+    grp->bus[id].count = 0;
+  }
+
+  if (!mrb_array_p(panels)) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "PanelGroup: no panels");
+  }
+  for (mrb_int i = 0; i < RARRAY_LEN(panels); i++) {
+    mrb_value panel = mrb_ary_ref(mrb, panels, i);
+    ssd1306_t *dev = (ssd1306_t *)mrb_data_check_get_ptr(mrb, panel, &mrb_spi_config_type);
+    group_bus_t *bus;
+    int16_t id;
+
+    if (dev == NULL) {
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "PanelGroup: member is not a panel");
+    }
+    ssd1306_load_bus(mrb, panel, dev);
+    id = transport_bus_id(&dev->bus);
+    if ((id < 0) || (id >= TRANSPORT_BUS_MAX)) {
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "PanelGroup: bad bus");
+    }
+    bus = &grp->bus[id];
+    if (bus->count == PANEL_GROUP_MAX) {
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "PanelGroup: too many panels on one bus");
+    }
+    // the panel bus belongs to its own async transfer until it ends
+    ssd1306_async_wait(dev);
+    ssd1306_gray_step(dev);
+    bus->devs[bus->count] = dev;
+    bus->modes[bus->count] = mrb_fixnum(mrb_iv_get(mrb, panel, mrb_intern_lit(mrb, "@flush_mode")));
+    bus->count++;
+  }
+
+  // the first bus in use is sent by the calling task, the others by theirs
+  for (int16_t id = 0; id < TRANSPORT_BUS_MAX; id++) {
+    if (grp->bus[id].count == 0) continue;
+    if (first == TRANSPORT_BUS_MAX) {
+      first = id;
+    }
+    else if (group_task_init(&grp->bus[id]) != ESP_OK) {
+      mrb_raise(mrb, E_RUNTIME_ERROR, "PanelGroup: cannot start the flush task");
+    }
+  }
+  for (int16_t id = first + 1; id < TRANSPORT_BUS_MAX; id++) {
+    if (grp->bus[id].count > 0) xSemaphoreGive(grp->bus[id].start);
+  }
+  if (first < TRANSPORT_BUS_MAX) {
+    err = ssd1306_flush_interleaved(grp->bus[first].devs, grp->bus[first].modes, grp->bus[first].count);
+  }
+  for (int16_t id = first + 1; id < TRANSPORT_BUS_MAX; id++) {
+    if (grp->bus[id].count == 0) continue;
+    xSemaphoreTake(grp->bus[id].done, portMAX_DELAY);
+    if (err == ESP_OK) err = grp->bus[id].err;
+  }
+  if (err != ESP_OK) {
+    ESP_LOGI(TAG, "group_display error: %d", err);
+  }
+
+  return mrb_fixnum_value(err);
+}
+
+// Common graphics methods of the panels and of the canvases, both keep
+// a tinygrafx_t at the start of their data
+static void
+define_graphics_methods(mrb_state *mrb, struct RClass *cls)
+{
+  mrb_define_method(mrb, cls, "clear", lcd_clear, MRB_ARGS_NONE());
+  mrb_define_method(mrb, cls, "set_pixel", lcd_set_pixel, MRB_ARGS_REQ(2));
+  mrb_define_method(mrb, cls, "get_pixel", lcd_get_pixel, MRB_ARGS_REQ(2));
+  mrb_define_method(mrb, cls, "buffer", lcd_buffer, MRB_ARGS_OPT(1));
+  mrb_define_method(mrb, cls, "load_buffer", lcd_load_buffer, MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, cls, "to_pbm", lcd_to_pbm, MRB_ARGS_NONE());
+  mrb_define_method(mrb, cls, "line", lcd_draw_line, MRB_ARGS_REQ(4) | MRB_ARGS_OPT(1));
+  mrb_define_method(mrb, cls, "vline", lcd_draw_vertical_line, MRB_ARGS_REQ(3));
+  mrb_define_method(mrb, cls, "hline", lcd_draw_horizontal_line, MRB_ARGS_REQ(3));
+  mrb_define_method(mrb, cls, "rect", lcd_draw_rect, MRB_ARGS_REQ(4));
+  mrb_define_method(mrb, cls, "fill_rect", lcd_draw_fill_rect, MRB_ARGS_REQ(4));
+  mrb_define_method(mrb, cls, "circle", lcd_draw_circle, MRB_ARGS_REQ(3));
+  mrb_define_method(mrb, cls, "fill_circle", lcd_draw_fill_circle, MRB_ARGS_REQ(3));
+  mrb_define_method(mrb, cls, "ellipse", lcd_draw_ellipse, MRB_ARGS_REQ(4));
+  mrb_define_method(mrb, cls, "fill_ellipse", lcd_draw_fill_ellipse, MRB_ARGS_REQ(4));
+  mrb_define_method(mrb, cls, "arc", lcd_draw_arc, MRB_ARGS_REQ(5) | MRB_ARGS_OPT(1));
+  mrb_define_method(mrb, cls, "pie", lcd_draw_pie, MRB_ARGS_REQ(5));
+  mrb_define_method(mrb, cls, "round_rect", lcd_draw_round_rect, MRB_ARGS_REQ(5));
+  mrb_define_method(mrb, cls, "fill_round_rect", lcd_draw_fill_round_rect, MRB_ARGS_REQ(5));
+  mrb_define_method(mrb, cls, "fill_triangle", lcd_draw_fill_triangle, MRB_ARGS_REQ(6));
+  mrb_define_method(mrb, cls, "_fill_polygon", lcd_draw_fill_polygon, MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, cls, "text", lcd_text, MRB_ARGS_REQ(3) | MRB_ARGS_OPT(1));
+  mrb_define_method(mrb, cls, "_bitmap", lcd_bitmap, MRB_ARGS_REQ(5) | MRB_ARGS_OPT(2));
+  mrb_define_method(mrb, cls, "_gray_image", lcd_gray_image, MRB_ARGS_REQ(6));
+  mrb_define_method(mrb, cls, "scroll", lcd_scroll, MRB_ARGS_REQ(2) | MRB_ARGS_OPT(4));
+  mrb_define_method(mrb, cls, "draw_batch", lcd_draw_batch, MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, cls, "_clip", lcd_clip, MRB_ARGS_REQ(5));
+  mrb_define_method(mrb, cls, "_restore_clip", lcd_restore_clip, MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, cls, "reset_clip", lcd_reset_clip, MRB_ARGS_NONE());
+  mrb_define_method(mrb, cls, "_composite", lcd_composite, MRB_ARGS_REQ(8));
+  mrb_define_method(mrb, cls, "width", lcd_get_width, MRB_ARGS_NONE());
+  mrb_define_method(mrb, cls, "height", lcd_get_height, MRB_ARGS_NONE());
+  mrb_define_method(mrb, cls, "color", lcd_get_color, MRB_ARGS_NONE());
+  mrb_define_method(mrb, cls, "color=", lcd_set_color, MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, cls, "fontsize", lcd_get_fontsize, MRB_ARGS_NONE());
+  mrb_define_method(mrb, cls, "fontsize=", lcd_set_fontsize, MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, cls, "font", lcd_get_font, MRB_ARGS_NONE());
+  mrb_define_method(mrb, cls, "font=", lcd_set_font, MRB_ARGS_REQ(1));
+}
+
+// mrbgem init
+void
+mrb_mruby_esp32_i2c_ssd1306_gem_init(mrb_state* mrb)
+{
+  struct RClass *oled = mrb_define_module(mrb, "OLED");
+  mrb_define_const(mrb, oled, "BLACK", mrb_fixnum_value(BLACK));
+  mrb_define_const(mrb, oled, "WHITE", mrb_fixnum_value(WHITE));
+  mrb_define_const(mrb, oled, "INVERT", mrb_fixnum_value(INVERT));
+  mrb_define_const(mrb, oled, "FLUSH_FULL", mrb_fixnum_value(FLUSH_FULL));
+  mrb_define_const(mrb, oled, "FLUSH_DIRTY", mrb_fixnum_value(FLUSH_DIRTY));
+  mrb_define_const(mrb, oled, "ASYNC_BLOCK", mrb_fixnum_value(ASYNC_BLOCK));
+  mrb_define_const(mrb, oled, "ASYNC_DROP", mrb_fixnum_value(ASYNC_DROP));
+  mrb_define_const(mrb, oled, "CTRL_SSD1306", mrb_fixnum_value(CTRL_SSD1306));
+  mrb_define_const(mrb, oled, "CTRL_SH1106", mrb_fixnum_value(CTRL_SH1106));
+  mrb_define_const(mrb, oled, "SCROLL_RIGHT", mrb_fixnum_value(SCROLL_RIGHT));
+  mrb_define_const(mrb, oled, "SCROLL_LEFT", mrb_fixnum_value(SCROLL_LEFT));
+  mrb_define_const(mrb, oled, "SCROLL_DIAG_RIGHT", mrb_fixnum_value(SCROLL_DIAG_RIGHT));
+  mrb_define_const(mrb, oled, "SCROLL_DIAG_LEFT", mrb_fixnum_value(SCROLL_DIAG_LEFT));
+  mrb_define_const(mrb, oled, "BITMAP_PAGES", mrb_fixnum_value(BITMAP_PAGES));
+  mrb_define_const(mrb, oled, "BITMAP_ROWS", mrb_fixnum_value(BITMAP_ROWS));
+  mrb_define_const(mrb, oled, "ROP_COPY", mrb_fixnum_value(ROP_COPY));
+  mrb_define_const(mrb, oled, "ROP_OR", mrb_fixnum_value(ROP_OR));
+  mrb_define_const(mrb, oled, "ROP_AND", mrb_fixnum_value(ROP_AND));
+  mrb_define_const(mrb, oled, "ROP_XOR", mrb_fixnum_value(ROP_XOR));
+  mrb_define_const(mrb, oled, "ROP_ANDNOT", mrb_fixnum_value(ROP_ANDNOT));
+  mrb_define_const(mrb, oled, "DITHER_THRESHOLD", mrb_fixnum_value(DITHER_THRESHOLD));
+  mrb_define_const(mrb, oled, "DITHER_BAYER", mrb_fixnum_value(DITHER_BAYER));
+  mrb_define_const(mrb, oled, "DITHER_DIFFUSION", mrb_fixnum_value(DITHER_DIFFUSION));
+  mrb_define_const(mrb, oled, "DITHER_TEMPORAL", mrb_fixnum_value(DITHER_TEMPORAL));
+  mrb_define_const(mrb, oled, "BATCH_CLEAR", mrb_fixnum_value(BATCH_CLEAR));
+  mrb_define_const(mrb, oled, "BATCH_PIXEL", mrb_fixnum_value(BATCH_PIXEL));
+  mrb_define_const(mrb, oled, "BATCH_LINE", mrb_fixnum_value(BATCH_LINE));
+  mrb_define_const(mrb, oled, "BATCH_HLINE", mrb_fixnum_value(BATCH_HLINE));
+  mrb_define_const(mrb, oled, "BATCH_VLINE", mrb_fixnum_value(BATCH_VLINE));
+  mrb_define_const(mrb, oled, "BATCH_RECT", mrb_fixnum_value(BATCH_RECT));
+  mrb_define_const(mrb, oled, "BATCH_FILL_RECT", mrb_fixnum_value(BATCH_FILL_RECT));
+  mrb_define_const(mrb, oled, "BATCH_CIRCLE", mrb_fixnum_value(BATCH_CIRCLE));
+  mrb_define_const(mrb, oled, "BATCH_FILL_CIRCLE", mrb_fixnum_value(BATCH_FILL_CIRCLE));
+  mrb_define_const(mrb, oled, "BATCH_TEXT", mrb_fixnum_value(BATCH_TEXT));
+  mrb_define_const(mrb, oled, "BATCH_COLOR", mrb_fixnum_value(BATCH_COLOR));
+  mrb_define_const(mrb, oled, "BATCH_FONTSIZE", mrb_fixnum_value(BATCH_FONTSIZE));
+
+  struct RClass *ssd1306 = mrb_define_class_under(mrb, oled, "SSD1306", mrb->object_class);
+  MRB_SET_INSTANCE_TT(ssd1306, MRB_TT_DATA);
+  
+  // Common graphics methods
+  define_graphics_methods(mrb, ssd1306);
+
+  // Send frame buffer to display
+  mrb_define_method(mrb, ssd1306, "display", ssd1306_display, MRB_ARGS_OPT(1));
+  mrb_define_method(mrb, ssd1306, "display_async", ssd1306_display_async, MRB_ARGS_OPT(1));
+  mrb_define_method(mrb, ssd1306, "wait_flush", ssd1306_wait_flush, MRB_ARGS_NONE());
+
+  // Frame pacing
+  mrb_define_method(mrb, ssd1306, "pace", ssd1306_pace, MRB_ARGS_REQ(1) | MRB_ARGS_OPT(1));
+  mrb_define_method(mrb, ssd1306, "fps", ssd1306_fps, MRB_ARGS_NONE());
+  mrb_define_method(mrb, ssd1306, "dropped_frames", ssd1306_dropped_frames, MRB_ARGS_NONE());
+
+  // Bus use of the flush
+  mrb_define_method(mrb, ssd1306, "bus_config", ssd1306_bus_config, MRB_ARGS_REQ(1) | MRB_ARGS_OPT(1));
+
+  // Performance counters
+  mrb_define_method(mrb, ssd1306, "stats", ssd1306_stats, MRB_ARGS_NONE());
+  mrb_define_method(mrb, ssd1306, "reset_stats", ssd1306_reset_stats, MRB_ARGS_NONE());
+
+  // Panel power
+  mrb_define_method(mrb, ssd1306, "init_panel", ssd1306_init_panel_method, MRB_ARGS_NONE());
+  mrb_define_method(mrb, ssd1306, "sleep", ssd1306_sleep_method, MRB_ARGS_NONE());
+  mrb_define_method(mrb, ssd1306, "wake", ssd1306_wake_method, MRB_ARGS_NONE());
+
+  // Hardware scroll
+  mrb_define_method(mrb, ssd1306, "start_scroll", ssd1306_start_scroll, MRB_ARGS_REQ(1) | MRB_ARGS_OPT(4));
+  mrb_define_method(mrb, ssd1306, "stop_scroll", ssd1306_stop_scroll, MRB_ARGS_NONE());
+
+  // Temporal grayscale
+  mrb_define_method(mrb, ssd1306, "_gray_planes", ssd1306_gray_planes, MRB_ARGS_REQ(6));
+  mrb_define_method(mrb, ssd1306, "stop_gray", ssd1306_stop_gray, MRB_ARGS_NONE());
+
+  // Frame stream playback
+  mrb_define_method(mrb, ssd1306, "_play", ssd1306_play, MRB_ARGS_REQ(5));
+
+  // Retained display list
+  mrb_define_method(mrb, ssd1306, "item", ssd1306_item, MRB_ARGS_REQ(2) | MRB_ARGS_REST());
+  mrb_define_method(mrb, ssd1306, "remove_item", ssd1306_remove_item, MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, ssd1306, "clear_items", ssd1306_clear_items, MRB_ARGS_NONE());
+  mrb_define_method(mrb, ssd1306, "render", ssd1306_render, MRB_ARGS_OPT(1));
+  
+  // Initialize the TINYGRAFX
+  mrb_define_method(mrb, ssd1306, "_init", ssd1306_tinygrafx_init, MRB_ARGS_OPT(5));
+  mrb_define_method(mrb, ssd1306, "_spi", ssd1306_spi, MRB_ARGS_REQ(5));
+
+  // Off-screen canvas
+  struct RClass *canvas = mrb_define_class_under(mrb, oled, "Canvas", mrb->object_class);
+  MRB_SET_INSTANCE_TT(canvas, MRB_TT_DATA);
+  mrb_define_method(mrb, canvas, "initialize", canvas_initialize, MRB_ARGS_REQ(2));
+  define_graphics_methods(mrb, canvas);
+
+  // Panel group
+  struct RClass *group = mrb_define_class_under(mrb, oled, "PanelGroup", mrb->object_class);
+  MRB_SET_INSTANCE_TT(group, MRB_TT_DATA);
+  mrb_define_method(mrb, group, "display", group_display, MRB_ARGS_NONE());
+
+  // PBM / XBM import
+  struct RClass *bitmap = mrb_define_class_under(mrb, oled, "Bitmap", mrb->object_class);
+  mrb_define_class_method(mrb, bitmap, "_pbm", bitmap_pbm, MRB_ARGS_REQ(1));
+  mrb_define_class_method(mrb, bitmap, "_xbm", bitmap_xbm, MRB_ARGS_REQ(1));
+
+  // Proportional fonts
+  struct RClass *font = mrb_define_class_under(mrb, oled, "Font", mrb->object_class);
+  MRB_SET_INSTANCE_TT(font, MRB_TT_DATA);
+  mrb_define_class_method(mrb, font, "[]", font_find, MRB_ARGS_REQ(1));
+  mrb_define_class_method(mrb, font, "names", font_names, MRB_ARGS_NONE());
+  mrb_define_method(mrb, font, "name", font_name, MRB_ARGS_NONE());
+  mrb_define_method(mrb, font, "height", font_height, MRB_ARGS_NONE());
+  mrb_define_method(mrb, font, "width", font_width, MRB_ARGS_REQ(1));
 }
 
 void
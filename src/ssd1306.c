@@ -0,0 +1,748 @@
+// ===================================================================
+//
+//    SSD1306 frame buffer transfer (for esp-idf)
+//
+// ===================================================================
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "esp_timer.h"
+#include "ssd1306.h"
+
+// Run one transaction on the panel transport, the statistics count it,
+// its bus bytes and the time it holds the bus
+static esp_err_t
+ssd1306_transfer(ssd1306_t *dev, const uint8_t *commands, size_t command_length,
+                 const transport_segment_t *segments, int16_t count)
+{
+  size_t bytes = 0;
+#ifdef TINYGRAFX_STATS
+  int64_t start = esp_timer_get_time();
+#endif
+  esp_err_t err = transport_send(&dev->bus, commands, command_length, segments, count, &bytes);
+
+#ifdef TINYGRAFX_STATS
+  tinygrafx_stats_t *stats = dev->tg.stats;
+  if (stats != NULL) {
+    uint32_t us = esp_timer_get_time() - start;
+
+    stats->transactions++;
+    stats->hold_us_total += us;
+    if (us > stats->hold_us_max) stats->hold_us_max = us;
+    if (err == ESP_OK) {
+      stats->bytes += bytes;
+    }
+    else {
+      stats->errors++;
+      if (err == ESP_ERR_TIMEOUT) stats->timeouts++;
+    }
+  }
+#endif
+  return err;
+}
+
+// Configuration the Tiny graphics libraries
+esp_err_t
+tinygrafx_init(tinygrafx_t *tg, uint16_t width, uint16_t height, uint8_t shadow)
+{
+  tg->display_width = width;
+  tg->display_height = height;
+  tg->display_pixel = width * height / 8;
+  tg->display_pages = height / 8;
+  tg->font_width = SSD1306_FONT_WIDTH;
+  tg->font_height = SSD1306_FONT_HEIGHT;
+  tg->color = WHITE;
+  tg->fontsize = 1;
+  tg->font = NULL;
+  clip_reset(tg);
+
+  // set frame buffer
+  tg->display_buffer = (uint8_t *)calloc(tg->display_pixel, 1);
+
+  // dirty column range of each page, everything is dirty at first
+  tg->dirty_x0 = (int16_t *)malloc(sizeof(int16_t) * tg->display_pages * 2);
+  tg->dirty_x1 = tg->dirty_x0 + tg->display_pages;
+
+  // copy of the panel contents, valid after the first full flush
+  tg->shadow_buffer = NULL;
+  tg->shadow_valid = 0;
+  if (shadow) {
+    tg->shadow_buffer = (uint8_t *)malloc(tg->display_pixel);
+  }
+
+#ifdef TINYGRAFX_STATS
+  tg->stats = (tinygrafx_stats_t *)malloc(sizeof(tinygrafx_stats_t));
+  if (tg->stats != NULL) {
+    stats_reset(tg->stats);
+  }
+#endif
+
+  if ((tg->display_buffer == NULL) || (tg->dirty_x0 == NULL) ||
+      (shadow && (tg->shadow_buffer == NULL))) {
+    tinygrafx_free(tg);
+    return ESP_ERR_NO_MEM;
+  }
+  dirty_all(*tg);
+
+  return ESP_OK;
+}
+
+void
+stats_reset(tinygrafx_stats_t *stats)
+{
+  memset(stats, 0, sizeof(tinygrafx_stats_t));
+  stats->flush_us_min = UINT32_MAX;
+}
+
+// Count one flush that took us microseconds
+static void
+stats_flush(tinygrafx_t *tg, int64_t us)
+{
+#ifdef TINYGRAFX_STATS
+  tinygrafx_stats_t *stats = tg->stats;
+  if (stats != NULL) {
+    stats->flushes++;
+    stats->flush_us_total += us;
+    if (us < stats->flush_us_min) stats->flush_us_min = us;
+    if (us > stats->flush_us_max) stats->flush_us_max = us;
+  }
+#endif
+}
+
+// start time of a flush, 0 when the statistics are compiled out
+static inline int64_t
+stats_clock(void)
+{
+#ifdef TINYGRAFX_STATS
+  return esp_timer_get_time();
+#else
+  return 0;
+#endif
+}
+
+void
+tinygrafx_free(tinygrafx_t *tg)
+{
+  free(tg->display_buffer);
+  free(tg->dirty_x0);
+  free(tg->shadow_buffer);
+#ifdef TINYGRAFX_STATS
+  free(tg->stats);
+  tg->stats = NULL;
+#endif
+  tg->display_buffer = NULL;
+  tg->dirty_x0 = NULL;
+  tg->dirty_x1 = NULL;
+  tg->shadow_buffer = NULL;
+}
+
+// Check and keep the panel geometry. A panel narrower than the GDDRAM is
+// wired to its middle columns, column_offset < 0 picks that default.
+esp_err_t
+ssd1306_geometry(ssd1306_t *dev, uint16_t width, uint16_t height, uint8_t controller, int16_t column_offset)
+{
+  int16_t columns = (controller == CTRL_SH1106) ? SH1106_RAM_COLUMNS : SSD1306_RAM_COLUMNS;
+
+  if ((controller > CTRL_SH1106) || (width == 0) || (width > columns) ||
+      (height == 0) || (height > SSD1306_MAX_HEIGHT) || (height % 8 != 0)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (column_offset < 0) {
+    column_offset = (columns - width) / 2;
+  }
+  if (column_offset + width > columns) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  dev->controller = controller;
+  dev->column_offset = column_offset;
+
+  return ESP_OK;
+}
+
+// Split the windows of the flush into transactions of at most chunk_bytes
+// data bytes (0 = one transaction per window). Between two of them the
+// other devices on the bus get their turn. timeout_ms bounds each
+// transaction, 0 = SSD1306_TIMEOUT_MS.
+void
+ssd1306_bus_set(ssd1306_t *dev, uint16_t chunk_bytes, uint32_t timeout_ms)
+{
+  dev->chunk_bytes = chunk_bytes;
+  dev->bus.timeout = (timeout_ms > 0) ? pdMS_TO_TICKS(timeout_ms) : 0;
+  if ((timeout_ms > 0) && (dev->bus.timeout == 0)) {
+    dev->bus.timeout = 1;
+  }
+}
+
+// SH1106 has page addressing only: each page is its own transaction that
+// sets the page and the start column, then streams the data.
+static esp_err_t
+sh1106_send_page(ssd1306_t *dev, tinygrafx_t *tg, int16_t page, int16_t x0, int16_t x1)
+{
+  uint8_t column = x0 + dev->column_offset;
+  uint8_t window[] = {
+    SH1106_SET_PAGE | page,
+    SH1106_SET_COLUMN_LOW | (column & 0x0F),
+    SH1106_SET_COLUMN_HIGH | (column >> 4)
+  };
+  transport_segment_t data = {
+    tg->display_buffer + page * tg->display_width + x0, x1 - x0 + 1
+  };
+
+  return ssd1306_transfer(dev, window, sizeof(window), &data, 1);
+}
+
+// Set the GDDRAM window (COLUMN_ADDR / PAGE_ADDR) and stream the frame
+// buffer bytes inside it, both in one transaction. The data is sent
+// straight from display_buffer, one segment for a full width window or
+// one per page otherwise. Columns are shifted by the column offset of
+// the panel.
+static esp_err_t
+ssd1306_send_chunk(ssd1306_t *dev, tinygrafx_t *tg, int16_t p0, int16_t p1, int16_t x0, int16_t x1)
+{
+  uint8_t window[] = {
+    SSD1306I2C_SET_COLUMN_ADDR, x0 + dev->column_offset, x1 + dev->column_offset,
+    SSD1306I2C_SET_PAGE_ADDR, p0, p1
+  };
+  transport_segment_t data[TRANSPORT_MAX_SEGMENTS];
+  int16_t count = 0;
+
+  if ((x0 == 0) && (x1 == tg->display_width - 1)) {
+    data[count].data = tg->display_buffer + p0 * tg->display_width;
+    data[count++].length = (p1 - p0 + 1) * tg->display_width;
+  }
+  else {
+    for (int16_t page = p0; page <= p1; page++) {
+      data[count].data = tg->display_buffer + page * tg->display_width + x0;
+      data[count++].length = x1 - x0 + 1;
+    }
+  }
+
+  return ssd1306_transfer(dev, window, sizeof(window), data, count);
+}
+
+// Send a window of the frame buffer, in chunks of whole pages or, when a
+// page is more than chunk_bytes, of equal column ranges. Each chunk sets
+// its own window, so the panel does not depend on what came before.
+esp_err_t
+ssd1306_send_window(ssd1306_t *dev, tinygrafx_t *tg, int16_t p0, int16_t p1, int16_t x0, int16_t x1)
+{
+  int16_t width = x1 - x0 + 1;
+  int16_t pages = p1 - p0 + 1;          // pages of a chunk
+  int16_t columns = width;              // columns of a chunk
+  esp_err_t err = ESP_OK;
+
+  if (dev->chunk_bytes > 0) {
+    if (dev->chunk_bytes >= width) {
+      pages = dev->chunk_bytes / width;
+    }
+    else {
+      int16_t parts = (width + dev->chunk_bytes - 1) / dev->chunk_bytes;
+
+      pages = 1;
+      columns = (width + parts - 1) / parts;
+    }
+  }
+  if (dev->controller == CTRL_SH1106) {
+    pages = 1;
+  }
+
+  for (int16_t p = p0; (p <= p1) && (err == ESP_OK); p += pages) {
+    int16_t q = (p + pages - 1 < p1) ? p + pages - 1 : p1;
+
+    for (int16_t x = x0; (x <= x1) && (err == ESP_OK); x += columns) {
+      int16_t xe = (x + columns - 1 < x1) ? x + columns - 1 : x1;
+
+      // let the other tasks waiting for the bus go first
+      if ((dev->chunk_bytes > 0) && ((p > p0) || (x > x0))) {
+        taskYIELD();
+      }
+      if (dev->controller == CTRL_SH1106) {
+        err = sh1106_send_page(dev, tg, p, x, xe);
+      }
+      else {
+        err = ssd1306_send_chunk(dev, tg, p, q, x, xe);
+      }
+    }
+  }
+
+  return err;
+}
+
+// Start a flush that is sent window by window with ssd1306_flush_step.
+// FLUSH_FULL makes every page dirty, FLUSH_DIRTY leaves out what the
+// shadow says the panel already shows.
+void
+ssd1306_flush_begin(ssd1306_flush_t *fl, tinygrafx_t *tg, int16_t flush_mode)
+{
+  fl->tg = tg;
+  fl->page = 0;
+  fl->whole_frame = 1;
+
+  if (flush_mode != FLUSH_DIRTY) {
+    dirty_all(*tg);
+  }
+  // the shadow becomes valid once the whole frame has been sent
+  for (int16_t p = 0; p < tg->display_pages; p++) {
+    if ((tg->dirty_x0[p] != 0) || (tg->dirty_x1[p] != tg->display_width - 1)) {
+      fl->whole_frame = 0;
+    }
+  }
+  if (flush_mode == FLUSH_DIRTY) {
+    dirty_trim(*tg);
+  }
+}
+
+// Send the next dirty window, at most max_pages pages high. Neighbouring
+// dirty pages are merged into one window when the extra bytes cost less
+// than another transaction. Returns ESP_ERR_NOT_FOUND when nothing is
+// left to send.
+esp_err_t
+ssd1306_flush_step(ssd1306_t *dev, ssd1306_flush_t *fl, int16_t max_pages)
+{
+  tinygrafx_t *tg = fl->tg;
+  int16_t page = fl->page;
+  esp_err_t err;
+
+  while ((page < tg->display_pages) && (tg->dirty_x0[page] > tg->dirty_x1[page])) {
+    page++;
+  }
+  fl->page = page;
+  if (page >= tg->display_pages) {
+    if (fl->whole_frame && (tg->shadow_buffer != NULL)) {
+      tg->shadow_valid = 1;
+    }
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  int16_t p0 = page;
+  int16_t x0 = tg->dirty_x0[page];
+  int16_t x1 = tg->dirty_x1[page];
+  int16_t bytes = x1 - x0 + 1;
+
+  while ((page + 1 < tg->display_pages) && (page + 1 - p0 < max_pages) &&
+         (tg->dirty_x0[page + 1] <= tg->dirty_x1[page + 1])) {
+    int16_t nx0 = (tg->dirty_x0[page + 1] < x0) ? tg->dirty_x0[page + 1] : x0;
+    int16_t nx1 = (tg->dirty_x1[page + 1] > x1) ? tg->dirty_x1[page + 1] : x1;
+    int16_t merged = (page + 2 - p0) * (nx1 - nx0 + 1);
+    int16_t separate = bytes + (tg->dirty_x1[page + 1] - tg->dirty_x0[page + 1] + 1) + SSD1306_WINDOW_OVERHEAD;
+
+    // SH1106 sends one transaction per page anyway, merging only adds bytes
+    if ((merged > separate) || (dev->controller == CTRL_SH1106)) break;
+    page++;
+    x0 = nx0;
+    x1 = nx1;
+    bytes = merged;
+  }
+
+  err = ssd1306_send_window(dev, tg, p0, page, x0, x1);
+  if (err != ESP_OK) {
+    return err;
+  }
+  for (int16_t p = p0; p <= page; p++) {
+    shadow_update(*tg, p, x0, x1);
+    tg->dirty_x0[p] = tg->display_width;
+    tg->dirty_x1[p] = -1;
+  }
+  fl->page = page + 1;
+
+  return ESP_OK;
+}
+
+// Send only the dirty windows
+esp_err_t
+ssd1306_flush_dirty(ssd1306_t *dev, tinygrafx_t *tg)
+{
+  ssd1306_flush_t fl;
+  esp_err_t err;
+
+  ssd1306_flush_begin(&fl, tg, FLUSH_DIRTY);
+  do {
+    err = ssd1306_flush_step(dev, &fl, tg->display_pages);
+  } while (err == ESP_OK);
+
+  return (err == ESP_ERR_NOT_FOUND) ? ESP_OK : err;
+}
+
+esp_err_t
+ssd1306_flush_full(ssd1306_t *dev, tinygrafx_t *tg)
+{
+  esp_err_t err;
+
+  err = ssd1306_send_window(dev, tg, 0, tg->display_pages - 1, 0, tg->display_width - 1);
+  if (err == ESP_OK) {
+    if (tg->shadow_buffer != NULL) {
+      memcpy(tg->shadow_buffer, tg->display_buffer, tg->display_pixel);
+      tg->shadow_valid = 1;
+    }
+    dirty_clean(*tg);
+  }
+
+  return err;
+}
+
+esp_err_t
+ssd1306_flush(ssd1306_t *dev, tinygrafx_t *tg, int16_t flush_mode)
+{
+  int64_t start = stats_clock();
+  esp_err_t err;
+
+  if (flush_mode == FLUSH_DIRTY) {
+    err = ssd1306_flush_dirty(dev, tg);
+  }
+  else {
+    err = ssd1306_flush_full(dev, tg);
+  }
+  stats_flush(tg, stats_clock() - start);
+
+  return err;
+}
+
+// Flush several panels that share one bus. One page of each panel is sent
+// in turn, so no panel waits a whole frame behind another. Every panel is
+// sent even when another one fails, the first error is returned.
+esp_err_t
+ssd1306_flush_interleaved(ssd1306_t **devs, const int16_t *modes, int16_t count)
+{
+  ssd1306_flush_t fl[count];
+  uint8_t active[count];
+  int16_t remaining = count;
+  esp_err_t result = ESP_OK;
+  int64_t start = stats_clock();
+
+  for (int16_t i = 0; i < count; i++) {
+    ssd1306_flush_begin(&fl[i], &devs[i]->tg, modes[i]);
+    active[i] = 1;
+  }
+  while (remaining > 0) {
+    for (int16_t i = 0; i < count; i++) {
+      esp_err_t err;
+
+      if (!active[i]) continue;
+      err = ssd1306_flush_step(devs[i], &fl[i], 1);
+      if (err != ESP_OK) {
+        // the latency of a panel is the time until its last window
+        stats_flush(&devs[i]->tg, stats_clock() - start);
+        active[i] = 0;
+        remaining--;
+        if ((err != ESP_ERR_NOT_FOUND) && (result == ESP_OK)) result = err;
+      }
+    }
+  }
+
+  return result;
+}
+
+// Pace display to fps frames per second, 0 = no pacing. With bus_load
+// (1..100) the period grows while the average flush takes more than
+// bus_load % of it, so the bus stays free for other devices.
+void
+ssd1306_pace_set(ssd1306_pace_t *pace, uint16_t fps, uint8_t bus_load)
+{
+  memset(pace, 0, sizeof(ssd1306_pace_t));
+  if (fps > 0) {
+    pace->period_us = 1000000 / fps;
+    pace->current_us = pace->period_us;
+    pace->bus_load = (bus_load > 100) ? 100 : bus_load;
+  }
+}
+
+// Decide what happens to the frame displayed at now_us
+uint8_t
+ssd1306_pace_frame(ssd1306_pace_t *pace, tinygrafx_t *tg, int64_t now_us)
+{
+  uint8_t dirty = 0;
+
+  for (int16_t page = 0; page < tg->display_pages; page++) {
+    if (tg->dirty_x0[page] <= tg->dirty_x1[page]) {
+      dirty = 1;
+      break;
+    }
+  }
+  if (!dirty) {
+    pace->skipped++;
+    return PACE_IDLE;
+  }
+  if ((pace->sent > 0) && (now_us - pace->last_us < pace->current_us)) {
+    pace->dropped++;
+    return PACE_MERGE;
+  }
+  return PACE_SEND;
+}
+
+// Account a frame sent from start_us to end_us
+void
+ssd1306_pace_sent(ssd1306_pace_t *pace, int64_t start_us, int64_t end_us)
+{
+  uint32_t us = end_us - start_us;
+
+  // running average over about 8 frames
+  if (pace->sent == 0) {
+    pace->flush_us = us;
+  }
+  else {
+    pace->flush_us = pace->flush_us - pace->flush_us / 8 + us / 8;
+  }
+  // the next frame is due one period after this one was due, so the
+  // average rate holds; after a stall the schedule restarts from now
+  if ((pace->sent > 0) && (start_us - pace->last_us < 2 * (int64_t)pace->current_us)) {
+    pace->last_us += pace->current_us;
+  }
+  else {
+    pace->last_us = start_us;
+  }
+  pace->sent++;
+
+  if (pace->bus_load > 0) {
+    uint32_t needed = (uint64_t)pace->flush_us * 100 / pace->bus_load;
+    pace->current_us = (needed > pace->period_us) ? needed : pace->period_us;
+  }
+}
+
+// Temporal grayscale
+//
+// The image is dithered once into count Bayer bitplanes whose thresholds
+// are spread over 0..255, and each frame sent carries the next plane. The
+// panel shows the average, count + 1 gray levels per pixel on top of the
+// spatial dithering. Only the image rectangle changes, so FLUSH_DIRTY
+// sends a partial update of it at a high pace.
+//
+
+// Dither the image (moved by the viewport, clipped) into the planes and
+// show the first one
+esp_err_t
+ssd1306_gray_start(ssd1306_t *dev, int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *gray, int16_t planes)
+{
+  ssd1306_gray_t *g = &dev->gray;
+  tinygrafx_clip_t clip = dev->tg.clip;
+  int16_t x0, y0, x1, y1;
+  esp_err_t err;
+
+  STATS_CALL(dev->tg, STAT_GRAY_IMAGE);
+  ssd1306_gray_stop(dev);
+  if ((planes < 2) || (planes > GRAY_MAX_PLANES)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  x += clip.origin_x;
+  y += clip.origin_y;
+  x0 = (x > clip.x0) ? x : clip.x0;
+  y0 = (y > clip.y0) ? y : clip.y0;
+  x1 = ((int32_t)x + w < clip.x1) ? x + w : clip.x1;
+  y1 = ((int32_t)y + h < clip.y1) ? y + h : clip.y1;
+  if ((x0 >= x1) || (y0 >= y1)) {
+    return ESP_OK;
+  }
+
+  // the planes hold the visible part only
+  for (int16_t k = 0; k < planes; k++) {
+    err = canvas_init(&g->planes[k], x1 - x0, y1 - y0);
+    if (err != ESP_OK) {
+      while (--k >= 0) canvas_free(&g->planes[k]);
+      return err;
+    }
+    gray_image(g->planes[k], x - x0, y - y0, w, h, gray, DITHER_BAYER, k * 256 / planes);
+  }
+  g->count = planes;
+  g->next = 0;
+  g->x = x0;
+  g->y = y0;
+  ssd1306_gray_step(dev);
+  return ESP_OK;
+}
+
+// The image rectangle changes with every frame
+void
+ssd1306_gray_mark(ssd1306_t *dev)
+{
+  ssd1306_gray_t *g = &dev->gray;
+
+  if (g->count == 0) return;
+  dirty_mark(dev->tg, g->x, g->y, g->x + g->planes[0].display_width - 1, g->y + g->planes[0].display_height - 1);
+}
+
+// Copy the next plane into the frame, outside of the clip and viewport
+// of the drawing
+void
+ssd1306_gray_step(ssd1306_t *dev)
+{
+  ssd1306_gray_t *g = &dev->gray;
+  tinygrafx_t tg = dev->tg;
+  tinygrafx_t *plane = &g->planes[g->next];
+
+  if (g->count == 0) return;
+  clip_reset(&tg);
+#ifdef TINYGRAFX_STATS
+  tg.stats = NULL;
+#endif
+  composite(tg, g->x, g->y, *plane, 0, 0, plane->display_width, plane->display_height, ROP_COPY);
+  g->next = (g->next + 1) % g->count;
+}
+
+// Stop cycling, the frame keeps the plane shown last
+void
+ssd1306_gray_stop(ssd1306_t *dev)
+{
+  ssd1306_gray_t *g = &dev->gray;
+
+  for (int16_t k = 0; k < g->count; k++) {
+    canvas_free(&g->planes[k]);
+  }
+  g->count = 0;
+  g->next = 0;
+}
+
+// Send command bytes in one transaction (CMDSTREAM on I2C)
+esp_err_t
+ssd1306_command(ssd1306_t *dev, const uint8_t *command, size_t length)
+{
+  return ssd1306_transfer(dev, command, length, NULL, 0);
+}
+
+// Configure the panel for its geometry and turn it on. The whole sequence
+// goes out as one command transaction. GDDRAM is not cleared, so the
+// whole frame becomes dirty.
+esp_err_t
+ssd1306_init_panel(ssd1306_t *dev)
+{
+  tinygrafx_t *tg = &dev->tg;
+  uint8_t command[32];
+  size_t length = 0;
+  esp_err_t err;
+
+  command[length++] = SSD1306I2C_DISPLAY_OFF;
+  command[length++] = SSD1306I2C_MUX_RATIO;
+  command[length++] = tg->display_height - 1;
+  command[length++] = SSD1306I2C_SET_DISPLAY_OFFSET;
+  command[length++] = 0x00;
+  command[length++] = SSD1306I2C_SET_DISPLAY_START_LINE;
+  command[length++] = SSD1306I2C_REMAP;
+  command[length++] = SSD1306I2C_SCAN_DIRECTION;
+  // sequential COM pins on the wide, low panels (128x32, 96x16)
+  command[length++] = SSD1306I2C_SET_COM_PINS;
+  command[length++] = ((tg->display_height <= 32) && (tg->display_width >= 96)) ? 0x02 : 0x12;
+  command[length++] = SSD1306I2C_SET_CONTRAST;
+  command[length++] = 0x7F;
+  command[length++] = SSD1306I2C_RESUME_RAM_CONTENT_DISPLAY;
+  command[length++] = SSD1306I2C_SET_OSC_FREQUENCY;
+  command[length++] = 0x00;
+
+  if (dev->controller == CTRL_SH1106) {
+    // page addressing only, the flush sets page and column itself
+    command[length++] = SH1106_SET_DCDC;
+    command[length++] = 0x8B;
+  }
+  else {
+    command[length++] = SSD1306I2C_DEACTIVATE_SCROLL;
+    command[length++] = SSD1306I2C_SET_CHARGE_PUMP;
+    command[length++] = 0x14;
+    command[length++] = SSD1306I2C_SET_MEMORY_ADDR_MODE;
+    command[length++] = 0x00;
+    command[length++] = SSD1306I2C_SET_COLUMN_ADDR;
+    command[length++] = dev->column_offset;
+    command[length++] = dev->column_offset + tg->display_width - 1;
+    command[length++] = SSD1306I2C_SET_PAGE_ADDR;
+    command[length++] = 0;
+    command[length++] = tg->display_pages - 1;
+  }
+  command[length++] = SSD1306I2C_DISPLAY_ON;
+
+  err = ssd1306_command(dev, command, length);
+  tg->shadow_valid = 0;
+  dirty_all(*tg);
+
+  return err;
+}
+
+// Turn the panel off, GDDRAM keeps its contents
+esp_err_t
+ssd1306_sleep(ssd1306_t *dev)
+{
+  uint8_t command[] = { SSD1306I2C_DISPLAY_OFF };
+
+  return ssd1306_command(dev, command, sizeof(command));
+}
+
+// Turn the panel on again, showing what GDDRAM held when it went to sleep
+esp_err_t
+ssd1306_wake(ssd1306_t *dev)
+{
+  uint8_t command[] = { SSD1306I2C_DISPLAY_ON };
+
+  return ssd1306_command(dev, command, sizeof(command));
+}
+
+// Scroll step interval in frames, index is the command code
+static const int16_t scroll_frames[8] = { 5, 64, 128, 256, 3, 4, 25, 2 };
+
+// Start the continuous hardware scroll of pages start_page..end_page,
+// one step every (about) frames frames. The diagonal directions also move
+// the whole screen up by offset rows per step.
+// SH1106 has no scroll commands.
+esp_err_t
+ssd1306_scroll_start(ssd1306_t *dev, int16_t direction, int16_t start_page, int16_t end_page,
+                     int16_t frames, int16_t offset)
+{
+  uint8_t interval = 0;
+  uint8_t pages = dev->tg.display_pages;
+  uint8_t command[12];
+  size_t length = 0;
+
+  if (dev->controller == CTRL_SH1106) {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+  if ((direction < SCROLL_RIGHT) || (direction > SCROLL_DIAG_LEFT) ||
+      (start_page < 0) || (end_page >= pages) || (start_page > end_page) || (offset < 0)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  // closest supported interval
+  for (uint8_t code = 1; code < 8; code++) {
+    if (abs(scroll_frames[code] - frames) < abs(scroll_frames[interval] - frames)) {
+      interval = code;
+    }
+  }
+
+  // the scroll must be stopped before it is set up again
+  command[length++] = SSD1306I2C_DEACTIVATE_SCROLL;
+  if (direction <= SCROLL_LEFT) {
+    command[length++] = (direction == SCROLL_RIGHT) ? SSD1306I2C_RIGHT_HORIZONTAL_SCROLL
+                                                     : SSD1306I2C_LEFT_HORIZONTAL_SCROLL;
+    command[length++] = 0x00;
+    command[length++] = start_page;
+    command[length++] = interval;
+    command[length++] = end_page;
+    command[length++] = 0x00;
+    command[length++] = 0xFF;
+  }
+  else {
+    // the vertical part scrolls the whole screen
+    command[length++] = SSD1306I2C_SET_VERTICAL_SCROLL_AREA;
+    command[length++] = 0;
+    command[length++] = dev->tg.display_height;
+    command[length++] = (direction == SCROLL_DIAG_RIGHT) ? SSD1306I2C_VERTICAL_RIGHT_SCROLL
+                                                         : SSD1306I2C_VERTICAL_LEFT_SCROLL;
+    command[length++] = 0x00;
+    command[length++] = start_page;
+    command[length++] = interval;
+    command[length++] = end_page;
+    command[length++] = offset % dev->tg.display_height;
+  }
+  command[length++] = SSD1306I2C_ACTIVATE_SCROLL;
+
+  return ssd1306_command(dev, command, length);
+}
+
+// Stop the hardware scroll. The panel RAM must be written again after
+// that, so the whole frame becomes dirty.
+esp_err_t
+ssd1306_scroll_stop(ssd1306_t *dev)
+{
+  uint8_t command[] = { SSD1306I2C_DEACTIVATE_SCROLL };
+  esp_err_t err;
+
+  err = ssd1306_command(dev, command, sizeof(command));
+  dev->tg.shadow_valid = 0;
+  dirty_all(dev->tg);
+
+  return err;
+}
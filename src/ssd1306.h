@@ -0,0 +1,184 @@
+#ifndef SSD1306H_
+#define SSD1306H_
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+
+#include "tiny_grafx.h"
+#include "display_list.h"
+#include "transport.h"
+
+// SSD1306 addressing commands used by the flush
+#define SSD1306I2C_SET_COLUMN_ADDR             0x21    // 0x00 = start, 0x7f = end
+#define SSD1306I2C_SET_PAGE_ADDR               0x22    // 0x00 = start, 0x07 = end
+
+// SSD1306 scrolling commands
+#define SSD1306I2C_RIGHT_HORIZONTAL_SCROLL     0x26
+#define SSD1306I2C_LEFT_HORIZONTAL_SCROLL      0x27
+#define SSD1306I2C_VERTICAL_RIGHT_SCROLL       0x29
+#define SSD1306I2C_VERTICAL_LEFT_SCROLL        0x2A
+#define SSD1306I2C_DEACTIVATE_SCROLL           0x2E
+#define SSD1306I2C_ACTIVATE_SCROLL             0x2F
+#define SSD1306I2C_SET_VERTICAL_SCROLL_AREA    0xA3    // fixed rows, scrolled rows
+
+// SSD1306 configuration commands used by the init
+// Fundamental Commands 
+#define SSD1306I2C_SET_CONTRAST                0x81    // 0x7F = default
+#define SSD1306I2C_RESUME_RAM_CONTENT_DISPLAY  0xA4
+#define SSD1306I2C_DISPLAY_OFF                 0xAE
+#define SSD1306I2C_DISPLAY_ON                  0xAF
+// Addressing Setting Commands
+#define SSD1306I2C_SET_MEMORY_ADDR_MODE        0x20    // 0x00 = Horizontal Mode
+// Hardware Configuration
+#define SSD1306I2C_SET_DISPLAY_START_LINE      0x40    // start line is 0d
+#define SSD1306I2C_REMAP                       0xA1    // SEG0 is mapped to column address 127
+#define SSD1306I2C_MUX_RATIO                   0xA8    // 0x3F = 64d -1d
+#define SSD1306I2C_SCAN_DIRECTION              0xC8    // SCAN_DIRECTION, reverse up-bottom
+#define SSD1306I2C_SET_DISPLAY_OFFSET          0xD3    // 0x00 = no offset
+#define SSD1306I2C_SET_COM_PINS                0xDA    // 0x12 = Alternative configuration, Disable L/R remap
+#define SSD1306I2C_SET_OSC_FREQUENCY           0xd5    // 0x00
+// Charge Pump Command
+#define SSD1306I2C_SET_CHARGE_PUMP             0x8D    // 0x14 = enable charge pump
+// SH1106 DC-DC converter (instead of the charge pump)
+#define SH1106_SET_DCDC                        0xAD    // 0x8B = DC-DC on
+
+// SH1106 addressing commands (page addressing only)
+#define SH1106_SET_PAGE                        0xB0    // + page
+#define SH1106_SET_COLUMN_LOW                  0x00    // + low nibble
+#define SH1106_SET_COLUMN_HIGH                 0x10    // + high nibble
+
+// SSD1306 display config, the default geometry
+#define SSD1306_DISPLAY_WIDTH   128
+#define SSD1306_DISPLAY_HEIGHT  64
+#define SSD1306_DISPLAY_PIXEL   1024
+#define SSD1306_FONT_WIDTH      8
+#define SSD1306_FONT_HEIGHT     8
+
+// controller
+#define CTRL_SSD1306            0
+#define CTRL_SH1106             1
+
+// GDDRAM columns of each controller, a narrower panel is centered
+#define SSD1306_RAM_COLUMNS     128
+#define SH1106_RAM_COLUMNS      132
+#define SSD1306_MAX_HEIGHT      64
+
+// flush mode
+#define FLUSH_FULL              0       // send the whole frame buffer
+#define FLUSH_DIRTY             1       // send only the dirty windows
+
+// hardware scroll direction
+#define SCROLL_RIGHT            0
+#define SCROLL_LEFT             1
+#define SCROLL_DIAG_RIGHT       2       // right and up
+#define SCROLL_DIAG_LEFT        3       // left and up
+
+// time a transaction may wait for the bus and take, unless set by
+// ssd1306_bus_set
+#define SSD1306_TIMEOUT_MS      TRANSPORT_TIMEOUT_MS
+
+// I2C cost of one more window (start, address, addressing commands, stop)
+// counted in data bytes
+#define SSD1306_WINDOW_OVERHEAD 16
+
+// frame pacing result
+#define PACE_SEND               0       // send the frame now
+#define PACE_MERGE              1       // too early, merged into the next frame
+#define PACE_IDLE               2       // nothing dirty, nothing to send
+
+// Frame pacing of display. The frames drawn faster than the target rate
+// stay dirty and go out with the next frame that is due.
+typedef struct ssd1306_pace_t {
+  uint32_t period_us;         // target frame period, 0 = no pacing
+  uint32_t current_us;        // period in use, longer when adaptive slows down
+  uint8_t bus_load;           // adaptive: % of the period a flush may take, 0 = off
+  int64_t last_us;            // time the last frame sent was due
+  uint32_t flush_us;          // running average of the flush time
+  uint32_t sent;
+  uint32_t dropped;           // merged into a later frame
+  uint32_t skipped;           // nothing to send
+} ssd1306_pace_t;
+
+// temporal grayscale: bitplanes shown in turn, one per frame sent
+#define DITHER_TEMPORAL         3       // gray_image mode of the panels
+#define GRAY_MAX_PLANES         4
+
+typedef struct ssd1306_gray_t {
+  tinygrafx_t planes[GRAY_MAX_PLANES];
+  int16_t count;              // planes in use, 0 = off
+  int16_t next;               // plane of the next frame
+  int16_t x, y;               // frame position of the planes, already clipped
+} ssd1306_gray_t;
+
+// progress of a flush sent window by window
+typedef struct ssd1306_flush_t {
+  tinygrafx_t *tg;
+  int16_t page;               // next page to look at
+  uint8_t whole_frame;        // every column is sent, the shadow becomes valid
+} ssd1306_flush_t;
+
+// SSD1306 driver state, tinygrafx_t must be the first member so the
+// mruby graphics bindings can use DATA_PTR as a tinygrafx_t.
+typedef struct ssd1306_t {
+  tinygrafx_t tg;
+  transport_t bus;            // I2C or SPI, see transport.h
+  uint8_t controller;         // CTRL_SSD1306 or CTRL_SH1106
+  uint8_t column_offset;      // GDDRAM column of frame buffer column 0
+  uint16_t chunk_bytes;       // most data bytes per transaction, 0 = whole windows
+
+  // display_async: snapshot of the frame and its transfer task
+  tinygrafx_t back;
+  int16_t back_mode;
+  TaskHandle_t flush_task;
+  SemaphoreHandle_t flush_start;
+  SemaphoreHandle_t flush_done;
+  volatile esp_err_t flush_err;
+
+  // retained items drawn by render
+  display_list_t list;
+
+  ssd1306_pace_t pace;
+  ssd1306_gray_t gray;
+} ssd1306_t;
+
+// frame buffer
+esp_err_t tinygrafx_init(tinygrafx_t *tg, uint16_t width, uint16_t height, uint8_t shadow);
+void tinygrafx_free(tinygrafx_t *tg);
+void stats_reset(tinygrafx_stats_t *stats);
+
+// panel geometry
+esp_err_t ssd1306_geometry(ssd1306_t *dev, uint16_t width, uint16_t height, uint8_t controller, int16_t column_offset);
+
+// send the frame buffer to the panel
+void ssd1306_bus_set(ssd1306_t *dev, uint16_t chunk_bytes, uint32_t timeout_ms);
+esp_err_t ssd1306_send_window(ssd1306_t *dev, tinygrafx_t *tg, int16_t p0, int16_t p1, int16_t x0, int16_t x1);
+esp_err_t ssd1306_flush_dirty(ssd1306_t *dev, tinygrafx_t *tg);
+esp_err_t ssd1306_flush_full(ssd1306_t *dev, tinygrafx_t *tg);
+esp_err_t ssd1306_flush(ssd1306_t *dev, tinygrafx_t *tg, int16_t flush_mode);
+void ssd1306_flush_begin(ssd1306_flush_t *fl, tinygrafx_t *tg, int16_t flush_mode);
+esp_err_t ssd1306_flush_step(ssd1306_t *dev, ssd1306_flush_t *fl, int16_t max_pages);
+esp_err_t ssd1306_flush_interleaved(ssd1306_t **devs, const int16_t *modes, int16_t count);
+
+// frame pacing
+void ssd1306_pace_set(ssd1306_pace_t *pace, uint16_t fps, uint8_t bus_load);
+uint8_t ssd1306_pace_frame(ssd1306_pace_t *pace, tinygrafx_t *tg, int64_t now_us);
+void ssd1306_pace_sent(ssd1306_pace_t *pace, int64_t start_us, int64_t end_us);
+
+// temporal grayscale
+esp_err_t ssd1306_gray_start(ssd1306_t *dev, int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *gray, int16_t planes);
+void ssd1306_gray_mark(ssd1306_t *dev);
+void ssd1306_gray_step(ssd1306_t *dev);
+void ssd1306_gray_stop(ssd1306_t *dev);
+
+// panel commands
+esp_err_t ssd1306_command(ssd1306_t *dev, const uint8_t *command, size_t length);
+esp_err_t ssd1306_init_panel(ssd1306_t *dev);
+esp_err_t ssd1306_sleep(ssd1306_t *dev);
+esp_err_t ssd1306_wake(ssd1306_t *dev);
+esp_err_t ssd1306_scroll_start(ssd1306_t *dev, int16_t direction, int16_t start_page, int16_t end_page,
+                               int16_t frames, int16_t offset);
+esp_err_t ssd1306_scroll_stop(ssd1306_t *dev);
+
+#endif /* SSD1306H_ */
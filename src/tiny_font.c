@@ -0,0 +1,164 @@
+// ===================================================================
+//
+//    Proportional fonts for the Tiny graphics libraries
+//
+// ===================================================================
+//
+// Look-ups in the const font tables made by host/bdf2font. The glyphs
+// are drawn by display_text in tiny_grafx.c.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "tiny_font.h"
+
+// fonts compiled in, see README.md to add one
+extern const tinyfont_t tinyfont_prop8;
+
+const tinyfont_t *const tinyfont_builtin[] = {
+  &tinyfont_prop8,
+  NULL
+};
+
+const tinyfont_t *
+tinyfont_find(const char *name)
+{
+  for (int16_t i = 0; tinyfont_builtin[i] != NULL; i++) {
+    if (strcmp(tinyfont_builtin[i]->name, name) == 0) {
+      return tinyfont_builtin[i];
+    }
+  }
+  return NULL;
+}
+
+// Decode the code point at text[*i] and move *i past it. A malformed or
+// truncated sequence gives U+FFFD and skips one byte.
+uint32_t
+utf8_next(const uint8_t *text, int16_t length, int16_t *i)
+{
+  uint8_t c = text[(*i)++];
+  uint32_t code;
+  int16_t more;
+
+  if (c < 0x80) return c;
+  if ((c & 0xE0) == 0xC0) {
+    code = c & 0x1F;
+    more = 1;
+  }
+  else if ((c & 0xF0) == 0xE0) {
+    code = c & 0x0F;
+    more = 2;
+  }
+  else if ((c & 0xF8) == 0xF0) {
+    code = c & 0x07;
+    more = 3;
+  }
+  else {
+    return 0xFFFD;
+  }
+  if (*i + more > length) return 0xFFFD;
+  for (int16_t n = 0; n < more; n++) {
+    if ((text[*i + n] & 0xC0) != 0x80) return 0xFFFD;
+    code = (code << 6) | (text[*i + n] & 0x3F);
+  }
+  *i += more;
+  return code;
+}
+
+// Glyph of a code point, the default glyph when the font does not have it
+uint16_t
+tinyfont_glyph(const tinyfont_t *font, uint32_t code)
+{
+  int16_t lo = 0;
+  int16_t hi = font->range_count - 1;
+
+  while (lo <= hi) {
+    int16_t mid = (lo + hi) / 2;
+    const tinyfont_range_t *range = &font->ranges[mid];
+
+    if (code < range->first) {
+      hi = mid - 1;
+    }
+    else if (code >= range->first + range->count) {
+      lo = mid + 1;
+    }
+    else {
+      return range->glyph + (code - range->first);
+    }
+  }
+  return font->default_glyph;
+}
+
+int8_t
+tinyfont_kerning(const tinyfont_t *font, uint16_t left, uint16_t right)
+{
+  uint32_t key = ((uint32_t)left << 16) | right;
+  int16_t lo = 0;
+  int16_t hi = font->kern_count - 1;
+
+  while (lo <= hi) {
+    int16_t mid = (lo + hi) / 2;
+    const tinyfont_kern_t *kern = &font->kerns[mid];
+    uint32_t k = ((uint32_t)kern->left << 16) | kern->right;
+
+    if (key < k) {
+      hi = mid - 1;
+    }
+    else if (key > k) {
+      lo = mid + 1;
+    }
+    else {
+      return kern->adjust;
+    }
+  }
+  return 0;
+}
+
+// Columns x0..x1 covered by the glyphs of text drawn from x, and the
+// number of lines. Same walk as display_text: a new line starts at x = 0.
+void
+tinyfont_extent(const tinyfont_t *font, int16_t x, const uint8_t *text, int16_t length,
+                int16_t *x0, int16_t *x1, int16_t *lines)
+{
+  uint16_t prev = TINYFONT_NONE;
+  int16_t i = 0;
+
+  *x0 = 0;
+  *x1 = -1;
+  *lines = 1;
+  while (i < length) {
+    uint32_t code = utf8_next(text, length, &i);
+    uint16_t g;
+    const tinyfont_glyph_t *glyph;
+
+    if (code == '\n') {
+      x = 0;
+      (*lines)++;
+      prev = TINYFONT_NONE;
+      continue;
+    }
+    g = tinyfont_glyph(font, code);
+    if (g == TINYFONT_NONE) continue;
+    if (prev != TINYFONT_NONE) {
+      x += tinyfont_kerning(font, prev, g);
+    }
+    glyph = &font->glyphs[g];
+    if (glyph->width > 0) {
+      int16_t g0 = x + glyph->left;
+      int16_t g1 = g0 + glyph->width - 1;
+
+      if (*x0 > *x1) {
+        *x0 = g0;
+        *x1 = g1;
+      }
+      else {
+        if (g0 < *x0) *x0 = g0;
+        if (g1 > *x1) *x1 = g1;
+      }
+    }
+    x += glyph->advance;
+    prev = g;
+  }
+}
@@ -0,0 +1,68 @@
+#ifndef TINYFONTH_
+#define TINYFONTH_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Proportional bitmap fonts
+//
+// A font is const data, so it stays in flash and costs no RAM. The files
+// are made by host/bdf2font from BDF fonts, with only the code points that
+// are needed (digits, Latin-1, the characters of a UTF-8 string...).
+//
+// Every glyph bitmap is font height rows high and width columns wide, in
+// page-ordered columns like the frame buffer: bits[page * width + col],
+// bit 0 at the top. The glyph is drawn at pen + left and the pen moves by
+// advance, plus the kerning of the next pair.
+//
+// Code points are found through ranges sorted by first code point. Each
+// range maps count code points to consecutive glyphs. Kerning pairs are
+// sorted by left then right glyph.
+
+// no glyph, nothing is drawn for a missing code point
+#define TINYFONT_NONE           0xFFFF
+
+typedef struct tinyfont_glyph_t {
+  uint32_t offset;            // first byte in bitmaps
+  uint8_t width;              // bitmap columns, 0 for a blank glyph
+  uint8_t advance;            // pen advance
+  int8_t left;                // bitmap column 0 relative to the pen
+} tinyfont_glyph_t;
+
+typedef struct tinyfont_range_t {
+  uint32_t first;             // first code point
+  uint16_t count;             // code points in the range
+  uint16_t glyph;             // glyph of the first code point
+} tinyfont_range_t;
+
+typedef struct tinyfont_kern_t {
+  uint16_t left;              // glyph on the left
+  uint16_t right;             // glyph on the right
+  int8_t adjust;              // added to the advance of left
+} tinyfont_kern_t;
+
+typedef struct tinyfont_t {
+  const char *name;
+  uint8_t height;             // rows of every glyph
+  uint8_t baseline;           // rows above the baseline
+  uint16_t default_glyph;     // drawn for missing code points (TINYFONT_NONE = skip)
+  uint16_t glyph_count;
+  uint16_t range_count;
+  uint16_t kern_count;
+  const tinyfont_range_t *ranges;
+  const tinyfont_glyph_t *glyphs;
+  const tinyfont_kern_t *kerns;
+  const uint8_t *bitmaps;
+} tinyfont_t;
+
+// fonts compiled in, NULL terminated
+extern const tinyfont_t *const tinyfont_builtin[];
+
+const tinyfont_t *tinyfont_find(const char *name);
+uint32_t utf8_next(const uint8_t *text, int16_t length, int16_t *i);
+uint16_t tinyfont_glyph(const tinyfont_t *font, uint32_t code);
+int8_t tinyfont_kerning(const tinyfont_t *font, uint16_t left, uint16_t right);
+void tinyfont_extent(const tinyfont_t *font, int16_t x, const uint8_t *text, int16_t length,
+                     int16_t *x0, int16_t *x1, int16_t *lines);
+
+#endif /* TINYFONTH_ */
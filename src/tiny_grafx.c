@@ -34,6 +34,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include "esp_err.h"
 #include "esp_log.h"
 static const char *TAG = "TINY_GRAFX";
@@ -51,43 +52,243 @@ static const char *TAG = "TINY_GRAFX";
 //
 
 
+// Dirty region tracking
+//
+// Each page (8 pixel rows) keeps the column range that was written since
+// the last flush, so the flush only has to send those windows.
+//
+static inline void
+dirty_mark_column(tinygrafx_t tg, int16_t x, int16_t page)
+{
+  if (x < tg.dirty_x0[page]) tg.dirty_x0[page] = x;
+  if (x > tg.dirty_x1[page]) tg.dirty_x1[page] = x;
+}
+
+void
+dirty_mark(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t x1, int16_t y1)
+{
+  if (x0 > x1) swap_int16_t(x0, x1);
+  if (y0 > y1) swap_int16_t(y0, y1);
+  if (x0 < 0) x0 = 0;
+  if (y0 < 0) y0 = 0;
+  if (x1 >= tg.display_width) x1 = tg.display_width - 1;
+  if (y1 >= tg.display_height) y1 = tg.display_height - 1;
+  if ((x0 > x1) || (y0 > y1)) return;
+
+  for (int16_t page = y0 / 8; page <= y1 / 8; page++) {
+    dirty_mark_column(tg, x0, page);
+    dirty_mark_column(tg, x1, page);
+  }
+}
+
+void
+dirty_all(tinygrafx_t tg)
+{
+  for (int16_t page = 0; page < tg.display_pages; page++) {
+    tg.dirty_x0[page] = 0;
+    tg.dirty_x1[page] = tg.display_width - 1;
+  }
+}
+
+void
+dirty_clean(tinygrafx_t tg)
+{
+  for (int16_t page = 0; page < tg.display_pages; page++) {
+    tg.dirty_x0[page] = tg.display_width;
+    tg.dirty_x1[page] = -1;
+  }
+}
+
+// Narrow the dirty ranges to the bytes that differ from the shadow copy.
+// Returns the number of pages that are still dirty.
+int16_t
+dirty_trim(tinygrafx_t tg)
+{
+  int16_t pages = 0;
+
+  for (int16_t page = 0; page < tg.display_pages; page++) {
+    int16_t x0 = tg.dirty_x0[page];
+    int16_t x1 = tg.dirty_x1[page];
+    if (x0 > x1) continue;
+
+    if ((tg.shadow_buffer != NULL) && tg.shadow_valid) {
+      uint8_t *buf = tg.display_buffer + page * tg.display_width;
+      uint8_t *shadow = tg.shadow_buffer + page * tg.display_width;
+      while ((x0 <= x1) && (buf[x0] == shadow[x0])) x0++;
+      while ((x1 >= x0) && (buf[x1] == shadow[x1])) x1--;
+      if (x0 > x1) {
+        x0 = tg.display_width;
+        x1 = -1;
+      }
+      tg.dirty_x0[page] = x0;
+      tg.dirty_x1[page] = x1;
+    }
+    if (x0 <= x1) pages++;
+  }
+  return pages;
+}
+
+// Record that columns x0..x1 of the page have been sent to the panel.
+void
+shadow_update(tinygrafx_t tg, int16_t page, int16_t x0, int16_t x1)
+{
+  if (tg.shadow_buffer == NULL) return;
+
+  int16_t offset = page * tg.display_width + x0;
+  memcpy(tg.shadow_buffer + offset, tg.display_buffer + offset, x1 - x0 + 1);
+}
+
+// Clip rectangle and viewport
+//
+// The primitives add the viewport origin to their coordinates once, then
+// intersect their bounds with the clip rectangle up front, so the inner
+// loops run without bounds checks.
+//
+void
+clip_reset(tinygrafx_t *tg)
+{
+  tg->clip.x0 = 0;
+  tg->clip.y0 = 0;
+  tg->clip.x1 = tg->display_width;
+  tg->clip.y1 = tg->display_height;
+  tg->clip.origin_x = 0;
+  tg->clip.origin_y = 0;
+}
+
+void
+clip_set(tinygrafx_t *tg, int16_t x, int16_t y, int16_t w, int16_t h)
+{
+  int32_t x0 = (int32_t)x + tg->clip.origin_x;
+  int32_t y0 = (int32_t)y + tg->clip.origin_y;
+  int32_t x1 = x0 + ((w > 0) ? w : 0);
+  int32_t y1 = y0 + ((h > 0) ? h : 0);
+
+  if (x0 < tg->clip.x0) x0 = tg->clip.x0;
+  if (y0 < tg->clip.y0) y0 = tg->clip.y0;
+  if (x1 > tg->clip.x1) x1 = tg->clip.x1;
+  if (y1 > tg->clip.y1) y1 = tg->clip.y1;
+  // an empty clip keeps x0 >= x1 or y0 >= y1, nothing is drawn. It stays
+  // inside the frame, so a saved clip state is always in bounds.
+  if (x0 > tg->clip.x1) x0 = tg->clip.x1;
+  if (y0 > tg->clip.y1) y0 = tg->clip.y1;
+  if (x1 < x0) x1 = x0;
+  if (y1 < y0) y1 = y0;
+
+  tg->clip.x0 = x0;
+  tg->clip.y0 = y0;
+  tg->clip.x1 = x1;
+  tg->clip.y1 = y1;
+}
+
+// Clip to the rectangle and make its top left corner the origin
+void
+viewport_set(tinygrafx_t *tg, int16_t x, int16_t y, int16_t w, int16_t h)
+{
+  clip_set(tg, x, y, w, h);
+  tg->clip.origin_x += x;
+  tg->clip.origin_y += y;
+}
+
+static inline uint8_t
+clip_full(tinygrafx_t tg)
+{
+  return (tg.clip.x0 == 0) && (tg.clip.y0 == 0) &&
+         (tg.clip.x1 == tg.display_width) && (tg.clip.y1 == tg.display_height);
+}
+
+// Rows of the page inside the clip rectangle, as a bit mask
+static inline uint8_t
+clip_page_mask(tinygrafx_t tg, int16_t page)
+{
+  int16_t y0 = page * 8;
+  int16_t y1 = y0 + 8;
+
+  if (y0 < tg.clip.y0) y0 = tg.clip.y0;
+  if (y1 > tg.clip.y1) y1 = tg.clip.y1;
+  if (y0 >= y1) return 0;
+  return (0xFF << (y0 & 7)) & (0xFF >> (8 - (y1 - page * 8)));
+}
+
+static void fill_rect(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, int16_t color);
+
+// Clear the frame buffer, or only the clip rectangle when one is set
 void 
 buffer_clear(tinygrafx_t tg) 
 {
+  STATS_CALL(tg, STAT_CLEAR);
+  if (!clip_full(tg)) {
+    fill_rect(tg, tg.clip.x0, tg.clip.y0, tg.clip.x1 - tg.clip.x0, tg.clip.y1 - tg.clip.y0, BLACK);
+    return;
+  }
+  STATS_PIXELS(tg, tg.display_pixel * 8);
   memset(tg.display_buffer, 0x00, tg.display_pixel);
+  dirty_all(tg);
 }
 
 void 
-buffer_read(tinygrafx_t tg, uint8_t *data, int16_t size) 
+buffer_read(tinygrafx_t tg, uint8_t *data, uint16_t size) 
 {
   if (data == NULL) {
     ESP_LOGI(TAG, "buffer_read: data NULL error");
   }
-  if (size == tg.display_pixel) {
-    for (int16_t i=0; i<tg.display_pixel; i++) {
-      data[i] = tg.display_buffer[i];
-    }
+  else if (size == tg.display_pixel) {
+    memcpy(data, tg.display_buffer, tg.display_pixel);
   }
   else {
     ESP_LOGI(TAG, "buffer_read: data size mismatch => %d", size);
   }
 }
 
+// Load a whole frame in frame buffer order, the clip does not apply
+void
+buffer_write(tinygrafx_t tg, const uint8_t *data, uint16_t size)
+{
+  if (data == NULL) {
+    ESP_LOGI(TAG, "buffer_write: data NULL error");
+  }
+  else if (size == tg.display_pixel) {
+    memcpy(tg.display_buffer, data, tg.display_pixel);
+    dirty_all(tg);
+  }
+  else {
+    ESP_LOGI(TAG, "buffer_write: data size mismatch => %d", size);
+  }
+}
+
+// Write a pixel known to be inside the clip rectangle
+static inline void
+plot_unclipped(tinygrafx_t tg, int16_t x, int16_t y, uint16_t color)
+{
+  switch (color) {
+    case WHITE: tg.display_buffer[x + (y / 8) * tg.display_width] |=  (1 << (y & 7)); break;
+    case BLACK: tg.display_buffer[x + (y / 8) * tg.display_width] &= ~(1 << (y & 7)); break;
+    case INVERT:tg.display_buffer[x + (y / 8) * tg.display_width] ^=  (1 << (y & 7)); break;
+    default: return;
+  }
+  STATS_PIXELS(tg, 1);
+  dirty_mark_column(tg, x, y / 8);
+}
+
+static inline void
+plot(tinygrafx_t tg, int16_t x, int16_t y, uint16_t color)
+{
+  if ((x >= tg.clip.x0) && (x < tg.clip.x1) && (y >= tg.clip.y0) && (y < tg.clip.y1)) {
+    plot_unclipped(tg, x, y, color);
+  } 
+}
+
 void 
 set_pixel(tinygrafx_t tg, int16_t x, int16_t y, uint16_t color) 
 {
-  if ((x >= 0) && (x < tg.display_width) && (y >= 0) && (y < tg.display_height)) {
-    switch (color) {
-      case WHITE: tg.display_buffer[x + (y / 8) * tg.display_width] |=  (1 << (y & 7)); break;
-      case BLACK: tg.display_buffer[x + (y / 8) * tg.display_width] &= ~(1 << (y & 7)); break;
-      case INVERT:tg.display_buffer[x + (y / 8) * tg.display_width] ^=  (1 << (y & 7)); break;
-    }
-  } 
+  STATS_CALL(tg, STAT_PIXEL);
+  plot(tg, x + tg.clip.origin_x, y + tg.clip.origin_y, color);
 }
 
 int16_t 
 get_pixel(tinygrafx_t tg, int16_t x, int16_t y) 
 {
+  x += tg.clip.origin_x;
+  y += tg.clip.origin_y;
   if ((x >= 0) && (x < tg.display_width) && (y >= 0) && (y < tg.display_height)) {
     return (tg.display_buffer[x + (y / 8) * tg.display_width] >> (y % 8)) & 0x1;
   }
@@ -96,197 +297,1844 @@ get_pixel(tinygrafx_t tg, int16_t x, int16_t y)
   }
 }
 
-void 
-draw_line(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t color) 
+// Span kernels
+//
+// The frame buffer is organised in pages: one byte holds 8 vertical
+// pixels of a column. A horizontal span is one bit mask applied to a run
+// of bytes, a vertical span is a head mask, whole bytes and a tail mask.
+//
+
+// Clip a rectangle to the clip rectangle. Returns 0 if nothing is left.
+static inline uint8_t
+clip_rect(tinygrafx_t tg, int16_t *x, int16_t *y, int16_t *w, int16_t *h)
 {
-  int16_t steep = abs(y1 - y0) > abs(x1 - x0);
+  int32_t x0 = *x, y0 = *y;
+  int32_t x1 = x0 + *w, y1 = y0 + *h;
 
-  if (steep) {
-    swap_int16_t(x0, y0);
-    swap_int16_t(x1, y1);
+  if (x0 < tg.clip.x0) x0 = tg.clip.x0;
+  if (y0 < tg.clip.y0) y0 = tg.clip.y0;
+  if (x1 > tg.clip.x1) x1 = tg.clip.x1;
+  if (y1 > tg.clip.y1) y1 = tg.clip.y1;
+  if ((x0 >= x1) || (y0 >= y1)) return 0;
+
+  *x = x0;
+  *y = y0;
+  *w = x1 - x0;
+  *h = y1 - y0;
+  return 1;
+}
+
+#ifdef TINYGRAFX_STATS
+static const uint8_t nibble_bits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+#endif
+
+// Apply the bit mask to w bytes of one page, starting at column x.
+// The span must already be clipped.
+static void
+fill_page_span(tinygrafx_t tg, int16_t page, int16_t x, int16_t w, uint8_t mask, int16_t color)
+{
+  uint8_t *p = tg.display_buffer + page * tg.display_width + x;
+  uint8_t *end = p + w;
+
+  switch (color) {
+    case WHITE:
+      if (mask == 0xFF) {
+        memset(p, 0xFF, w);
+      }
+      else {
+        for (; p < end; p++) *p |= mask;
+      }
+      break;
+    case BLACK:
+      if (mask == 0xFF) {
+        memset(p, 0x00, w);
+      }
+      else {
+        mask = ~mask;
+        for (; p < end; p++) *p &= mask;
+      }
+      break;
+    case INVERT:
+      for (; p < end; p++) *p ^= mask;
+      break;
+    default:
+      return;
   }
-  if (x0 > x1) {
-    swap_int16_t(x0, x1);
-    swap_int16_t(y0, y1);
+  STATS_PIXELS(tg, w * (nibble_bits[mask & 0x0F] + nibble_bits[mask >> 4]));
+  dirty_mark_column(tg, x, page);
+  dirty_mark_column(tg, x + w - 1, page);
+}
+
+// Fill a clipped rectangle page by page.
+static void
+fill_span_rect(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, int16_t color)
+{
+  int16_t y1 = y + h - 1;
+  int16_t page0 = y / 8;
+  int16_t page1 = y1 / 8;
+  uint8_t head = 0xFF << (y & 7);
+  uint8_t tail = 0xFF >> (7 - (y1 & 7));
+
+  if (page0 == page1) {
+    fill_page_span(tg, page0, x, w, head & tail, color);
+    return;
+  }
+  fill_page_span(tg, page0, x, w, head, color);
+  for (int16_t page = page0 + 1; page < page1; page++) {
+    fill_page_span(tg, page, x, w, 0xFF, color);
+  }
+  fill_page_span(tg, page1, x, w, tail, color);
+}
+
+// Unclipped rectangles and lines for the primitives built from them
+static void
+fill_rect(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, int16_t color)
+{
+  if (clip_rect(tg, &x, &y, &w, &h)) {
+    fill_span_rect(tg, x, y, w, h, color);
+  }
+}
+
+static void
+hline(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t color)
+{
+  int16_t h = 1;
+
+  if (clip_rect(tg, &x, &y, &w, &h)) {
+    fill_page_span(tg, y / 8, x, w, 1 << (y & 7), color);
   }
+}
 
-  int16_t dx = x1 - x0;
-  int16_t dy = abs(y1 - y0);
-  int16_t err = dx / 2;
-  int16_t ystep;
+static void
+vline(tinygrafx_t tg, int16_t x, int16_t y, int16_t h, int16_t color)
+{
+  int16_t w = 1;
 
-  if (y0 < y1) {
-    ystep = 1;
+  if (clip_rect(tg, &x, &y, &w, &h)) {
+    fill_span_rect(tg, x, y, w, h, color);
   }
-  else {
-    ystep = -1;
+}
+
+// Draw a page-ordered 1bpp bitmap at any (x, y). bits[page * w + col]
+// holds 8 vertical pixels with bit 0 at the top, like the frame buffer.
+// Only the set bits are drawn; at a sub-page y each source byte is
+// shifted and merged into two destination pages.
+static void
+bitmap_pages(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *bits, int16_t color)
+{
+  uint8_t set, flip;
+  int16_t shift = y & 7;
+  int16_t page0 = (y - shift) / 8;
+  int16_t pages = (h + 7) / 8;
+  uint8_t last = (h & 7) ? (0xFF >> (8 - (h & 7))) : 0xFF;
+  int16_t c0 = (x < tg.clip.x0) ? tg.clip.x0 - x : 0;
+  int16_t c1 = (x + w > tg.clip.x1) ? tg.clip.x1 - x : w;
+
+  if ((c0 >= c1) || (h <= 0)) return;
+
+  // WHITE sets the bits, BLACK sets and flips them, INVERT flips them
+  switch (color) {
+    case WHITE:  set = 0xFF; flip = 0x00; break;
+    case BLACK:  set = 0xFF; flip = 0xFF; break;
+    case INVERT: set = 0x00; flip = 0xFF; break;
+    default: return;
   }
+  STATS_PIXELS(tg, (c1 - c0) * h);
 
-  for (; x0 <= x1; x0++) {
-    if (steep) {
-      set_pixel(tg, y0, x0, color);
+  for (int16_t p = 0; p < pages; p++) {
+    const uint8_t *src = bits + p * w;
+    uint8_t mask = (p == pages - 1) ? last : 0xFF;
+    int16_t lo = page0 + p;
+    int16_t hi = lo + 1;
+    uint8_t clip_lo = ((lo >= 0) && (lo < tg.display_pages)) ? clip_page_mask(tg, lo) : 0;
+    uint8_t clip_hi = (shift && (hi >= 0) && (hi < tg.display_pages)) ? clip_page_mask(tg, hi) : 0;
+    uint8_t *dst_lo = clip_lo ? tg.display_buffer + lo * tg.display_width + x : NULL;
+    uint8_t *dst_hi = clip_hi ? tg.display_buffer + hi * tg.display_width + x : NULL;
+
+    if (dst_lo != NULL) {
+      for (int16_t c = c0; c < c1; c++) {
+        uint8_t v = (uint8_t)((src[c] & mask) << shift) & clip_lo;
+        dst_lo[c] = (dst_lo[c] | (v & set)) ^ (v & flip);
+      }
+      dirty_mark_column(tg, x + c0, lo);
+      dirty_mark_column(tg, x + c1 - 1, lo);
     }
-    else {
-      set_pixel(tg, x0, y0, color);
+    if (dst_hi != NULL) {
+      for (int16_t c = c0; c < c1; c++) {
+        uint8_t v = ((src[c] & mask) >> (8 - shift)) & clip_hi;
+        dst_hi[c] = (dst_hi[c] | (v & set)) ^ (v & flip);
+      }
+      dirty_mark_column(tg, x + c0, hi);
+      dirty_mark_column(tg, x + c1 - 1, hi);
+    }
+  }
+}
+
+void
+draw_bitmap(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *bits, int16_t color)
+{
+  STATS_CALL(tg, STAT_BITMAP);
+  bitmap_pages(tg, x + tg.clip.origin_x, y + tg.clip.origin_y, w, h, bits, color);
+}
+
+// Gather up to 8 rows of a row-ordered bitmap (MSB first, stride bytes
+// per row) into page-ordered columns c0..c1-1. Each 8x8 block is
+// transposed at once in a 64 bit word.
+static void
+rows_to_page(const uint8_t *rows, int16_t stride, int16_t h, int16_t page, int16_t c0, int16_t c1, uint8_t *out)
+{
+  int16_t y0 = page * 8;
+  int16_t n = (h - y0 < 8) ? h - y0 : 8;
+
+  for (int16_t g = c0 >> 3; g <= (c1 - 1) >> 3; g++) {
+    uint64_t t, x = 0;
+
+    // row i in byte i, so column j comes out in byte 7 - j with row i at bit i
+    for (int16_t i = 0; i < n; i++) {
+      x |= (uint64_t)rows[(y0 + i) * stride + g] << (8 * i);
     }
-    err -= dy;
-    if (err < 0) {
-      y0 += ystep;
-      err += dx;
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+    x = x ^ t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+    x = x ^ t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+    x = x ^ t ^ (t << 28);
+
+    for (int16_t j = 0; j < 8; j++) {
+      int16_t c = g * 8 + j;
+      if ((c >= c0) && (c < c1)) {
+        out[c - c0] = (uint8_t)(x >> (8 * (7 - j)));
+      }
     }
   }
 }
 
-void 
-draw_vertical_line(tinygrafx_t tg, int16_t x, int16_t y, int16_t h, int16_t color) 
+// Draw a 1bpp bitmap in either layout at any (x, y). Without a mask only
+// the set bits are drawn. With a mask (same layout and size as the
+// bitmap) every pixel under a set mask bit is written: WHITE copies the
+// bitmap, BLACK copies it inverted and INVERT flips the set bits.
+void
+blit(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *bits, const uint8_t *mask, uint8_t format, int16_t color)
 {
-  if (y < 0) {
-    h += y;
-    y = 0;
+  uint8_t keep, inv;
+  int16_t shift, page0, c0, c1;
+  int16_t pages = (h + 7) / 8;
+  int16_t stride = (w + 7) / 8;
+  uint8_t last = (h & 7) ? (0xFF >> (8 - (h & 7))) : 0xFF;
+
+  STATS_CALL(tg, STAT_BITMAP);
+  x += tg.clip.origin_x;
+  y += tg.clip.origin_y;
+  shift = y & 7;
+  page0 = (y - shift) / 8;
+  c0 = (x < tg.clip.x0) ? tg.clip.x0 - x : 0;
+  c1 = (x + w > tg.clip.x1) ? tg.clip.x1 - x : w;
+  if ((format == BITMAP_PAGES) && (mask == NULL)) {
+    bitmap_pages(tg, x, y, w, h, bits, color);
+    return;
   }
+  if ((c0 >= c1) || (h <= 0)) return;
 
-  if ((y + h) > tg.display_height) {
-    h = tg.display_height - y; 
+  // d = (d & ~(m & keep)) ^ ((v ^ inv) & m), m is the mask or the bitmap
+  switch (color) {
+    case WHITE:  keep = 0xFF; inv = 0x00; break;
+    case BLACK:  keep = 0xFF; inv = 0xFF; break;
+    case INVERT: keep = 0x00; inv = 0x00; break;
+    default: return;
   }
+  STATS_PIXELS(tg, (c1 - c0) * h);
+
+  uint8_t src_strip[c1 - c0];
+  uint8_t mask_strip[c1 - c0];
 
-  if (h <= 0) return;
-  
-  for (int16_t h1 = 0; h1 < h; h1++) {
-    set_pixel(tg, x, y + h1, color);
+  for (int16_t p = 0; p < pages; p++) {
+    const uint8_t *src, *msk;
+    uint8_t pm = (p == pages - 1) ? last : 0xFF;
+    int16_t lo = page0 + p;
+    int16_t hi = lo + 1;
+    uint8_t clip_lo = ((lo >= 0) && (lo < tg.display_pages)) ? clip_page_mask(tg, lo) : 0;
+    uint8_t clip_hi = (shift && (hi >= 0) && (hi < tg.display_pages)) ? clip_page_mask(tg, hi) : 0;
+    uint8_t *dst_lo = clip_lo ? tg.display_buffer + lo * tg.display_width + x + c0 : NULL;
+    uint8_t *dst_hi = clip_hi ? tg.display_buffer + hi * tg.display_width + x + c0 : NULL;
+
+    if ((dst_lo == NULL) && (dst_hi == NULL)) continue;
+
+    if (format == BITMAP_PAGES) {
+      src = bits + p * w + c0;
+      msk = (mask != NULL) ? mask + p * w + c0 : src;
+    }
+    else {
+      rows_to_page(bits, stride, h, p, c0, c1, src_strip);
+      src = src_strip;
+      msk = src_strip;
+      if (mask != NULL) {
+        rows_to_page(mask, stride, h, p, c0, c1, mask_strip);
+        msk = mask_strip;
+      }
+    }
+
+    if (dst_lo != NULL) {
+      for (int16_t c = 0; c < c1 - c0; c++) {
+        uint8_t v = (uint8_t)(src[c] << shift);
+        uint8_t m = (uint8_t)((msk[c] & pm) << shift) & clip_lo;
+        dst_lo[c] = (dst_lo[c] & ~(m & keep)) ^ ((v ^ inv) & m);
+      }
+      dirty_mark_column(tg, x + c0, lo);
+      dirty_mark_column(tg, x + c1 - 1, lo);
+    }
+    if (dst_hi != NULL) {
+      for (int16_t c = 0; c < c1 - c0; c++) {
+        uint8_t v = src[c] >> (8 - shift);
+        uint8_t m = ((msk[c] & pm) >> (8 - shift)) & clip_hi;
+        dst_hi[c] = (dst_hi[c] & ~(m & keep)) ^ ((v ^ inv) & m);
+      }
+      dirty_mark_column(tg, x + c0, hi);
+      dirty_mark_column(tg, x + c1 - 1, hi);
+    }
   }
 }
 
-void 
-draw_horizontal_line(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t color) 
+// Canvases and compositing
+//
+// A canvas is a tinygrafx_t with its own page-ordered buffer, so every
+// primitive draws on it. composite combines a rectangle of it with the
+// target byte by byte. When the rows line up on a page boundary a copy is
+// a memcpy per page (one memcpy for whole-width pages); otherwise each
+// page of the target gathers its 8 rows from two source pages first.
+//
+esp_err_t
+canvas_init(tinygrafx_t *tg, int16_t width, int16_t height)
 {
-  if (x < 0) {
-    w += x;
-    x = 0;
-  }
+  int16_t pages = (height + 7) / 8;
 
-  if ((x + w) > tg.display_width) {
-    w = tg.display_width - x; 
+  memset(tg, 0, sizeof(tinygrafx_t));
+  if ((width <= 0) || (height <= 0) || (width > CANVAS_MAX_SIZE) || (height > CANVAS_MAX_SIZE) ||
+      ((int32_t)width * pages > UINT16_MAX)) {
+    return ESP_ERR_INVALID_ARG;
   }
+  tg->display_width = width;
+  tg->display_height = height;
+  tg->display_pages = pages;
+  tg->display_pixel = width * pages;
+  tg->font_width = 8;
+  tg->font_height = 8;
+  tg->color = WHITE;
+  tg->fontsize = 1;
+  clip_reset(tg);
 
-  if (w <= 0) return;
-  
-  for (int16_t w1 = 0; w1 < w; w1++) {
-    set_pixel(tg, x + w1, y, color);
+  tg->display_buffer = (uint8_t *)calloc(tg->display_pixel, 1);
+  tg->dirty_x0 = (int16_t *)malloc(sizeof(int16_t) * pages * 2);
+  if ((tg->display_buffer == NULL) || (tg->dirty_x0 == NULL)) {
+    canvas_free(tg);
+    return ESP_ERR_NO_MEM;
   }
+  tg->dirty_x1 = tg->dirty_x0 + pages;
+  dirty_clean(*tg);
+  return ESP_OK;
 }
 
-void 
-draw_rect(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, int16_t color) 
+void
+canvas_free(tinygrafx_t *tg)
 {
-  draw_horizontal_line(tg, x, y, w, color);
-  draw_horizontal_line(tg, x, y + h - 1, w, color);
-  draw_vertical_line(tg, x, y, h, color);
-  draw_vertical_line(tg, x + w - 1, y, h, color);
+  free(tg->display_buffer);
+  free(tg->dirty_x0);
+  tg->display_buffer = NULL;
+  tg->dirty_x0 = NULL;
+  tg->dirty_x1 = NULL;
 }
 
-void 
-draw_fill_rect(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, int16_t color) 
+// Combine the source rectangle (sx, sy, w, h) with the target at (x, y).
+// The target viewport and clip apply, the source is clipped to its frame.
+void
+composite(tinygrafx_t tg, int16_t x, int16_t y, tinygrafx_t src, int16_t sx, int16_t sy, int16_t w, int16_t h, uint8_t rop)
 {
-  for (int16_t w1 = 0; w1 < w; w1++) {
-    draw_vertical_line(tg, x + w1, y, h, color);
+  int16_t x0, y0, d, page0, page1;
+
+  STATS_CALL(tg, STAT_COMPOSITE);
+  if (rop >= ROP_TYPES) return;
+  x += tg.clip.origin_x;
+  y += tg.clip.origin_y;
+
+  // source rectangle inside the source frame
+  if (sx < 0) {
+    x -= sx;
+    w += sx;
+    sx = 0;
+  }
+  if (sy < 0) {
+    y -= sy;
+    h += sy;
+    sy = 0;
+  }
+  if (w > src.display_width - sx) w = src.display_width - sx;
+  if (h > src.display_height - sy) h = src.display_height - sy;
+  if ((w <= 0) || (h <= 0)) return;
+
+  // then inside the target clip
+  x0 = x;
+  y0 = y;
+  if (!clip_rect(tg, &x, &y, &w, &h)) return;
+  sx += x - x0;
+  sy += y - y0;
+  STATS_PIXELS(tg, w * h);
+
+  d = sy - y;                   // source row of a target row is row + d
+  page0 = y / 8;
+  page1 = (y + h - 1) / 8;
+
+  // whole pages of the same width: one copy
+  if ((rop == ROP_COPY) && ((y & 7) == 0) && ((h & 7) == 0) && ((d & 7) == 0) &&
+      (x == 0) && (sx == 0) && (w == tg.display_width) && (w == src.display_width)) {
+    memcpy(tg.display_buffer + page0 * w, src.display_buffer + (sy / 8) * w, (h / 8) * w);
+    for (int16_t page = page0; page <= page1; page++) {
+      dirty_mark_column(tg, 0, page);
+      dirty_mark_column(tg, w - 1, page);
+    }
+    return;
+  }
+
+  uint8_t strip[w];
+
+  for (int16_t page = page0; page <= page1; page++) {
+    int16_t r0 = (page * 8 > y) ? page * 8 : y;
+    int16_t r1 = (page * 8 + 8 < y + h) ? page * 8 + 8 : y + h;
+    uint8_t mask = (0xFF << (r0 & 7)) & (0xFF >> (page * 8 + 8 - r1));
+    int16_t row = page * 8 + d;           // source row of the first bit
+    int16_t shift = row & 7;
+    int16_t q = (row - shift) / 8;        // source page, row may be negative
+    uint8_t *dst = tg.display_buffer + page * tg.display_width + x;
+    const uint8_t *s;
+
+    if (shift == 0) {
+      s = src.display_buffer + q * src.display_width + sx;
+    }
+    else {
+      // the rows outside the mask may come from beyond the source
+      const uint8_t *lo = ((q >= 0) && (q < src.display_pages)) ? src.display_buffer + q * src.display_width + sx : NULL;
+      const uint8_t *hi = (q + 1 < src.display_pages) ? src.display_buffer + (q + 1) * src.display_width + sx : NULL;
+
+      for (int16_t c = 0; c < w; c++) {
+        strip[c] = (uint8_t)(((lo != NULL) ? lo[c] >> shift : 0) | ((hi != NULL) ? hi[c] << (8 - shift) : 0));
+      }
+      s = strip;
+    }
+
+    switch (rop) {
+      case ROP_COPY:
+        if (mask == 0xFF) {
+          memcpy(dst, s, w);
+        }
+        else {
+          for (int16_t c = 0; c < w; c++) dst[c] = (dst[c] & ~mask) | (s[c] & mask);
+        }
+        break;
+      case ROP_OR:
+        for (int16_t c = 0; c < w; c++) dst[c] |= s[c] & mask;
+        break;
+      case ROP_AND:
+        for (int16_t c = 0; c < w; c++) dst[c] &= s[c] | ~mask;
+        break;
+      case ROP_XOR:
+        for (int16_t c = 0; c < w; c++) dst[c] ^= s[c] & mask;
+        break;
+      case ROP_ANDNOT:
+        for (int16_t c = 0; c < w; c++) dst[c] &= ~(s[c] & mask);
+        break;
+    }
+    dirty_mark_column(tg, x, page);
+    dirty_mark_column(tg, x + w - 1, page);
   }
 }
 
-void 
-draw_circle(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t r, int16_t color) 
+// Grayscale images
+//
+// gray holds w * h bytes row by row, 0 is black and 255 white. Rows are
+// dithered into a strip of bits that replaces the visible rows of a page
+// once the page is complete. Bayer thresholds are anchored to the frame,
+// so the tiles of a large image match up. Error diffusion (Floyd-Steinberg)
+// always starts at the first row of the image, so the visible part does
+// not change with the clip.
+//
+static const uint8_t bayer8[8][8] = {
+  {  0, 32,  8, 40,  2, 34, 10, 42 },
+  { 48, 16, 56, 24, 50, 18, 58, 26 },
+  { 12, 44,  4, 36, 14, 46,  6, 38 },
+  { 60, 28, 52, 20, 62, 30, 54, 22 },
+  {  3, 35, 11, 43,  1, 33,  9, 41 },
+  { 51, 19, 59, 27, 49, 17, 57, 25 },
+  { 15, 47,  7, 39, 13, 45,  5, 37 },
+  { 63, 31, 55, 23, 61, 29, 53, 21 },
+};
+
+// phase is added to the Bayer thresholds, modulo 256. Planes with phases
+// spread over 0..255 average to the gray level.
+void
+gray_image(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *gray, uint8_t mode, uint8_t phase)
 {
-  int16_t x = 0;
-  int16_t y = r;
-	int16_t dp = 1 - r;
+  int16_t cx, cy, cw, ch, first;
 
-  set_pixel(tg, x0, y0 + r, color);
-  set_pixel(tg, x0, y0 - r, color);
-  set_pixel(tg, x0 + r, y0, color);
-  set_pixel(tg, x0 - r, y0, color);
+  STATS_CALL(tg, STAT_GRAY_IMAGE);
+  if ((mode >= DITHER_TYPES) || (w <= 0) || (h <= 0)) return;
+  x += tg.clip.origin_x;
+  y += tg.clip.origin_y;
+  cx = x;
+  cy = y;
+  cw = w;
+  ch = h;
+  if (!clip_rect(tg, &cx, &cy, &cw, &ch)) return;
+  STATS_PIXELS(tg, cw * ch);
 
-	do {
-		if (dp < 0) {
-			dp = dp + 2 * (++x) + 3;
+  // errors of the next row in 1/16, err[i + 1] is column i
+  int16_t err[(mode == DITHER_DIFFUSION) ? w + 2 : 1];
+  uint8_t strip[cw];
+
+  memset(err, 0, sizeof(err));
+  memset(strip, 0, cw);
+  first = (mode == DITHER_DIFFUSION) ? y : cy;
+  for (int16_t row = first; row < cy + ch; row++) {
+    const uint8_t *g = gray + (int32_t)(row - y) * w;
+    uint8_t bit = 1 << (row & 7);
+
+    if (mode == DITHER_DIFFUSION) {
+      int16_t right = 0;          // 7/16 of the error, for the next column
+      int16_t below = 0;          // 1/16 of the error, for the next row
+
+      err[0] = 0;
+      for (int16_t i = 0; i < w; i++) {
+        int16_t v = g[i] + ((err[i + 1] + right + 8) >> 4);
+        int16_t c = x + i - cx;
+        int16_t e = v;
+
+        if (v >= 128) {
+          e = v - 255;
+          if ((row >= cy) && (c >= 0) && (c < cw)) strip[c] |= bit;
+        }
+        err[i] += 3 * e;
+        err[i + 1] = 5 * e + below;
+        below = e;
+        right = 7 * e;
+      }
+      if (row < cy) continue;
     }
     else {
-			dp = dp + 2 * (++x) - 2 * (--y) + 5;
+      const uint8_t *t = bayer8[row & 7];
+
+      g += cx - x;
+      for (int16_t c = 0; c < cw; c++) {
+        uint8_t on = (mode == DITHER_THRESHOLD) ? (g[c] >= 128) : (g[c] > (uint8_t)(t[(cx + c) & 7] * 4 + 2 + phase));
+
+        if (on) strip[c] |= bit;
+      }
     }
 
-		set_pixel(tg, x0 + x, y0 + y, color);     //For the 8 octants
-		set_pixel(tg, x0 - x, y0 + y, color);
-		set_pixel(tg, x0 + x, y0 - y, color);
-		set_pixel(tg, x0 - x, y0 - y, color);
-		set_pixel(tg, x0 + y, y0 + x, color);
-		set_pixel(tg, x0 - y, y0 + x, color);
-		set_pixel(tg, x0 + y, y0 - x, color);
-		set_pixel(tg, x0 - y, y0 - x, color);
+    // page complete
+    if (((row & 7) == 7) || (row == cy + ch - 1)) {
+      int16_t page = row / 8;
+      int16_t r0 = (page * 8 > cy) ? page * 8 : cy;
+      uint8_t mask = (0xFF << (r0 & 7)) & (0xFF >> (7 - (row & 7)));
+      uint8_t *dst = tg.display_buffer + page * tg.display_width + cx;
 
-	} while (x < y);
+      for (int16_t c = 0; c < cw; c++) {
+        dst[c] = (dst[c] & ~mask) | (strip[c] & mask);
+      }
+      memset(strip, 0, cw);
+      dirty_mark_column(tg, cx, page);
+      dirty_mark_column(tg, cx + cw - 1, page);
+    }
+  }
 }
 
-void 
-draw_fill_circle(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t r, int16_t color) 
+// Software scroll
+//
+// Move the pixels of a rectangle by (dx, dy) inside the frame buffer.
+// The strip that comes into view is cleared; pixels moved out of the
+// rectangle are dropped and the rest of the frame is left untouched.
+// Whole-page moves are memmove, other vertical moves build each page of
+// a column from the two source pages it straddles, so canvases of any
+// height scroll the same way.
+//
+// rows of page inside [y, y + h) as a bit mask
+static uint8_t
+scroll_page_mask(int16_t y, int16_t h, int32_t page)
 {
-  int16_t x = 0;
-  int16_t y = r;
-	int16_t dp = 1 - r;
-  
-  draw_horizontal_line(tg, x0 - r, y0, 2 * r, color);
+  int32_t r0 = page * 8, r1 = r0 + 7;
+  int32_t y1 = (int32_t)y + h - 1;
+  uint8_t mask = 0xFF;
+
+  if ((r1 < y) || (r0 > y1)) return 0;
+  if (r0 < y) mask &= 0xFF << (y - r0);
+  if (r1 > y1) mask &= 0xFF >> (r1 - y1);
+  return mask;
+}
+
+static void
+scroll_vertical(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, int16_t dy)
+{
+  int16_t page0 = y / 8;
+  int16_t page1 = (y + h - 1) / 8;
+  int16_t shift = (dy < 0) ? -dy : dy;
+
+  if ((y & 7) == 0 && (h & 7) == 0 && (dy & 7) == 0) {
+    int16_t move = dy / 8;
+    int16_t pages = page1 - page0 + 1;
 
-	do {
-		if (dp < 0) {
-			dp = dp + 2 * (++x) + 3;
+    if (shift >= h) {
+      fill_span_rect(tg, x, y, w, h, BLACK);
+      return;
     }
-    else {
-			dp = dp + 2 * (++x) - 2 * (--y) + 5;
+    for (int16_t i = 0; i < pages - shift / 8; i++) {
+      int16_t page = (move > 0) ? page1 - i : page0 + i;
+      memmove(tg.display_buffer + page * tg.display_width + x,
+              tg.display_buffer + (page - move) * tg.display_width + x, w);
+    }
+    for (int16_t i = 0; i < shift / 8; i++) {
+      int16_t page = (move > 0) ? page0 + i : page1 - i;
+      memset(tg.display_buffer + page * tg.display_width + x, 0x00, w);
     }
+    return;
+  }
+
+  // dy > 0 fills pages from the bottom, their sources are above them;
+  // dy < 0 from the top. A page is read before it is written.
+  for (int16_t i = 0; i <= page1 - page0; i++) {
+    int16_t page = (dy > 0) ? page1 - i : page0 + i;
+    int32_t start = (int32_t)page * 8 + ((dy > 0) ? -shift : shift);  // source row of bit 0
+    int32_t q = (start >= 0) ? start / 8 : -((7 - start) / 8);      // its page
+    int16_t bit = start - q * 8;
+    uint8_t mask = scroll_page_mask(y, h, page);
+    uint8_t m0 = (q >= page0 && q <= page1) ? scroll_page_mask(y, h, q) : 0;
+    uint8_t m1 = (q + 1 >= page0 && q + 1 <= page1) ? scroll_page_mask(y, h, q + 1) : 0;
+    const uint8_t *s0 = tg.display_buffer + (m0 ? q * tg.display_width : 0) + x;
+    const uint8_t *s1 = tg.display_buffer + (m1 ? (q + 1) * tg.display_width : 0) + x;
+    uint8_t *dst = tg.display_buffer + page * tg.display_width + x;
 
-    draw_horizontal_line(tg, x0 - x, y0 - y, 2 * x, color);
-    draw_horizontal_line(tg, x0 - x, y0 + y, 2 * x, color);
-    draw_horizontal_line(tg, x0 - y, y0 - x, 2 * y, color);
-    draw_horizontal_line(tg, x0 - y, y0 + x, 2 * y, color);
-	} while (x < y);
+    for (int16_t c = 0; c < w; c++) {
+      uint16_t bits = (s0[c] & m0) | ((s1[c] & m1) << 8);
+
+      dst[c] = (dst[c] & ~mask) | ((uint8_t)(bits >> bit) & mask);
+    }
+  }
 }
 
-// Display a character string
-void 
-draw_char(tinygrafx_t tg, int16_t x, int16_t y, uint8_t c, int16_t color, int16_t fontsize) 
+static void
+scroll_horizontal(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, int16_t dx)
 {
-  uint8_t row_pixel;
-  uint16_t font_width;
+  int16_t y1 = y + h - 1;
+  int16_t shift = (dx < 0) ? -dx : dx;
+  int16_t keep = (shift < w) ? w - shift : 0;
+  int16_t src = (dx > 0) ? x : x + shift;
+  int16_t dst = (dx > 0) ? x + shift : x;
+  int16_t exposed = (dx > 0) ? x : x + keep;
 
-  for (int16_t y1 = 0; y1 < tg.font_height; y1++) {  
-    row_pixel = font8x8_basic[c][y1];
+  for (int16_t page = y / 8; page <= y1 / 8; page++) {
+    uint8_t *row = tg.display_buffer + page * tg.display_width;
+    uint8_t mask = 0xFF;
 
-    for (int16_t x1 = 0; x1 < tg.font_width; x1++) {
-      if (row_pixel & 0x01) {
-        if (fontsize == 1) {
-          set_pixel(tg, x + x1, y + y1, color);
-        }
-        else {
-          font_width = (fontsize & 0x01) + (fontsize / 2);
-          draw_fill_rect(tg, x + x1 * font_width, y + y1 * fontsize, font_width, fontsize, color);
-        }
+    if (page == y / 8) mask &= 0xFF << (y & 7);
+    if (page == y1 / 8) mask &= 0xFF >> (7 - (y1 & 7));
+
+    if (mask == 0xFF) {
+      memmove(row + dst, row + src, keep);
+      memset(row + exposed, 0x00, w - keep);
+      continue;
+    }
+    // partial page: only the bits of the rectangle move
+    if (dx > 0) {
+      for (int16_t i = keep - 1; i >= 0; i--) {
+        row[dst + i] = (row[dst + i] & ~mask) | (row[src + i] & mask);
       }
-      row_pixel >>= 1;
+    }
+    else {
+      for (int16_t i = 0; i < keep; i++) {
+        row[dst + i] = (row[dst + i] & ~mask) | (row[src + i] & mask);
+      }
+    }
+    for (int16_t i = 0; i < w - keep; i++) {
+      row[exposed + i] &= ~mask;
     }
   }
-  // ESP_LOGI(TAG, "draw char: 0x%X=%c", c, c);
 }
 
-void 
-display_text(tinygrafx_t tg, int16_t x, int16_t y, uint8_t *text, int16_t length, int16_t color, int16_t fontsize) 
+void
+scroll_region(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, int16_t dx, int16_t dy)
 {
-  // ESP_LOGI(TAG, "display text: %s, length: %d, fontsize: %d", text, length, fontsize);
-  uint16_t font_width;
+  STATS_CALL(tg, STAT_SCROLL);
+  x += tg.clip.origin_x;
+  y += tg.clip.origin_y;
+  if (!clip_rect(tg, &x, &y, &w, &h)) return;
+  if ((dx == 0) && (dy == 0)) return;
+  STATS_PIXELS(tg, w * h);
+
+  if (dy != 0) {
+    scroll_vertical(tg, x, y, w, h, dy);
+  }
+  if (dx != 0) {
+    scroll_horizontal(tg, x, y, w, h, dx);
+  }
+  dirty_mark(tg, x, y, x + w - 1, y + h - 1);
+}
+
+// Line rasterizer
+//
+// Bresenham over the major axis. The line is clipped once up front: the
+// first and last steps inside the clip rectangle are solved from the
+// error term, so the pixels are the same as for the unclipped line.
+//
+typedef struct line_t {
+  int16_t steep;          // major axis is y
+  int16_t u, v;           // major / minor coordinate of the first step
+  int16_t ystep;          // minor direction
+  int32_t dx, dy;         // major / minor length
+  int32_t err;            // error term at the first step
+  int32_t steps;          // number of steps - 1
+} line_t;
+
+// Set up the line and clip its major axis to [umin, umax), and its minor
+// axis to [vmin, vmax) unless clip_minor is 0. Returns 0 if nothing is left.
+static uint8_t
+line_setup(tinygrafx_t tg, line_t *l, int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t clip_minor)
+{
+  int32_t k0, k1, n, half, umin, umax, vmin, vmax, nlo, nhi;
+
+  l->steep = abs(y1 - y0) > abs(x1 - x0);
+  if (l->steep) {
+    swap_int16_t(x0, y0);
+    swap_int16_t(x1, y1);
+  }
+  if (x0 > x1) {
+    swap_int16_t(x0, x1);
+    swap_int16_t(y0, y1);
+  }
+
+  l->dx = x1 - x0;
+  l->dy = abs(y1 - y0);
+  l->ystep = (y0 < y1) ? 1 : -1;
+  half = l->dx / 2;
+  umin = l->steep ? tg.clip.y0 : tg.clip.x0;
+  umax = l->steep ? tg.clip.y1 : tg.clip.x1;
+  vmin = l->steep ? tg.clip.x0 : tg.clip.y0;
+  vmax = l->steep ? tg.clip.x1 : tg.clip.y1;
+
+  // steps inside the major axis
+  k0 = (x0 < umin) ? umin - x0 : 0;
+  k1 = (x1 >= umax) ? umax - 1 - x0 : l->dx;
+
+  // after k steps the minor axis has moved n(k) = ceil((k * dy - half) / dx)
+  // times, keep the steps where nlo <= n(k) <= nhi. dx and dy reach 65535
+  // for far off-screen ends, so the products are 64-bit.
+  if (clip_minor && (l->dy > 0)) {
+    if (l->ystep > 0) {
+      nlo = vmin - y0;
+      nhi = vmax - 1 - y0;
+    }
+    else {
+      nlo = y0 - (vmax - 1);
+      nhi = y0 - vmin;
+    }
+    if ((nhi < 0) || (nlo > l->dy)) return 0;
+    if (nlo > 0) {
+      n = ((int64_t)(nlo - 1) * l->dx + half) / l->dy + 1;
+      if (n > k0) k0 = n;
+    }
+    if (nhi < l->dy) {
+      n = ((int64_t)nhi * l->dx + half) / l->dy;
+      if (n < k1) k1 = n;
+    }
+  }
+  else if (clip_minor && ((y0 < vmin) || (y0 >= vmax))) {
+    return 0;
+  }
+  if (k0 > k1) return 0;
+
+  n = ((int64_t)k0 * l->dy > half) ? ((int64_t)k0 * l->dy - half + l->dx - 1) / l->dx : 0;
+  l->err = half - (int64_t)k0 * l->dy + (int64_t)n * l->dx;
+  l->u = x0 + k0;
+  l->v = y0 + l->ystep * n;
+  l->steps = k1 - k0;
+  return 1;
+}
+
+static void
+line(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t color)
+{
+  line_t l;
+  uint8_t *p, mask, set, flip;
+  int16_t col, row, page, seg;
+
+  // axis aligned lines go to the span kernels
+  if ((y0 == y1) || (x0 == x1)) {
+    if (x0 > x1) swap_int16_t(x0, x1);
+    if (y0 > y1) swap_int16_t(y0, y1);
+    if (x0 < tg.clip.x0) x0 = tg.clip.x0;
+    if (y0 < tg.clip.y0) y0 = tg.clip.y0;
+    if (x1 >= tg.clip.x1) x1 = tg.clip.x1 - 1;
+    if (y1 >= tg.clip.y1) y1 = tg.clip.y1 - 1;
+    fill_rect(tg, x0, y0, x1 - x0 + 1, y1 - y0 + 1, color);
+    return;
+  }
+  if (!line_setup(tg, &l, x0, y0, x1, y1, 1)) return;
+
+  // WHITE sets the bit, BLACK sets and flips it, INVERT flips it
+  switch (color) {
+    case WHITE:  set = 0xFF; flip = 0x00; break;
+    case BLACK:  set = 0xFF; flip = 0xFF; break;
+    case INVERT: set = 0x00; flip = 0xFF; break;
+    default: return;
+  }
+  STATS_PIXELS(tg, l.steps + 1);
+
+  col = l.steep ? l.v : l.u;
+  row = l.steep ? l.u : l.v;
+  page = row / 8;
+  seg = col;
+  p = tg.display_buffer + page * tg.display_width + col;
+  mask = 1 << (row & 7);
+
+  if (!l.steep) {
+    // one column per step, the bit moves up or down
+    while (1) {
+      *p = (*p | (mask & set)) ^ (mask & flip);
+      if (l.steps-- == 0) break;
+      l.err -= l.dy;
+      if (l.err < 0) {
+        l.err += l.dx;
+        mask = (l.ystep > 0) ? (mask << 1) : (mask >> 1);
+        if (mask == 0) {
+          dirty_mark_column(tg, seg, page);
+          dirty_mark_column(tg, col, page);
+          mask = (l.ystep > 0) ? 0x01 : 0x80;
+          page += l.ystep;
+          p += l.ystep * tg.display_width;
+          seg = col + 1;
+        }
+      }
+      p++;
+      col++;
+    }
+  }
+  else {
+    // one row per step, the column moves left or right
+    while (1) {
+      *p = (*p | (mask & set)) ^ (mask & flip);
+      if (l.steps-- == 0) break;
+      int16_t last = col;
+      l.err -= l.dy;
+      if (l.err < 0) {
+        l.err += l.dx;
+        p += l.ystep;
+        col += l.ystep;
+      }
+      mask <<= 1;
+      if (mask == 0) {
+        dirty_mark_column(tg, seg, page);
+        dirty_mark_column(tg, last, page);
+        mask = 0x01;
+        page++;
+        p += tg.display_width;
+        seg = col;
+      }
+    }
+  }
+  dirty_mark_column(tg, seg, page);
+  dirty_mark_column(tg, col, page);
+}
+
+void 
+draw_line(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t color) 
+{
+  STATS_CALL(tg, STAT_LINE);
+  line(tg, x0 + tg.clip.origin_x, y0 + tg.clip.origin_y, x1 + tg.clip.origin_x, y1 + tg.clip.origin_y, color);
+}
+
+static int64_t
+isqrt(int64_t n)
+{
+  int64_t x = n, y = (n + 1) / 2;
+
+  while (y < x) {
+    x = y;
+    y = (x + n / x) / 2;
+  }
+  return x;
+}
+
+// Line of the given thickness. Each step of the major axis fills one
+// span across the line, so every pixel is written once.
+void
+draw_thick_line(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t thickness, int16_t color)
+{
+  line_t l;
+  int32_t t, offset, vmin, vmax;
+
+  STATS_CALL(tg, STAT_LINE);
+  x0 += tg.clip.origin_x;
+  y0 += tg.clip.origin_y;
+  x1 += tg.clip.origin_x;
+  y1 += tg.clip.origin_y;
+  if (thickness <= 1) {
+    line(tg, x0, y0, x1, y1, color);
+    return;
+  }
+  offset = (thickness - 1) / 2;
+
+  // axis aligned lines are rectangles, their length cut to the viewport
+  // so it fits the rectangle size
+  if ((y0 == y1) || (x0 == x1)) {
+    if (x0 > x1) swap_int16_t(x0, x1);
+    if (y0 > y1) swap_int16_t(y0, y1);
+    if (y0 == y1) {
+      if (x0 < tg.clip.x0) x0 = tg.clip.x0;
+      if (x1 >= tg.clip.x1) x1 = tg.clip.x1 - 1;
+      if (x0 > x1) return;
+      fill_rect(tg, x0, y0 - offset, x1 - x0 + 1, thickness, color);
+    }
+    else {
+      if (y0 < tg.clip.y0) y0 = tg.clip.y0;
+      if (y1 >= tg.clip.y1) y1 = tg.clip.y1 - 1;
+      if (y0 > y1) return;
+      fill_rect(tg, x0 - offset, y0, thickness, y1 - y0 + 1, color);
+    }
+    return;
+  }
+  if (!line_setup(tg, &l, x0, y0, x1, y1, 0)) return;
+
+  // span length along the minor axis for the thickness across the line.
+  // dx and dy reach 65535 for far off-screen ends, so 64-bit arithmetic.
+  t = ((int64_t)thickness * isqrt((int64_t)l.dx * l.dx + (int64_t)l.dy * l.dy) + l.dx / 2) / l.dx;
+  offset = (t - 1) / 2;
+  vmin = l.steep ? tg.clip.x0 : tg.clip.y0;
+  vmax = l.steep ? tg.clip.x1 : tg.clip.y1;
+
+  while (1) {
+    // the span clamped to the viewport
+    int32_t v0 = l.v - offset, v1 = v0 + t;
+
+    if (v0 < vmin) v0 = vmin;
+    if (v1 > vmax) v1 = vmax;
+    if (v0 < v1) {
+      if (l.steep) {
+        hline(tg, v0, l.u, v1 - v0, color);
+      }
+      else {
+        vline(tg, l.u, v0, v1 - v0, color);
+      }
+    }
+    if (l.steps-- == 0) break;
+    l.err -= l.dy;
+    if (l.err < 0) {
+      l.err += l.dx;
+      l.v += l.ystep;
+    }
+    l.u++;
+  }
+}
+
+void 
+draw_vertical_line(tinygrafx_t tg, int16_t x, int16_t y, int16_t h, int16_t color) 
+{
+  STATS_CALL(tg, STAT_VLINE);
+  vline(tg, x + tg.clip.origin_x, y + tg.clip.origin_y, h, color);
+}
+
+void 
+draw_horizontal_line(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t color) 
+{
+  STATS_CALL(tg, STAT_HLINE);
+  hline(tg, x + tg.clip.origin_x, y + tg.clip.origin_y, w, color);
+}
+
+void 
+draw_rect(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, int16_t color) 
+{
+  STATS_CALL(tg, STAT_RECT);
+  x += tg.clip.origin_x;
+  y += tg.clip.origin_y;
+  hline(tg, x, y, w, color);
+  hline(tg, x, y + h - 1, w, color);
+  vline(tg, x, y, h, color);
+  vline(tg, x + w - 1, y, h, color);
+}
+
+void 
+draw_fill_rect(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, int16_t color) 
+{
+  STATS_CALL(tg, STAT_FILL_RECT);
+  fill_rect(tg, x + tg.clip.origin_x, y + tg.clip.origin_y, w, h, color);
+}
+
+// Scanline shapes
+//
+// Circles, ellipses, arcs, rounded rectangles and polygons are made of
+// row spans. A shape gives the spans of up to 8 rows at a time, at most
+// SHAPE_SPANS disjoint spans per row, and fill_shape turns each page of
+// them into byte masks: the columns covered by every row of the page are
+// one fill_page_span, the columns at the edges get a mask each. Every
+// pixel is written once, so INVERT works on all of them.
+//
+#define SHAPE_SPANS     8
+
+typedef struct page_spans_t {
+  uint8_t count[8];
+  int16_t x0[8][SHAPE_SPANS];
+  int16_t x1[8][SHAPE_SPANS];
+} page_spans_t;
+
+typedef struct shape_t shape_t;
+
+struct shape_t {
+  // spans of the rows y .. y + n - 1, n <= 8
+  void (*rows)(const shape_t *s, int16_t y, int16_t n, page_spans_t *spans);
+  int16_t top, bottom;          // rows inside the clip
+
+  // rounded box: a quarter outline around each of four centers, the
+  // quarter row j is lo[j - first] .. hi[j - first] from the center
+  int16_t left, right;          // center columns
+  int16_t upper, lower;         // center rows
+  int16_t first;
+  const int16_t *lo;            // NULL = filled
+  const int16_t *hi;
+
+  // arc: the wedge between the angles, in pieces under 180 degrees
+  int16_t pieces;
+  int16_t ax[3], ay[3];         // first direction of each piece
+  int16_t bx[3], by[3];         // direction past its end
+
+  // polygon
+  const int16_t *px, *py;
+  int16_t count;
+};
+
+static int32_t
+floor_div(int32_t a, int32_t b)
+{
+  int32_t q = a / b;
+
+  if ((a % b != 0) && ((a < 0) != (b < 0))) q--;
+  return q;
+}
+
+// Apply one mask per column to w bytes of one page, starting at column x
+static void
+mask_page_span(tinygrafx_t tg, int16_t page, int16_t x, int16_t w, const uint8_t *masks, int16_t color)
+{
+  uint8_t *p = tg.display_buffer + page * tg.display_width + x;
+
+  switch (color) {
+    case WHITE:
+      for (int16_t c = 0; c < w; c++) p[c] |= masks[c];
+      break;
+    case BLACK:
+      for (int16_t c = 0; c < w; c++) p[c] &= ~masks[c];
+      break;
+    case INVERT:
+      for (int16_t c = 0; c < w; c++) p[c] ^= masks[c];
+      break;
+    default:
+      return;
+  }
+#ifdef TINYGRAFX_STATS
+  for (int16_t c = 0; c < w; c++) STATS_PIXELS(tg, nibble_bits[masks[c] & 0x0F] + nibble_bits[masks[c] >> 4]);
+#endif
+  dirty_mark_column(tg, x, page);
+  dirty_mark_column(tg, x + w - 1, page);
+}
+
+static void
+fill_shape(tinygrafx_t tg, const shape_t *s, int16_t color)
+{
+  page_spans_t spans;
+  int16_t y0 = (s->top > tg.clip.y0) ? s->top : tg.clip.y0;
+  int16_t y1 = (s->bottom < tg.clip.y1 - 1) ? s->bottom : tg.clip.y1 - 1;
+
+  for (int16_t y = y0; y <= y1; y = (y | 7) + 1) {
+    int16_t page = y / 8;
+    int16_t n = (((y | 7) < y1) ? (y | 7) : y1) - y + 1;
+
+    s->rows(s, y, n, &spans);
+
+    // the k-th spans of the rows, one page pass each
+    for (int16_t k = 0; k < SHAPE_SPANS; k++) {
+      int16_t x0[8], x1[8];
+      uint8_t bits[8];
+      int16_t m = 0, more = 0;
+      int16_t lo = INT16_MAX, hi = INT16_MIN, in0 = INT16_MIN, in1 = INT16_MAX;
+      uint8_t all = 0;
+
+      for (int16_t i = 0; i < n; i++) {
+        int16_t a, b;
+
+        if (spans.count[i] <= k) continue;
+        more = 1;
+        a = (spans.x0[i][k] > tg.clip.x0) ? spans.x0[i][k] : tg.clip.x0;
+        b = (spans.x1[i][k] < tg.clip.x1 - 1) ? spans.x1[i][k] : tg.clip.x1 - 1;
+        if (a > b) continue;
+        x0[m] = a;
+        x1[m] = b;
+        bits[m] = 1 << ((y + i) & 7);
+        if (a < lo) lo = a;
+        if (b > hi) hi = b;
+        if (a > in0) in0 = a;
+        if (b < in1) in1 = b;
+        all |= bits[m];
+        m++;
+      }
+      if (!more) break;
+      if (m == 0) continue;
+
+      // columns covered by all the rows are one mask, the edges around
+      // them get a mask per column, set row by row
+      if (in0 > in1) {
+        in0 = hi + 1;
+        in1 = hi;
+      }
+      if (in0 <= in1) fill_page_span(tg, page, in0, in1 - in0 + 1, all, color);
+      if ((lo < in0) || (in1 < hi)) {
+        uint8_t masks[hi - lo + 1];
+
+        memset(masks, 0, hi - lo + 1);
+        for (int16_t i = 0; i < m; i++) {
+          for (int16_t c = x0[i]; (c < in0) && (c <= x1[i]); c++) masks[c - lo] |= bits[i];
+          for (int16_t c = (in1 + 1 > x0[i]) ? in1 + 1 : x0[i]; c <= x1[i]; c++) masks[c - lo] |= bits[i];
+        }
+        if (lo < in0) mask_page_span(tg, page, lo, in0 - lo, masks, color);
+        if (in1 < hi) mask_page_span(tg, page, in1 + 1, hi - in1, masks + (in1 + 1 - lo), color);
+      }
+    }
+  }
+}
+
+// Rounded box
+//
+// A circle or an ellipse is a box with one center, a rounded rectangle
+// has four. Outline rows are a left and a right piece, except the top
+// and bottom rows of the quarters and rows where the pieces meet.
+//
+static void
+box_rows(const shape_t *s, int16_t y, int16_t n, page_spans_t *spans)
+{
+  for (int16_t i = 0; i < n; i++, y++) {
+    uint8_t quarter = (y <= s->upper) || (y >= s->lower);
+    int16_t j = (y < s->upper) ? s->upper - y : ((y > s->lower) ? y - s->lower : 0);
+    int16_t hi = s->hi[j - s->first];
+    int16_t lo = (s->lo != NULL) ? s->lo[j - s->first] : 0;
+
+    if ((s->lo == NULL) || ((lo == 0) && quarter) || (s->left - lo >= s->right + lo)) {
+      spans->count[i] = 1;
+      spans->x0[i][0] = s->left - hi;
+      spans->x1[i][0] = s->right + hi;
+    }
+    else {
+      spans->count[i] = 2;
+      spans->x0[i][0] = s->left - hi;
+      spans->x1[i][0] = s->left - lo;
+      spans->x0[i][1] = s->right + lo;
+      spans->x1[i][1] = s->right + hi;
+    }
+  }
+}
+
+// Rows of the box inside the clip and the quarter rows j0..j1 they use.
+// Returns 0 if the box is outside the clip.
+static uint8_t
+box_setup(tinygrafx_t tg, shape_t *s, int16_t rx, int16_t ry, int16_t *j0, int16_t *j1)
+{
+  int32_t y0 = s->upper - ry;
+  int32_t y1 = s->lower + ry;
+  int16_t a, b;
+
+  if ((s->left - rx >= tg.clip.x1) || (s->right + rx < tg.clip.x0)) return 0;
+  if (y0 < tg.clip.y0) y0 = tg.clip.y0;
+  if (y1 > tg.clip.y1 - 1) y1 = tg.clip.y1 - 1;
+  if (y0 > y1) return 0;
+
+  s->rows = box_rows;
+  s->top = y0;
+  s->bottom = y1;
+  a = (y0 < s->upper) ? s->upper - y0 : ((y0 > s->lower) ? y0 - s->lower : 0);
+  b = (y1 < s->upper) ? s->upper - y1 : ((y1 > s->lower) ? y1 - s->lower : 0);
+  if (y1 < s->upper) *j0 = b;
+  else if (y0 > s->lower) *j0 = a;
+  else *j0 = 0;
+  *j1 = (a > b) ? a : b;
+  s->first = *j0;
+  return 1;
+}
+
+static inline void
+quarter_point(int16_t *lo, int16_t *hi, int16_t j0, int16_t j1, int16_t x, int16_t j)
+{
+  if ((j < j0) || (j > j1)) return;
+  if (x < lo[j - j0]) lo[j - j0] = x;
+  if (x > hi[j - j0]) hi[j - j0] = x;
+}
+
+static void
+quarter_clear(int16_t *lo, int16_t *hi, int16_t j0, int16_t j1)
+{
+  for (int16_t j = 0; j <= j1 - j0; j++) {
+    lo[j] = INT16_MAX;
+    hi[j] = -1;
+  }
+}
+
+// Quarter of the midpoint circle, rows j0..j1
+static void
+circle_table(int16_t r, int16_t j0, int16_t j1, int16_t *lo, int16_t *hi)
+{
+  int16_t x = 0;
+  int16_t y = r;
+  int16_t dp = 1 - r;
+
+  quarter_clear(lo, hi, j0, j1);
+  quarter_point(lo, hi, j0, j1, 0, r);
+  quarter_point(lo, hi, j0, j1, r, 0);
+  while (x < y) {
+    if (dp < 0) {
+      dp = dp + 2 * (++x) + 3;
+    }
+    else {
+      dp = dp + 2 * (++x) - 2 * (--y) + 5;
+    }
+    quarter_point(lo, hi, j0, j1, x, y);
+    quarter_point(lo, hi, j0, j1, y, x);
+  }
+}
+
+// Quarter of the midpoint ellipse, rows j0..j1
+static void
+ellipse_table(int16_t rx, int16_t ry, int16_t j0, int16_t j1, int16_t *lo, int16_t *hi)
+{
+  int64_t rx2 = (int64_t)rx * rx;
+  int64_t ry2 = (int64_t)ry * ry;
+  int64_t px = 0;
+  int64_t py = 2 * rx2 * ry;
+  int64_t p;
+  int16_t x = 0;
+  int16_t y = ry;
+
+  quarter_clear(lo, hi, j0, j1);
+
+  // region 1, slope above -1: x steps
+  p = ry2 - rx2 * ry + (rx2 + 2) / 4;
+  while (px < py) {
+    quarter_point(lo, hi, j0, j1, x, y);
+    x++;
+    px += 2 * ry2;
+    if (p < 0) {
+      p += ry2 + px;
+    }
+    else {
+      y--;
+      py -= 2 * rx2;
+      p += ry2 + px - py;
+    }
+  }
+
+  // region 2: y steps, p is 4 times the decision value
+  p = ry2 * (2 * x + 1) * (2 * x + 1) + 4 * rx2 * (y - 1) * (y - 1) - 4 * rx2 * ry2;
+  while (y >= 0) {
+    quarter_point(lo, hi, j0, j1, x, y);
+    y--;
+    py -= 2 * rx2;
+    if (p > 0) {
+      p += 4 * (rx2 - py);
+    }
+    else {
+      x++;
+      px += 2 * ry2;
+      p += 4 * (rx2 - py + px);
+    }
+  }
+
+  // region 2 stops short of the tips of flat ellipses
+  quarter_point(lo, hi, j0, j1, rx, 0);
+}
+
+void
+draw_circle(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t r, int16_t color)
+{
+  shape_t s = { .left = x0 + tg.clip.origin_x, .upper = y0 + tg.clip.origin_y };
+  int16_t j0, j1;
+
+  STATS_CALL(tg, STAT_CIRCLE);
+  s.right = s.left;
+  s.lower = s.upper;
+  if ((r < 0) || !box_setup(tg, &s, r, r, &j0, &j1)) return;
+
+  int16_t lo[j1 - j0 + 1], hi[j1 - j0 + 1];
+
+  circle_table(r, j0, j1, lo, hi);
+  s.lo = lo;
+  s.hi = hi;
+  fill_shape(tg, &s, color);
+}
+
+void
+draw_fill_circle(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t r, int16_t color)
+{
+  shape_t s = { .left = x0 + tg.clip.origin_x, .upper = y0 + tg.clip.origin_y };
+  int16_t j0, j1;
+
+  STATS_CALL(tg, STAT_FILL_CIRCLE);
+  s.right = s.left;
+  s.lower = s.upper;
+  if ((r < 0) || !box_setup(tg, &s, r, r, &j0, &j1)) return;
+
+  int16_t lo[j1 - j0 + 1], hi[j1 - j0 + 1];
+
+  circle_table(r, j0, j1, lo, hi);
+  s.hi = hi;
+  fill_shape(tg, &s, color);
+}
+
+static void
+ellipse(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t rx, int16_t ry, uint8_t filled, int16_t color)
+{
+  shape_t s = { .left = x0 + tg.clip.origin_x, .upper = y0 + tg.clip.origin_y };
+  int16_t j0, j1;
+
+  s.right = s.left;
+  s.lower = s.upper;
+  if ((rx < 0) || (ry < 0) || !box_setup(tg, &s, rx, ry, &j0, &j1)) return;
+
+  int16_t lo[j1 - j0 + 1], hi[j1 - j0 + 1];
+
+  ellipse_table(rx, ry, j0, j1, lo, hi);
+  s.lo = filled ? NULL : lo;
+  s.hi = hi;
+  fill_shape(tg, &s, color);
+}
+
+void
+draw_ellipse(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t rx, int16_t ry, int16_t color)
+{
+  STATS_CALL(tg, STAT_ELLIPSE);
+  ellipse(tg, x0, y0, rx, ry, 0, color);
+}
+
+void
+draw_fill_ellipse(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t rx, int16_t ry, int16_t color)
+{
+  STATS_CALL(tg, STAT_FILL_ELLIPSE);
+  ellipse(tg, x0, y0, rx, ry, 1, color);
+}
+
+// Corner radius r is cut down to fit half of the smaller side
+static void
+round_rect(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint8_t filled, int16_t color)
+{
+  shape_t s;
+  int16_t j0, j1;
+
+  if ((w <= 0) || (h <= 0)) return;
+  if (r > (w - 1) / 2) r = (w - 1) / 2;
+  if (r > (h - 1) / 2) r = (h - 1) / 2;
+  if (r < 0) r = 0;
+  x += tg.clip.origin_x;
+  y += tg.clip.origin_y;
+  s.left = x + r;
+  s.right = x + w - 1 - r;
+  s.upper = y + r;
+  s.lower = y + h - 1 - r;
+  if (!box_setup(tg, &s, r, r, &j0, &j1)) return;
+
+  int16_t lo[j1 - j0 + 1], hi[j1 - j0 + 1];
+
+  circle_table(r, j0, j1, lo, hi);
+  s.lo = filled ? NULL : lo;
+  s.hi = hi;
+  fill_shape(tg, &s, color);
+}
+
+void
+draw_round_rect(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, int16_t color)
+{
+  STATS_CALL(tg, STAT_ROUND_RECT);
+  round_rect(tg, x, y, w, h, r, 0, color);
+}
+
+void
+draw_fill_round_rect(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, int16_t color)
+{
+  STATS_CALL(tg, STAT_FILL_ROUND_RECT);
+  round_rect(tg, x, y, w, h, r, 1, color);
+}
+
+// Arcs and pie slices
+//
+// Angles are in degrees, clockwise from 3 o'clock. A pixel at (dx, dy)
+// from the center is in the piece from A to B when cross(A, p) >= 0 and
+// cross(B, p) < 0: on each row both are a bound on dx. Pieces meet on
+// the same direction vector, so no pixel is in two of them. The center
+// is in none and is added on its own.
+//
+static const int16_t sine_table[91] = {
+      0,   286,   572,   857,  1143,  1428,  1713,  1997,  2280,  2563,
+   2845,  3126,  3406,  3686,  3964,  4240,  4516,  4790,  5063,  5334,
+   5604,  5872,  6138,  6402,  6664,  6924,  7182,  7438,  7692,  7943,
+   8192,  8438,  8682,  8923,  9162,  9397,  9630,  9860, 10087, 10311,
+  10531, 10749, 10963, 11174, 11381, 11585, 11786, 11982, 12176, 12365,
+  12551, 12733, 12911, 13085, 13255, 13421, 13583, 13741, 13894, 14044,
+  14189, 14330, 14466, 14598, 14726, 14849, 14968, 15082, 15191, 15296,
+  15396, 15491, 15582, 15668, 15749, 15826, 15897, 15964, 16026, 16083,
+  16135, 16182, 16225, 16262, 16294, 16322, 16344, 16362, 16374, 16382,
+  16384,
+};
+
+// sin(a) * 16384, a in degrees
+static int16_t
+sine(int32_t a)
+{
+  a %= 360;
+  if (a < 0) a += 360;
+  if (a <= 90) return sine_table[a];
+  if (a <= 180) return sine_table[180 - a];
+  if (a <= 270) return -sine_table[a - 180];
+  return -sine_table[360 - a];
+}
+
+// Limit l..r (columns from the center) to the piece on row dy
+static void
+wedge_clip(const shape_t *s, int16_t p, int16_t dy, int32_t *l, int32_t *r)
+{
+  int32_t k = (int32_t)s->ax[p] * dy;
+
+  // ay * dx <= ax * dy
+  if (s->ay[p] > 0) {
+    int32_t m = floor_div(k, s->ay[p]);
+    if (m < *r) *r = m;
+  }
+  else if (s->ay[p] < 0) {
+    int32_t m = -floor_div(-k, s->ay[p]);
+    if (m > *l) *l = m;
+  }
+  else if (k < 0) {
+    *r = *l - 1;
+    return;
+  }
+
+  // by * dx > bx * dy
+  k = (int32_t)s->bx[p] * dy;
+  if (s->by[p] > 0) {
+    int32_t m = floor_div(k, s->by[p]) + 1;
+    if (m > *l) *l = m;
+  }
+  else if (s->by[p] < 0) {
+    int32_t m = -floor_div(-k, s->by[p]) - 1;
+    if (m < *r) *r = m;
+  }
+  else if (k >= 0) {
+    *r = *l - 1;
+  }
+}
+
+static void
+arc_rows(const shape_t *s, int16_t y, int16_t n, page_spans_t *spans)
+{
+  page_spans_t ring;
+
+  box_rows(s, y, n, &ring);
+  for (int16_t i = 0; i < n; i++) {
+    int16_t dy = y + i - s->upper;
+    uint8_t count = 0;
+
+    for (int16_t k = 0; k < ring.count[i]; k++) {
+      if ((dy == 0) && (ring.x0[i][k] <= s->left) && (s->left <= ring.x1[i][k])) {
+        spans->x0[i][count] = s->left;
+        spans->x1[i][count] = s->left;
+        count++;
+      }
+      for (int16_t p = 0; p < s->pieces; p++) {
+        int32_t l = ring.x0[i][k] - s->left;
+        int32_t r = ring.x1[i][k] - s->left;
+
+        wedge_clip(s, p, dy, &l, &r);
+        if (l > r) continue;
+        spans->x0[i][count] = s->left + l;
+        spans->x1[i][count] = s->left + r;
+        count++;
+      }
+    }
+    spans->count[i] = count;
+  }
+}
+
+// Ring of the given thickness (0 = the whole disc) between the angles
+static void
+arc(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t r, int16_t start, int16_t end, int16_t thickness, int16_t color)
+{
+  shape_t s = { .left = x0 + tg.clip.origin_x, .upper = y0 + tg.clip.origin_y };
+  int32_t sweep = end - start;
+  int16_t j0, j1;
+
+  if (sweep < 0) sweep = sweep % 360 + 360;
+  if (sweep > 360) sweep = 360;
+  if ((r < 0) || (sweep == 0)) return;
+  s.right = s.left;
+  s.lower = s.upper;
+  if (!box_setup(tg, &s, r, r, &j0, &j1)) return;
+  s.rows = arc_rows;
+
+  // pieces of at most 120 degrees
+  s.pieces = (sweep + 119) / 120;
+  for (int16_t p = 0; p < s.pieces; p++) {
+    int32_t a = start + sweep * p / s.pieces;
+    int32_t b = start + sweep * (p + 1) / s.pieces;
+
+    s.ax[p] = sine(a + 90);
+    s.ay[p] = sine(a);
+    s.bx[p] = sine(b + 90);
+    s.by[p] = sine(b);
+  }
+
+  int16_t lo[j1 - j0 + 1], hi[j1 - j0 + 1];
+
+  circle_table(r, j0, j1, lo, hi);
+  s.hi = hi;
+  if (thickness == 1) {
+    s.lo = lo;
+  }
+  else if ((thickness > 1) && (thickness <= r)) {
+    // inside the inner disc, on the rows it reaches
+    int16_t inner = r - thickness;
+    int16_t k1 = (j1 < inner) ? j1 : inner;
+
+    for (int16_t j = j0; j <= j1; j++) lo[j - j0] = 0;
+    if (k1 >= j0) {
+      int16_t ilo[k1 - j0 + 1], ihi[k1 - j0 + 1];
+
+      circle_table(inner, j0, k1, ilo, ihi);
+      for (int16_t j = j0; j <= k1; j++) lo[j - j0] = ihi[j - j0] + 1;
+    }
+    s.lo = lo;
+  }
+  fill_shape(tg, &s, color);
+}
+
+void
+draw_arc(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t r, int16_t start, int16_t end, int16_t thickness, int16_t color)
+{
+  STATS_CALL(tg, STAT_ARC);
+  if (thickness <= 0) return;
+  arc(tg, x0, y0, r, start, end, thickness, color);
+}
+
+void
+draw_pie(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t r, int16_t start, int16_t end, int16_t color)
+{
+  STATS_CALL(tg, STAT_PIE);
+  arc(tg, x0, y0, r, start, end, 0, color);
+}
+
+// Convex polygons
+//
+// A row of the polygon spans what its edges cover in the band from half
+// a row above to half a row below it, rounded to columns. Thin triangles
+// such as gauge needles stay connected and the vertices are always in.
+// Concave polygons are filled across their notches.
+//
+static void
+polygon_rows(const shape_t *s, int16_t y, int16_t n, page_spans_t *spans)
+{
+  int16_t x0[8], x1[8];
+
+  for (int16_t i = 0; i < n; i++) {
+    x0[i] = INT16_MAX;
+    x1[i] = INT16_MIN;
+  }
+  for (int16_t e = 0; e < s->count; e++) {
+    int16_t f = (e + 1 < s->count) ? e + 1 : 0;
+    int16_t xa = s->px[e], ya = s->py[e];
+    int16_t xb = s->px[f], yb = s->py[f];
+    int16_t r0, r1, top;
+    int32_t dx, dy2, q, rem, sq, sr;
+
+    if (ya > yb) {
+      swap_int16_t(xa, xb);
+      swap_int16_t(ya, yb);
+    }
+    if ((yb < y) || (ya >= y + n)) continue;
+    if (ya == yb) {
+      int16_t i = ya - y;
+
+      if (xa > xb) swap_int16_t(xa, xb);
+      if (xa < x0[i]) x0[i] = xa;
+      if (xb > x1[i]) x1[i] = xb;
+      continue;
+    }
+
+    // x rounded at half row h is floor((dy2 * xa + dx * (h - 2 * ya) + dy2 / 2) / dy2),
+    // q + rem / dy2 from half a row above r0, then 2 half rows a row
+    dx = xb - xa;
+    dy2 = 2 * (yb - ya);
+    r0 = (ya > y) ? ya : y;
+    r1 = (yb < y + n - 1) ? yb : y + n - 1;
+    {
+      int64_t num = (int64_t)dy2 * xa + (int64_t)dx * (2 * r0 - 1 - 2 * ya) + dy2 / 2;
+      int64_t q64 = num / dy2;
+
+      if ((num % dy2 != 0) && (num < 0)) q64--;
+      q = q64;
+      rem = num - q64 * dy2;
+    }
+    sq = floor_div(2 * dx, dy2);
+    sr = 2 * dx - sq * dy2;
+    top = (r0 == ya) ? xa : q;
+    for (int16_t r = r0; r <= r1; r++) {
+      int16_t bottom, a, b;
+
+      q += sq;
+      rem += sr;
+      if (rem >= dy2) {
+        rem -= dy2;
+        q++;
+      }
+      bottom = (r == yb) ? xb : q;
+      a = (top < bottom) ? top : bottom;
+      b = (top < bottom) ? bottom : top;
+      if (a < x0[r - y]) x0[r - y] = a;
+      if (b > x1[r - y]) x1[r - y] = b;
+      top = bottom;
+    }
+  }
+  for (int16_t i = 0; i < n; i++) {
+    spans->count[i] = (x0[i] <= x1[i]) ? 1 : 0;
+    spans->x0[i][0] = x0[i];
+    spans->x1[i][0] = x1[i];
+  }
+}
+
+// points holds count (x, y) pairs
+static void
+fill_polygon(tinygrafx_t tg, const int16_t *points, int16_t count, int16_t color)
+{
+  shape_t s;
+  int16_t px[count], py[count];
+  int16_t x0 = INT16_MAX, x1 = INT16_MIN;
+
+  if (count <= 0) return;
+  s.top = INT16_MAX;
+  s.bottom = INT16_MIN;
+  for (int16_t i = 0; i < count; i++) {
+    px[i] = points[2 * i] + tg.clip.origin_x;
+    py[i] = points[2 * i + 1] + tg.clip.origin_y;
+    if (px[i] < x0) x0 = px[i];
+    if (px[i] > x1) x1 = px[i];
+    if (py[i] < s.top) s.top = py[i];
+    if (py[i] > s.bottom) s.bottom = py[i];
+  }
+  if ((x1 < tg.clip.x0) || (x0 >= tg.clip.x1)) return;
+  s.rows = polygon_rows;
+  s.px = px;
+  s.py = py;
+  s.count = count;
+  fill_shape(tg, &s, color);
+}
+
+void
+draw_fill_triangle(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, int16_t color)
+{
+  int16_t points[6] = { x0, y0, x1, y1, x2, y2 };
+
+  STATS_CALL(tg, STAT_FILL_POLYGON);
+  fill_polygon(tg, points, 3, color);
+}
+
+void
+draw_fill_polygon(tinygrafx_t tg, const int16_t *points, int16_t count, int16_t color)
+{
+  STATS_CALL(tg, STAT_FILL_POLYGON);
+  fill_polygon(tg, points, count, color);
+}
+
+// Glyphs
+//
+// font8x8_basic is stored row by row. It is turned into columns on first
+// use, so a glyph is a page-ordered bitmap like the frame buffer. Glyphs
+// of the active font size are scaled once and kept in a small cache.
+//
+#define GLYPH_CACHE_SLOTS       16
+#define GLYPH_CACHE_MAX_SIZE    8       // scaled column fits in 64 bits
+
+static uint8_t font_columns[128][8];
+static uint8_t font_columns_ready = 0;
+
+static struct {
+  int16_t fontsize;                     // size of the cached glyphs, 0 = none
+  int16_t glyph_size;                   // bytes per glyph
+  int16_t tag[GLYPH_CACHE_SLOTS];       // character in each slot, -1 = empty
+  int16_t next;                         // slot to replace next
+  uint8_t *bits;
+} glyph_cache;
+
+static void
+font_columns_init(void)
+{
+  for (int16_t c = 0; c < 128; c++) {
+    for (int16_t x = 0; x < 8; x++) {
+      uint8_t column = 0;
+      for (int16_t y = 0; y < 8; y++) {
+        column |= ((font8x8_basic[c][y] >> x) & 0x01) << y;
+      }
+      font_columns[c][x] = column;
+    }
+  }
+  font_columns_ready = 1;
+}
+
+// Return the glyph scaled by fontsize: (8 * font_width) columns and
+// fontsize pages. NULL if it does not fit the cache.
+static const uint8_t *
+glyph_bitmap(uint8_t c, int16_t fontsize)
+{
+  int16_t font_width = (fontsize & 0x01) + (fontsize / 2);
+  int16_t width = 8 * font_width;
+  int16_t slot;
+  uint8_t *glyph;
+
+  if (!font_columns_ready) {
+    font_columns_init();
+  }
+  if (fontsize == 1) {
+    return font_columns[c];
+  }
+  if (fontsize > GLYPH_CACHE_MAX_SIZE) {
+    return NULL;
+  }
+
+  if (glyph_cache.fontsize != fontsize) {
+    free(glyph_cache.bits);
+    glyph_cache.glyph_size = width * fontsize;
+    glyph_cache.bits = (uint8_t *)malloc(GLYPH_CACHE_SLOTS * glyph_cache.glyph_size);
+    glyph_cache.fontsize = (glyph_cache.bits != NULL) ? fontsize : 0;
+    glyph_cache.next = 0;
+    for (slot = 0; slot < GLYPH_CACHE_SLOTS; slot++) {
+      glyph_cache.tag[slot] = -1;
+    }
+    if (glyph_cache.bits == NULL) return NULL;
+  }
+
+  for (slot = 0; slot < GLYPH_CACHE_SLOTS; slot++) {
+    if (glyph_cache.tag[slot] == c) {
+      return glyph_cache.bits + slot * glyph_cache.glyph_size;
+    }
+  }
+
+  // not cached, scale it into the oldest slot
+  slot = glyph_cache.next;
+  glyph_cache.next = (slot + 1) % GLYPH_CACHE_SLOTS;
+  glyph = glyph_cache.bits + slot * glyph_cache.glyph_size;
+  for (int16_t x = 0; x < 8; x++) {
+    // stretch the column to 8 * fontsize rows
+    uint64_t column = 0;
+    for (int16_t y = 0; y < 8; y++) {
+      if ((font_columns[c][x] >> y) & 0x01) {
+        column |= ((((uint64_t)1) << fontsize) - 1) << (y * fontsize);
+      }
+    }
+    for (int16_t page = 0; page < fontsize; page++) {
+      memset(glyph + page * width + x * font_width, (uint8_t)(column >> (page * 8)), font_width);
+    }
+  }
+  glyph_cache.tag[slot] = c;
+  return glyph;
+}
+
+// Display a character string
+//
+// x and y of text_char and font_text are already moved to the viewport.
+static void
+text_char(tinygrafx_t tg, int16_t x, int16_t y, uint8_t c, int16_t color, int16_t fontsize)
+{
+  uint8_t row_pixel;
+  uint16_t font_width;
+  const uint8_t *glyph;
+
+  STATS_CALL(tg, STAT_TEXT);
+  if ((c >= 128) || (fontsize < 1)) return;
+
+  font_width = (fontsize & 0x01) + (fontsize / 2);
+  glyph = glyph_bitmap(c, fontsize);
+  if (glyph != NULL) {
+    bitmap_pages(tg, x, y, tg.font_width * font_width, tg.font_height * fontsize, glyph, color);
+    return;
+  }
+
+  // too large for the cache, one rectangle per font pixel
+  for (int16_t y1 = 0; y1 < tg.font_height; y1++) {  
+    row_pixel = font8x8_basic[c][y1];
+
+    for (int16_t x1 = 0; x1 < tg.font_width; x1++) {
+      if (row_pixel & 0x01) {
+        fill_rect(tg, x + x1 * font_width, y + y1 * fontsize, font_width, fontsize, color);
+      }
+      row_pixel >>= 1;
+    }
+  }
+  // ESP_LOGI(TAG, "draw char: 0x%X=%c", c, c);
+}
+
+void 
+draw_char(tinygrafx_t tg, int16_t x, int16_t y, uint8_t c, int16_t color, int16_t fontsize) 
+{
+  text_char(tg, x + tg.clip.origin_x, y + tg.clip.origin_y, c, color, fontsize);
+}
+
+// Text in a proportional font. Glyphs are looked up by code point, moved
+// by the kerning of the pair and drawn straight from the font tables.
+static void
+font_text(tinygrafx_t tg, int16_t x, int16_t y, const uint8_t *text, int16_t length, int16_t color, const tinyfont_t *font)
+{
+  uint16_t prev = TINYFONT_NONE;
+  int16_t i = 0;
+
+  while (i < length) {
+    uint32_t code = utf8_next(text, length, &i);
+    const tinyfont_glyph_t *glyph;
+    uint16_t g;
+
+    if (code == '\n') {
+      x = tg.clip.origin_x;
+      y += font->height;
+      prev = TINYFONT_NONE;
+      continue;
+    }
+    g = tinyfont_glyph(font, code);
+    if (g == TINYFONT_NONE) continue;
+    if (prev != TINYFONT_NONE) {
+      x += tinyfont_kerning(font, prev, g);
+    }
+    glyph = &font->glyphs[g];
+    STATS_CALL(tg, STAT_TEXT);
+    if (glyph->width > 0) {
+      bitmap_pages(tg, x + glyph->left, y, glyph->width, font->height, font->bitmaps + glyph->offset, color);
+    }
+    x += glyph->advance;
+    prev = g;
+  }
+}
+
+void 
+display_text(tinygrafx_t tg, int16_t x, int16_t y, uint8_t *text, int16_t length, int16_t color, int16_t fontsize,
+             const tinyfont_t *font)
+{
+  // ESP_LOGI(TAG, "display text: %s, length: %d, fontsize: %d", text, length, fontsize);
+  uint16_t font_width;
+
+  x += tg.clip.origin_x;
+  y += tg.clip.origin_y;
+  if (font != NULL) {
+    font_text(tg, x, y, text, length, color, font);
+    return;
+  }
 
   for (int16_t i = 0; i < length; i++) {
     if (text[i] == '\n') {
-      x =0;
+      x = tg.clip.origin_x;
       y += tg.font_width * fontsize;
     }
     else {
-      draw_char(tg, x, y, text[i], color, fontsize);
+      text_char(tg, x, y, text[i], color, fontsize);
       if (fontsize == 1) {
         x += tg.font_width * fontsize;
       }
@@ -1,6 +1,69 @@
 #ifndef TINYGRAFXH_
 #define TINYGRAFXH_
 
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "tiny_font.h"
+
+// Statistics, compiled in with TINYGRAFX_STATS (see mrbgem.rake)
+//
+// calls counts the primitives by type as called from outside: a rect is
+// one STAT_RECT, not four lines, and text counts characters.
+#define STAT_CLEAR              0
+#define STAT_PIXEL              1
+#define STAT_LINE               2
+#define STAT_HLINE              3
+#define STAT_VLINE              4
+#define STAT_RECT               5
+#define STAT_FILL_RECT          6
+#define STAT_CIRCLE             7
+#define STAT_FILL_CIRCLE        8
+#define STAT_TEXT               9
+#define STAT_BITMAP             10
+#define STAT_SCROLL             11
+#define STAT_COMPOSITE          12
+#define STAT_ELLIPSE            13
+#define STAT_FILL_ELLIPSE       14
+#define STAT_ARC                15
+#define STAT_PIE                16
+#define STAT_FILL_POLYGON       17
+#define STAT_ROUND_RECT         18
+#define STAT_FILL_ROUND_RECT    19
+#define STAT_GRAY_IMAGE         20
+#define STAT_TYPES              21
+
+typedef struct tinygrafx_stats_t {
+  uint32_t calls[STAT_TYPES];
+  uint32_t pixels;            // pixels written in the frame buffer
+  uint32_t bytes;             // bus bytes of the successful transactions
+  uint32_t transactions;      // bus transactions (transport_send calls)
+  uint32_t errors;            // failed transactions
+  uint32_t timeouts;          // failed with ESP_ERR_TIMEOUT
+  uint32_t hold_us_max;       // longest transaction, the bus is held that long
+  uint64_t hold_us_total;
+  uint32_t flushes;
+  uint32_t flush_us_min;
+  uint32_t flush_us_max;
+  uint64_t flush_us_total;
+} tinygrafx_stats_t;
+
+#ifdef TINYGRAFX_STATS
+#define STATS_CALL(tg, type)    do { if ((tg).stats != NULL) (tg).stats->calls[type]++; } while (0)
+#define STATS_PIXELS(tg, n)     do { if ((tg).stats != NULL) (tg).stats->pixels += (n); } while (0)
+#else
+#define STATS_CALL(tg, type)
+#define STATS_PIXELS(tg, n)
+#endif
+
+// Clip rectangle and viewport, in frame buffer coordinates. Every
+// primitive is moved by the origin, then clipped to [x0, x1) x [y0, y1).
+typedef struct tinygrafx_clip_t {
+  int16_t x0, y0;
+  int16_t x1, y1;
+  int16_t origin_x, origin_y;
+} tinygrafx_clip_t;
+
 // TINYGRAFX config
 typedef struct tinygrafx_t {
   uint16_t display_width;
@@ -9,29 +72,104 @@ typedef struct tinygrafx_t {
   uint8_t font_width;
   uint8_t font_height;
   uint8_t *display_buffer;
+  uint8_t display_pages;      // display_height / 8
+  int16_t *dirty_x0;          // first dirty column of each page
+  int16_t *dirty_x1;          // last dirty column of each page (-1 = clean)
+  uint8_t *shadow_buffer;     // copy of the panel GDDRAM (NULL = disabled)
+  uint8_t shadow_valid;       // shadow_buffer matches the panel
+  int16_t color;              // drawing color of the mruby bindings
+  int16_t fontsize;           // font size of the mruby bindings
+  const tinyfont_t *font;     // font of the mruby bindings, NULL = font8x8
+  tinygrafx_clip_t clip;      // active clip rectangle and viewport
+#ifdef TINYGRAFX_STATS
+  tinygrafx_stats_t *stats;   // shared by the copies of this frame
+#endif
 } tinygrafx_t;
 
 #define BLACK   0
 #define WHITE   1
 #define INVERT  2
 
+// bitmap layouts
+#define BITMAP_PAGES  0     // bits[page * w + x], bit 0 at the top (frame buffer order)
+#define BITMAP_ROWS   1     // bits[y * ((w + 7) / 8) + x / 8], MSB first (PBM order)
+
+// raster operations of composite, applied byte by byte
+#define ROP_COPY      0     // d = s
+#define ROP_OR        1     // d = d | s
+#define ROP_AND       2     // d = d & s
+#define ROP_XOR       3     // d = d ^ s
+#define ROP_ANDNOT    4     // d = d & ~s
+#define ROP_TYPES     5
+
+// dithering of gray_image
+#define DITHER_THRESHOLD  0   // on from 128
+#define DITHER_BAYER      1   // ordered, 8x8 Bayer matrix
+#define DITHER_DIFFUSION  2   // Floyd-Steinberg error diffusion
+#define DITHER_TYPES      3
+
+// largest canvas side
+#define CANVAS_MAX_SIZE 1024
+
 // manipulate the graphics
 #define swap_int16_t(a, b) { int16_t t = a; a = b; b = t; }
 
+// dirty region tracking
+void dirty_mark(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t x1, int16_t y1);
+void dirty_all(tinygrafx_t tg);
+void dirty_clean(tinygrafx_t tg);
+int16_t dirty_trim(tinygrafx_t tg);
+void shadow_update(tinygrafx_t tg, int16_t page, int16_t x0, int16_t x1);
+
+// clip rectangle and viewport, x and y are relative to the current
+// viewport and the new clip never reaches outside the current one
+void clip_reset(tinygrafx_t *tg);
+void clip_set(tinygrafx_t *tg, int16_t x, int16_t y, int16_t w, int16_t h);
+void viewport_set(tinygrafx_t *tg, int16_t x, int16_t y, int16_t w, int16_t h);
+
 void buffer_clear(tinygrafx_t tg);
-void buffer_read(tinygrafx_t tg, uint8_t *data, int16_t size);
+void buffer_read(tinygrafx_t tg, uint8_t *data, uint16_t size);
+void buffer_write(tinygrafx_t tg, const uint8_t *data, uint16_t size);
 void set_pixel(tinygrafx_t tg, int16_t x, int16_t y, uint16_t color) ;
 int16_t get_pixel(tinygrafx_t tg, int16_t x, int16_t y);
 void draw_line(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t color);
+void draw_thick_line(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t thickness, int16_t color);
 void draw_vertical_line(tinygrafx_t tg, int16_t x, int16_t y, int16_t h, int16_t color);
 void draw_horizontal_line(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t color);
 void draw_rect(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, int16_t color);
 void draw_fill_rect(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, int16_t color);
 void draw_circle(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t r, int16_t color);
 void draw_fill_circle(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t r, int16_t color);
+void draw_ellipse(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t rx, int16_t ry, int16_t color);
+void draw_fill_ellipse(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t rx, int16_t ry, int16_t color);
+void draw_round_rect(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, int16_t color);
+void draw_fill_round_rect(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, int16_t color);
+
+// Arc of the given thickness and pie slice from start to end, in degrees
+// clockwise from 3 o'clock (end < start wraps past 360)
+void draw_arc(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t r, int16_t start, int16_t end, int16_t thickness, int16_t color);
+void draw_pie(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t r, int16_t start, int16_t end, int16_t color);
+
+// Filled convex polygon, points holds count (x, y) pairs
+void draw_fill_triangle(tinygrafx_t tg, int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, int16_t color);
+void draw_fill_polygon(tinygrafx_t tg, const int16_t *points, int16_t count, int16_t color);
+void draw_bitmap(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *bits, int16_t color);
+void scroll_region(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, int16_t dx, int16_t dy);
+void blit(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *bits, const uint8_t *mask, uint8_t format, int16_t color);
+
+// Off-screen canvas: a frame buffer of any size drawn with the same
+// primitives, then composited onto the display or another canvas
+esp_err_t canvas_init(tinygrafx_t *tg, int16_t width, int16_t height);
+void canvas_free(tinygrafx_t *tg);
+void composite(tinygrafx_t tg, int16_t x, int16_t y, tinygrafx_t src, int16_t sx, int16_t sy, int16_t w, int16_t h, uint8_t rop);
+
+// 8-bit grayscale image dithered into the frame (gray[y * w + x], 0 = black)
+void gray_image(tinygrafx_t tg, int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *gray, uint8_t mode, uint8_t phase);
 
-// Display a character string
+// Display a character string, in font8x8 scaled by fontsize or, when font
+// is not NULL, in that font (UTF-8, fontsize is not used)
 void draw_char(tinygrafx_t tg, int16_t x, int16_t y, uint8_t c, int16_t color, int16_t fontsize);
-void display_text(tinygrafx_t tg, int16_t x, int16_t y, uint8_t *text, int16_t length, int16_t color, int16_t fontsize);
+void display_text(tinygrafx_t tg, int16_t x, int16_t y, uint8_t *text, int16_t length, int16_t color, int16_t fontsize,
+                  const tinyfont_t *font);
 
 #endif /* TINYGRAFXH_ */
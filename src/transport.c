@@ -0,0 +1,286 @@
+// ===================================================================
+//
+//    Panel transports: I2C and 4-wire SPI (for esp-idf)
+//
+// ===================================================================
+
+#include <string.h>
+
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "transport.h"
+
+// most command bytes ahead of the data of a window
+#define TRANSPORT_WINDOW_COMMANDS       8
+
+static TickType_t
+transport_timeout(transport_t *tr)
+{
+  return (tr->timeout > 0) ? tr->timeout : pdMS_TO_TICKS(TRANSPORT_TIMEOUT_MS);
+}
+
+void
+transport_release(transport_t *tr)
+{
+  if ((tr->ops != NULL) && (tr->ops->release != NULL)) {
+    tr->ops->release(tr);
+  }
+  tr->ops = NULL;
+}
+
+// PanelGroup interleaves the panels of one bus, the I2C ports are buses
+// 0..I2C_NUM_MAX-1 and the SPI hosts follow. -1 for other transports.
+int16_t
+transport_bus_id(const transport_t *tr)
+{
+  if (tr->ops == &transport_i2c_ops) {
+    return tr->i2c.port;
+  }
+  if (tr->ops == &transport_spi_ops) {
+    return I2C_NUM_MAX + tr->spi.host;
+  }
+  return -1;
+}
+
+// -------------------------------------------------------------------
+// I2C
+// -------------------------------------------------------------------
+
+static i2c_cmd_handle_t
+transport_link_create(transport_t *tr)
+{
+#ifdef TRANSPORT_LINK_SIZE
+  return i2c_cmd_link_create_static(tr->i2c.link_buffer, TRANSPORT_LINK_SIZE);
+#else
+  return i2c_cmd_link_create();
+#endif
+}
+
+static void
+transport_link_delete(i2c_cmd_handle_t cmd)
+{
+#ifdef TRANSPORT_LINK_SIZE
+  i2c_cmd_link_delete_static(cmd);
+#else
+  i2c_cmd_link_delete(cmd);
+#endif
+}
+
+// A command sequence is one CMDSTREAM transaction. With data each command
+// byte is sent with a CMDSINGLE control byte, then DATASTREAM and the
+// segments follow in the same transaction, each one a write straight from
+// the frame buffer.
+static esp_err_t
+transport_i2c_send(transport_t *tr, const uint8_t *commands, size_t command_length,
+                   const transport_segment_t *segments, int16_t count, size_t *bus_bytes)
+{
+  uint8_t header[2 * TRANSPORT_WINDOW_COMMANDS + 2];
+  size_t length = 0, bytes;
+  i2c_cmd_handle_t cmd;
+  esp_err_t err;
+
+  header[length++] = (tr->i2c.addr << 1) | I2C_MASTER_WRITE;
+  if (count == 0) {
+    header[length++] = SSD1306I2C_CONTROLBYTE_CMDSTREAM;
+  }
+  else {
+    if (command_length > TRANSPORT_WINDOW_COMMANDS) {
+      return ESP_ERR_INVALID_SIZE;
+    }
+    for (size_t i = 0; i < command_length; i++) {
+      header[length++] = SSD1306I2C_CONTROLBYTE_CMDSINGLE;
+      header[length++] = commands[i];
+    }
+    header[length++] = SSD1306I2C_CONTROLBYTE_DATASTREAM;
+  }
+  bytes = length;
+
+  cmd = transport_link_create(tr);
+  i2c_master_start(cmd);
+  i2c_master_write(cmd, header, length, true);
+  if (count == 0) {
+    i2c_master_write(cmd, commands, command_length, true);
+    bytes += command_length;
+  }
+  for (int16_t i = 0; i < count; i++) {
+    i2c_master_write(cmd, segments[i].data, segments[i].length, true);
+    bytes += segments[i].length;
+  }
+  i2c_master_stop(cmd);
+  err = i2c_master_cmd_begin(tr->i2c.port, cmd, transport_timeout(tr));
+  transport_link_delete(cmd);
+
+  *bus_bytes = bytes;
+  return err;
+}
+
+const transport_ops_t transport_i2c_ops = {
+  "i2c",
+  transport_i2c_send,
+  NULL
+};
+
+// The I2C driver of the port is installed by the I2C object
+void
+transport_i2c_init(transport_t *tr, i2c_port_t port, uint8_t addr)
+{
+  tr->ops = &transport_i2c_ops;
+  tr->i2c.port = port;
+  tr->i2c.addr = addr;
+}
+
+// -------------------------------------------------------------------
+// 4-wire SPI
+// -------------------------------------------------------------------
+
+// Transfers on the way. They finish in order, so the slot of the oldest
+// one is free again after its result.
+typedef struct transport_spi_queue_t {
+  spi_transaction_t slots[TRANSPORT_SPI_QUEUE];
+  int16_t sent;
+  int16_t pending;
+} transport_spi_queue_t;
+
+// Queue transfers of the bytes, waiting for the oldest one when the
+// queue is full
+static esp_err_t
+transport_spi_queue(transport_t *tr, transport_spi_queue_t *q, const uint8_t *data, size_t length)
+{
+  esp_err_t err = ESP_OK;
+
+  while ((length > 0) && (err == ESP_OK)) {
+    size_t n = (length < TRANSPORT_SPI_MAX_TRANSFER) ? length : TRANSPORT_SPI_MAX_TRANSFER;
+    spi_transaction_t *t = &q->slots[q->sent % TRANSPORT_SPI_QUEUE];
+
+    if (q->pending >= TRANSPORT_SPI_QUEUE) {
+      spi_transaction_t *done;
+
+      err = spi_device_get_trans_result(tr->spi.device, &done, transport_timeout(tr));
+      if (err != ESP_OK) break;
+      q->pending--;
+    }
+    memset(t, 0, sizeof(*t));
+    t->length = n * 8;
+    t->tx_buffer = data;
+    err = spi_device_queue_trans(tr->spi.device, t, transport_timeout(tr));
+    if (err == ESP_OK) {
+      q->sent++;
+      q->pending++;
+    }
+    data += n;
+    length -= n;
+  }
+
+  return err;
+}
+
+// Wait for the transfers on the way
+static esp_err_t
+transport_spi_wait(transport_t *tr, transport_spi_queue_t *q)
+{
+  esp_err_t err = ESP_OK;
+
+  while (q->pending > 0) {
+    spi_transaction_t *done;
+    esp_err_t e = spi_device_get_trans_result(tr->spi.device, &done, transport_timeout(tr));
+
+    if (e != ESP_OK) {
+      // the driver still owns the slots, do not reuse them
+      return e;
+    }
+    q->pending--;
+  }
+
+  return err;
+}
+
+// D/C low for the commands, high for the data. The commands have to be
+// out before D/C changes, the data transfers are queued back to back and
+// DMA reads them from the frame buffer, so no control bytes and no copy.
+static esp_err_t
+transport_spi_send(transport_t *tr, const uint8_t *commands, size_t command_length,
+                   const transport_segment_t *segments, int16_t count, size_t *bus_bytes)
+{
+  transport_spi_queue_t q;
+  size_t bytes = command_length;
+  esp_err_t err = ESP_OK, e;
+
+  q.sent = 0;
+  q.pending = 0;
+  if (command_length > 0) {
+    gpio_set_level(tr->spi.dc, 0);
+    err = transport_spi_queue(tr, &q, commands, command_length);
+    e = transport_spi_wait(tr, &q);
+    if (err == ESP_OK) err = e;
+  }
+  if ((count > 0) && (err == ESP_OK)) {
+    gpio_set_level(tr->spi.dc, 1);
+    for (int16_t i = 0; (i < count) && (err == ESP_OK); i++) {
+      err = transport_spi_queue(tr, &q, segments[i].data, segments[i].length);
+      bytes += segments[i].length;
+    }
+    e = transport_spi_wait(tr, &q);
+    if (err == ESP_OK) err = e;
+  }
+
+  *bus_bytes = bytes;
+  return err;
+}
+
+static void
+transport_spi_release(transport_t *tr)
+{
+  if (tr->spi.device != NULL) {
+    spi_bus_remove_device(tr->spi.device);
+    tr->spi.device = NULL;
+  }
+}
+
+const transport_ops_t transport_spi_ops = {
+  "spi",
+  transport_spi_send,
+  transport_spi_release
+};
+
+// Add the panel to an SPI bus set up by the SPI object (with a DMA
+// channel for the data transfers). cs < 0 leaves CS to the caller, rst < 0
+// skips the reset pulse.
+esp_err_t
+transport_spi_init(transport_t *tr, spi_host_device_t host, int16_t cs, int16_t dc, int16_t rst,
+                   int32_t clock_hz)
+{
+  spi_device_interface_config_t config;
+  esp_err_t err;
+
+  if (dc < 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  gpio_reset_pin(dc);
+  gpio_set_direction(dc, GPIO_MODE_OUTPUT);
+  if (rst >= 0) {
+    gpio_reset_pin(rst);
+    gpio_set_direction(rst, GPIO_MODE_OUTPUT);
+    gpio_set_level(rst, 0);
+    vTaskDelay(pdMS_TO_TICKS(10));
+    gpio_set_level(rst, 1);
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+
+  memset(&config, 0, sizeof(config));
+  config.mode = 0;
+  config.clock_speed_hz = clock_hz;
+  config.spics_io_num = cs;
+  config.queue_size = TRANSPORT_SPI_QUEUE;
+
+  tr->spi.device = NULL;
+  err = spi_bus_add_device(host, &config, &tr->spi.device);
+  if (err != ESP_OK) {
+    return err;
+  }
+  tr->ops = &transport_spi_ops;
+  tr->spi.host = host;
+  tr->spi.dc = dc;
+  tr->spi.rst = rst;
+
+  return ESP_OK;
+}
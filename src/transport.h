@@ -0,0 +1,104 @@
+#ifndef TRANSPORTH_
+#define TRANSPORTH_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "driver/i2c.h"
+#include "driver/spi_master.h"
+#include "esp_err.h"
+
+// Panel transport
+//
+// A transaction is a few command bytes followed by data bytes taken from
+// up to TRANSPORT_MAX_SEGMENTS pieces of the frame buffer, one per page
+// of a window. Without segments it is a command sequence. The transport
+// frames them for its bus: I2C control bytes, or the D/C pin on SPI.
+
+#define TRANSPORT_MAX_SEGMENTS  8
+
+// bus ids of PanelGroup, the I2C ports then the SPI hosts
+#define TRANSPORT_BUS_MAX       (I2C_NUM_MAX + SPI_HOST_MAX)
+
+// SSD1306 control byte
+#define SSD1306I2C_CONTROLBYTE_CMDSINGLE       0x80
+#define SSD1306I2C_CONTROLBYTE_CMDSTREAM       0x00
+#define SSD1306I2C_CONTROLBYTE_DATASTREAM      0x40
+
+// esp-idf v4.4 and later can build the command link in a static buffer,
+// so a transaction does not allocate link nodes on the heap. A window
+// transaction uses at most 11 link commands (start, window header, one
+// write per page, stop).
+#ifdef I2C_LINK_RECOMMENDED_SIZE
+#define TRANSPORT_LINK_SIZE     I2C_LINK_RECOMMENDED_SIZE(3)
+#endif
+
+// time a transaction may wait for the bus and take, unless set in
+// transport_t.timeout
+#define TRANSPORT_TIMEOUT_MS    1000
+
+// SPI transfers queued at a time, the data of a window goes out in DMA
+// transfers straight from the frame buffer
+#define TRANSPORT_SPI_QUEUE     4
+
+// largest SPI transfer, longer data is sent in pieces
+#define TRANSPORT_SPI_MAX_TRANSFER      4092
+
+typedef struct transport_segment_t {
+  const uint8_t *data;
+  size_t length;
+} transport_segment_t;
+
+typedef struct transport_t transport_t;
+
+typedef struct transport_ops_t {
+  const char *name;
+  // send one transaction, *bus_bytes is the number of bytes on the bus
+  esp_err_t (*send)(transport_t *tr, const uint8_t *commands, size_t command_length,
+                    const transport_segment_t *segments, int16_t count, size_t *bus_bytes);
+  void (*release)(transport_t *tr);
+} transport_ops_t;
+
+typedef struct transport_i2c_t {
+  i2c_port_t port;
+  uint8_t addr;               // 7-bit address
+#ifdef TRANSPORT_LINK_SIZE
+  uint8_t link_buffer[TRANSPORT_LINK_SIZE];
+#endif
+} transport_i2c_t;
+
+// 4-wire SPI: a device on a bus set up by the SPI object, CS driven by
+// the SPI driver, D/C (low = command) and the optional reset by us
+typedef struct transport_spi_t {
+  spi_host_device_t host;
+  spi_device_handle_t device;
+  int16_t dc;
+  int16_t rst;                // -1 = not wired
+} transport_spi_t;
+
+struct transport_t {
+  const transport_ops_t *ops;
+  TickType_t timeout;         // ticks per transaction, 0 = transport default
+  transport_i2c_t i2c;
+  transport_spi_t spi;
+  void *user;                 // state of other transports (host mocks)
+};
+
+extern const transport_ops_t transport_i2c_ops;
+extern const transport_ops_t transport_spi_ops;
+
+void transport_i2c_init(transport_t *tr, i2c_port_t port, uint8_t addr);
+esp_err_t transport_spi_init(transport_t *tr, spi_host_device_t host, int16_t cs, int16_t dc, int16_t rst,
+                             int32_t clock_hz);
+void transport_release(transport_t *tr);
+int16_t transport_bus_id(const transport_t *tr);
+
+static inline esp_err_t
+transport_send(transport_t *tr, const uint8_t *commands, size_t command_length,
+               const transport_segment_t *segments, int16_t count, size_t *bus_bytes)
+{
+  return tr->ops->send(tr, commands, command_length, segments, count, bus_bytes);
+}
+
+#endif /* TRANSPORTH_ */